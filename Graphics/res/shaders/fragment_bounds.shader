@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+void main()
+{
+    // Color writes are masked while querying, only the samples passed count matters
+    FragColor = vec4(1.0);
+}
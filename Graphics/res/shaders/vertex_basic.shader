@@ -1,15 +1,27 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTexCoord;
+// Per instance: position and phase, rotation axis and angular speed
+layout(location = 2) in vec4 aInstancePosition;
+layout(location = 3) in vec4 aInstanceSpin;
 
 out vec2 TexCoord;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform float time;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    // Rodrigues rotation about the instance axis. The wrap keeps sin and cos in their accurate
+    // range, it cannot restore what the float product already rounded: an hour in, time steps
+    // by about 2e-4 s, which at 180 degrees per second is 0.04 degrees of jitter
+    float angle = mod(aInstanceSpin.w * time + aInstancePosition.w, 6.28318531);
+    vec3 axis = aInstanceSpin.xyz;
+    float c = cos(angle);
+    float s = sin(angle);
+    vec3 position = aPos * c + cross(axis, aPos) * s + axis * dot(axis, aPos) * (1.0 - c);
+
+    gl_Position = projection * view * vec4(position + aInstancePosition.xyz, 1.0f);
     TexCoord = vec2(aTexCoord.x, 1.0 - aTexCoord.y);
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 viewProjection;
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main()
+{
+    // aPos is a unit cube in [0, 1], stretched over the box
+    gl_Position = viewProjection * vec4(mix(boundsMin, boundsMax, aPos), 1.0f);
+}
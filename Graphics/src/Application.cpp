@@ -3,6 +3,7 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
 
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
@@ -14,12 +15,37 @@
 
 #include "core/Renderer.h"
 #include "core/Texture.h"
+#include "core/TextureCache.h"
+#include "core/ResourceRegistry.h"
 #include "core/Camera.h"
+#include "core/FrameCapture.h"
+#include "core/ReleaseQueue.h"
+#include "core/Culling.h"
+#include "core/SpatialGrid.h"
+#include "core/Bvh.h"
+#include "core/MeshLod.h"
+#include "core/TransformHierarchy.h"
+#include "core/Ecs.h"
+#include "core/OcclusionCuller.h"
+#include "core/JobSystem.h"
+#include "core/InstanceTransforms.h"
+#include "core/InstanceAnimation.h"
+#include "core/RenderThread.h"
+#include "core/CommandList.h"
+#include "core/TaskGraph.h"
+#include "core/FrameArena.h"
+#include "core/PoolAllocator.h"
+#include "core/AllocationTracker.h"
+#include "core/Profiler.h"
+#include "core/GpuProfiler.h"
+#include "core/PipelineStatistics.h"
 
 // Function Declarations
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window);
 
 // Window Settings
@@ -36,7 +62,227 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main() {
+// Frame Capture (F11 screenshot, F12 toggle recording)
+bool screenshotRequested = false;
+bool recordingToggled = false;
+bool benchmarkRequested = false;
+// F9 saves the frame timeline
+bool traceRequested = false;
+// Left clicks of the current frame, each picks what is under the crosshair
+std::vector<Ray> pickRays;
+
+// --allocation-test: after a warm-up the frame loop must not touch the heap, the run fails otherwise
+const uint64_t allocationWarmupFrames = 120;
+const uint64_t allocationTestFrames = 600;
+
+// What the input stage saw, one copy per frame in flight
+struct FrameInput {
+	float DeltaTime;
+	int ViewportWidth;
+	int ViewportHeight;
+	glm::vec3 Eye;
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::mat4 ViewProjection;
+	Frustum ViewFrustum;
+	bool Screenshot;
+	bool ToggleRecording;
+};
+
+// Renderer stats summed over every frame drawn, read before each reset
+struct DrawTotals {
+	uint64_t Frames = 0;
+	uint64_t Objects = 0;
+	uint64_t DrawCalls = 0;
+	uint64_t OcclusionCulled = 0;
+	uint64_t OcclusionQueries = 0;
+	uint64_t ConditionalDraws = 0;
+
+	void Add(const RenderStats& stats) {
+		Frames++;
+		Objects += stats.Objects;
+		DrawCalls += stats.DrawCalls;
+		OcclusionCulled += stats.OcclusionCulled;
+		OcclusionQueries += stats.OcclusionQueries;
+		ConditionalDraws += stats.ConditionalDraws;
+	}
+
+	void Print() const {
+		if (Frames == 0) return;
+		const double frames = static_cast<double>(Frames);
+		std::cout << "Draws per frame: " << Objects / frames << " objects, " << DrawCalls / frames << " draw calls, "
+			<< OcclusionCulled / frames << " occlusion culled, " << OcclusionQueries / frames << " queries, "
+			<< ConditionalDraws / frames << " conditional draws over " << Frames << " frames" << std::endl;
+	}
+};
+
+// GL resources of the scene
+struct SceneResources {
+	Renderer Output;
+	// Owns the scene's GL objects, everything else refers to them by handle
+	ResourceRegistry Resources;
+	ShaderHandle CubeShader;
+	VertexBufferHandle CubeVertices;
+	VertexArrayHandle CubeArray;
+	SpinInstanceBuffer CubeInstances;
+	TextureCache Textures;
+	std::shared_ptr<Texture> Container;
+	std::shared_ptr<Texture> Face;
+	FrameCapture Capture;
+	DrawTotals Draws;
+#if PROFILING
+	GpuProfiler GpuTimers;
+	PipelineStatistics PassCounters;
+#endif
+
+	SceneResources(const float* vertices, unsigned int size, const std::vector<SpinInstance>& instances) :
+		CubeShader(Resources.Create<Shader>("res/shaders/vertex_basic.shader", "res/shaders/fragment_basic.shader")),
+		CubeVertices(Resources.Create<VertexBuffer>(vertices, size)),
+		CubeArray(Resources.Create<VertexArray>()),
+		CubeInstances(instances)
+	{
+		// Configure global opengl state
+		glEnable(GL_DEPTH_TEST);
+#if PROFILING
+		Output.SetPipelineStatistics(&PassCounters);
+#endif
+
+		VertexBuffer& cubeVertices = *Resources.Get(CubeVertices);
+		VertexArray& cubeArray = *Resources.Get(CubeArray);
+		cubeVertices.Bind();
+		cubeArray.Bind();
+		// Position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		// Texture attribute
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+		// Instance attributes
+		CubeInstances.AddToVertexArray(cubeArray);
+
+		// Texture Handling
+		Container = Textures.Acquire("res/textures/container.jpg");
+		Face = Textures.Acquire("res/textures/awesomeface.png");
+
+		Shader& cubeShader = *Resources.Get(CubeShader);
+		cubeShader.Bind();
+		cubeShader.SetUniformli("texture1", 0);
+		cubeShader.SetUniformli("texture2", 1);
+
+		cubeVertices.Unbind();
+		cubeArray.Unbind();
+	}
+};
+
+int main(int argc, char** argv) {
+	bool allocationTest = false;
+	bool cullBenchmark = false;
+	bool gridBenchmark = false;
+	bool occlusionTest = false;
+	bool jobScaling = false;
+	bool transformTest = false;
+	bool bvhTest = false;
+	bool lodTest = false;
+	bool hierarchyTest = false;
+	bool ecsTest = false;
+	bool allocatorTest = false;
+	for (int i = 1; i < argc; i++) {
+		const std::string argument(argv[i]);
+		if (argument == "--allocation-test") allocationTest = true;
+		else if (argument == "--cull-benchmark") cullBenchmark = true;
+		else if (argument == "--grid-benchmark") gridBenchmark = true;
+		else if (argument == "--occlusion-test") occlusionTest = true;
+		else if (argument == "--job-scaling") jobScaling = true;
+		else if (argument == "--transform-test") transformTest = true;
+		else if (argument == "--bvh-test") bvhTest = true;
+		else if (argument == "--lod-test") lodTest = true;
+		else if (argument == "--hierarchy-test") hierarchyTest = true;
+		else if (argument == "--ecs-test") ecsTest = true;
+		else if (argument == "--allocator-test") allocatorTest = true;
+	}
+
+	if (allocationTest && !AllocationTracker::Get().IsAvailable()) {
+		// Nothing would be counted and the test would pass on any frame loop
+		std::cout << "ERROR::ALLOCATION_TEST::NOT_COMPILED_IN build with ALLOCATION_TRACKING=1" << std::endl;
+		return 1;
+	}
+
+	// One worker per core, the main thread is worker 0 and helps while it waits
+	JobSystem::Get().Start();
+
+	// Headless modes, no window or GL context
+	if (cullBenchmark || gridBenchmark || occlusionTest || jobScaling || transformTest || bvhTest || lodTest || hierarchyTest || ecsTest || allocatorTest) {
+		int result = 0;
+		if (cullBenchmark) {
+			const CullBenchmark benchmark = RunCullBenchmark(1000000, 20);
+			std::cout << "Culling 1M objects (" << benchmark.Kernel << "): spheres " << benchmark.SphereMilliseconds << " ms, "
+				<< benchmark.VisibleSpheres << " visible, boxes " << benchmark.BoxMilliseconds << " ms, " << benchmark.VisibleBoxes << " visible" << std::endl;
+			if (benchmark.Mismatches > 0) {
+				std::cout << "ERROR::CULL_BENCHMARK::RESULTS_DIFFER from the scalar kernel" << std::endl;
+				result = 1;
+			}
+		}
+		if (gridBenchmark) {
+			const GridBenchmark benchmark = RunGridBenchmark(100000, 100);
+			std::cout << "Grid with 100k moving objects, per frame: update " << benchmark.UpdateMilliseconds << " ms, "
+				<< GRID_RADIUS_QUERIES << " radius queries " << benchmark.RadiusMilliseconds << " ms, "
+				<< GRID_BOX_QUERIES << " box queries " << benchmark.BoxMilliseconds << " ms, "
+				<< GRID_FRUSTUM_QUERIES << " frustum queries " << benchmark.FrustumMilliseconds << " ms, cells peak "
+				<< benchmark.PeakCells << ", final " << benchmark.FinalCells << std::endl;
+			if (benchmark.Mismatches > 0) {
+				std::cout << "ERROR::GRID_BENCHMARK::QUERIES_DIFFER " << benchmark.Mismatches << " of " << benchmark.Queries << " queries" << std::endl;
+				result = 1;
+			}
+		}
+		if (occlusionTest) {
+			const unsigned int failures = RunOcclusionTest();
+			if (failures == 0) std::cout << "Occlusion test passed" << std::endl;
+			else result = 1;
+		}
+		if (transformTest) {
+			const unsigned int failures = RunTransformTest();
+			if (failures == 0) std::cout << "Transform test passed" << std::endl;
+			else result = 1;
+		}
+		if (bvhTest) {
+			const unsigned int failures = RunBvhTest();
+			if (failures == 0) std::cout << "BVH test passed" << std::endl;
+			else result = 1;
+		}
+		if (lodTest) {
+			const unsigned int failures = RunLodTest();
+			if (failures == 0) std::cout << "LOD test passed" << std::endl;
+			else result = 1;
+		}
+		if (hierarchyTest) {
+			const unsigned int failures = RunHierarchyTest();
+			if (failures == 0) std::cout << "Hierarchy test passed" << std::endl;
+			else result = 1;
+		}
+		if (ecsTest) {
+			const unsigned int failures = RunEcsTest();
+			if (failures == 0) std::cout << "ECS test passed" << std::endl;
+			else result = 1;
+		}
+		if (allocatorTest) {
+			const unsigned int failures = RunAllocatorTest();
+			if (failures == 0) std::cout << "Allocator test passed" << std::endl;
+			else result = 1;
+		}
+		if (jobScaling) {
+			// Up to the hardware thread count, rows past it would only time oversubscription
+			const std::vector<JobScaling> scaling = RunJobScalingBenchmark(0, 10);
+			std::cout << "Threads  parallel for  64k jobs  fork join (ms, speedup over 1 thread)" << std::endl;
+			for (const JobScaling& entry : scaling) {
+				std::cout << entry.Threads << "  " << entry.ParallelForMilliseconds << " x" << scaling[0].ParallelForMilliseconds / entry.ParallelForMilliseconds
+					<< "  " << entry.SmallJobsMilliseconds << " x" << scaling[0].SmallJobsMilliseconds / entry.SmallJobsMilliseconds
+					<< "  " << entry.ForkJoinMilliseconds << " x" << scaling[0].ForkJoinMilliseconds / entry.ForkJoinMilliseconds << std::endl;
+			}
+		}
+		JobSystem::Get().Shutdown();
+		return result;
+	}
+
 	// Initialize and Configure GLFW
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -57,6 +303,8 @@ int main() {
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
+	glfwSetMouseButtonCallback(window, mouse_button_callback);
+	glfwSetKeyCallback(window, key_callback);
 	
 	// load all OpenGL function pointers with glad
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -64,9 +312,8 @@ int main() {
 		return -1;
 	}
 	std::cout << glGetString(GL_VERSION) << std::endl;
-	
-	// Configure global opengl state
-	glEnable(GL_DEPTH_TEST);
+	// The render thread takes the context over
+	glfwMakeContextCurrent(NULL);
 
 	// Set up vertex data and configure vertex attributes
 	float vertices[] = {
@@ -126,87 +373,380 @@ int main() {
 		glm::vec3(-1.3f,  1.0f, -1.5f)
 	};
 	
-	Renderer renderer;
-	// build and compile shader
-	Shader shader("res/shaders/vertex_basic.shader", "res/shaders/fragment_basic.shader");
+	// Bounding spheres of the cubes, radius is half the unit cube diagonal
+	BoundingSpheres cubeBounds;
+	for (const glm::vec3& position : cubePositions) {
+		cubeBounds.Add(position, 0.8660254f);
+	}
+	std::vector<AABB> cubeBoxes;
+	// The cubes spin in the vertex shader, their instance data never changes after this
+	std::vector<SpinInstance> cubeInstances;
+	for (const glm::vec3& position : cubePositions) {
+		cubeBoxes.push_back(AABB(position - glm::vec3(0.8660254f), position + glm::vec3(0.8660254f)));
+		const float degreesPerSecond = 20.0f * cubeInstances.size();
+		cubeInstances.push_back(SpinInstance{ position, 0.0f, glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)), glm::radians(degreesPerSecond) });
+	}
 
-	VertexBuffer VBO(vertices, sizeof(vertices));
-	VertexArray VAO;
-	
-	VBO.Bind();
-	VAO.Bind();
-	
-	// Position attribute
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);					
-	// Texture attribute							
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-	
-	// Texture Handling
-	Texture texture1("res/textures/container.jpg");
-	Texture texture2("res/textures/awesomeface.png");
-	
-	shader.Bind();
-	shader.SetUniformli("texture1", 0);
-	shader.SetUniformli("texture2", 1);
-	
-	VBO.Unbind();
-	VAO.Unbind();
+	// Clicks are resolved against the cube bounds
+	Bvh cubeTree;
+	cubeTree.Build(cubeBoxes);
+	std::vector<RayHit> pickHits;
+	pickRays.reserve(8);
+
+	// Cubes hide each other on the CPU before anything is recorded, each with its current spin.
+	// The simulate stage composes those transforms; occluders are shrunk a little so rounding
+	// differences to the rotation the vertex shader computes never make them cover too much.
+	const float occluderScale = 0.98f;
+	float occluderCorners[8 * 3];
+	for (int corner = 0; corner < 8; corner++) {
+		for (int axis = 0; axis < 3; axis++) occluderCorners[3 * corner + axis] = (corner >> axis) & 1 ? 0.5f : -0.5f;
+	}
+	// Corner bits are x, y, z; counter-clockwise seen from outside
+	const unsigned int occluderIndices[] = {
+		4, 5, 7, 4, 7, 6,	// +z
+		0, 2, 3, 0, 3, 1,	// -z
+		1, 3, 7, 1, 7, 5,	// +x
+		0, 4, 6, 0, 6, 2,	// -x
+		6, 7, 3, 6, 3, 2,	// +y
+		0, 1, 5, 0, 5, 4	// -y
+	};
+	// The nearest cubes are the likeliest to hide something
+	const size_t maxOccluders = 8;
+
+	// GL objects are created, used and destroyed on the render thread only
+	std::unique_ptr<SceneResources> resources;
+	int viewportWidth = 0, viewportHeight = 0;
+	CommandReplayer replayer;
+	RenderThread renderThread;
+	renderThread.Start(window, [&]() {
+		resources.reset(new SceneResources(vertices, sizeof(vertices), cubeInstances));
+	}, [&](const FramePacket& packet) {
+		SceneResources& scene = *resources;
+		if (packet.ViewportWidth != viewportWidth || packet.ViewportHeight != viewportHeight) {
+			viewportWidth = packet.ViewportWidth;
+			viewportHeight = packet.ViewportHeight;
+			glViewport(0, 0, viewportWidth, viewportHeight);
+		}
+
+		// GPU pass times of a few frames back show up on the GPU track of the profiler
+#if PROFILING
+		scene.GpuTimers.BeginFrame();
+		scene.PassCounters.BeginFrame();
+#endif
+		GPU_PROFILE_SCOPE(scene.GpuTimers, "Frame (GPU)");
+
+		{
+			GPU_PROFILE_SCOPE(scene.GpuTimers, "Clear (GPU)");
+			glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+			scene.Output.Clear();
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
+
+		// Textures, shader and camera uniforms, then each cube's own commands once occlusion lets it through
+		replayer.Execute(packet.Lists[0]);
+		scene.Output.ResetStats();
+		{
+			PROFILE_SCOPE("DrawOccluded");
+			GPU_PROFILE_SCOPE(scene.GpuTimers, "Cubes (GPU)");
+			// Counting pauses while occlusion culling runs its own queries
+			PIPELINE_STATISTICS_SCOPE(scene.PassCounters, "Cubes");
+			scene.Output.DrawOccluded(packet.Objects, cubeBoxes, packet.Eye, packet.ViewProjection, *scene.Resources.Get(scene.CubeShader), *scene.Resources.Get(scene.CubeArray), [&](unsigned int i) {
+				const CommandRange& range = packet.ObjectCommands[i];
+				replayer.Execute(packet.Lists[range.List], range.Begin, range.End);
+			});
+		}
+		scene.Draws.Add(scene.Output.GetStats());
+
+		// Release textures that nobody has used for a few frames
+		scene.Textures.Collect();
+
+		// Recycle or delete GPU objects released during frames the GPU has finished
+		ReleaseQueue::Get().EndFrame();
+
+		// Queue the back buffer for readback, encoding happens frames later on another thread
+		GPU_PROFILE_SCOPE(scene.GpuTimers, "Capture (GPU)");
+		scene.Capture.Update(packet.ViewportWidth, packet.ViewportHeight);
+	}, [&]() {
+		resources->Draws.Print();
+#if PROFILING
+		resources->PassCounters.PrintAverages();
+#endif
+		resources->Capture.Flush();
+		resources.reset();
+		ReleaseQueue::Get().Shutdown();
+	});
+
+	// Renderer ids and uniforms the recorded commands refer to
+	const unsigned int cubeProgram = resources->Resources.Get(resources->CubeShader)->GetRendererID();
+	const unsigned int cubeVertexArray = resources->Resources.Get(resources->CubeArray)->GetRendererID();
+	const unsigned int containerTexture = resources->Container->GetRendererID();
+	const unsigned int faceTexture = resources->Face->GetRendererID();
+	const unsigned int projectionUniform = GetUniformId("projection");
+	const unsigned int viewUniform = GetUniformId("view");
+	const unsigned int timeUniform = GetUniformId("time");
+	// Visible cubes per command list recorded by one job
+	const size_t cubesPerChunk = 64;
+
+	camera.SetAspectRatio((float)screenWidth / (float)screenHeight);
+
+	// Frame loop as a task graph. Data with a copy per frame in flight lets the input of
+	// the next frame overlap culling and recording of this one.
+	TaskGraph frameGraph;
+	const unsigned int inputData = frameGraph.AddResource("input", TaskGraph::MAX_FRAMES_IN_FLIGHT);
+	const unsigned int sceneData = frameGraph.AddResource("scene", TaskGraph::MAX_FRAMES_IN_FLIGHT);
+	// The animation clock carries over from frame to frame, so simulate stages run one after another
+	const unsigned int clockData = frameGraph.AddResource("clock");
+	const unsigned int visibilityData = frameGraph.AddResource("visibility", TaskGraph::MAX_FRAMES_IN_FLIGHT);
+	const unsigned int packetData = frameGraph.AddResource("packet");
+
+	FrameInput inputs[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	// The demo camera is copied in every frame, matrices are only rebuilt for what changed
+	CameraBatch cameras;
+	const unsigned int mainCamera = cameras.Add(CAMERA_MAIN, camera.GetView());
+	float sceneClock = 0.0f;
+	float sceneTimes[TaskGraph::MAX_FRAMES_IN_FLIGHT] = {};
+	InstanceTransforms cubeTransforms[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	std::vector<glm::mat4> cubeModels[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	for (unsigned int i = 0; i < TaskGraph::MAX_FRAMES_IN_FLIGHT; i++) {
+		for (const SpinInstance& instance : cubeInstances) cubeTransforms[i].Add(instance.Position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(occluderScale));
+		cubeModels[i].resize(cubeInstances.size());
+	}
+	std::vector<unsigned int> visibleCubes[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	OcclusionCuller occlusionCullers[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	// Temporaries of one frame, taken back when its copy comes around again
+	FrameArena frameArenas[TaskGraph::MAX_FRAMES_IN_FLIGHT];
+	// Usage of the last arena taken back, other frames may still be allocating from theirs
+	ArenaStats finishedArena = {};
+	const auto copy = [](uint64_t frame) { return frame % TaskGraph::MAX_FRAMES_IN_FLIGHT; };
+
+	// Window events and the camera belong to this thread
+	frameGraph.AddStage("input", [&](uint64_t frame) {
+		glfwPollEvents();
 
-	//Render Loop
-	while (!glfwWindowShouldClose(window)) {
 		// Per-frame time logic
 		float currentFrame = static_cast<float>(glfwGetTime());
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		//Input
-		
 		processInput(window);
-		
-		//Render
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		renderer.Clear();
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		
-		// Bind textures and activate shader
-		texture1.Bind(0);
-		texture2.Bind(1);
-		shader.Bind();
-
-		// Pass Projection matrix to shader
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
-		shader.SetUniformMat4("projection", projection);
-
-		// Camera/View Transformation
-		glm::mat4 view = camera.GetViewMatrix();
-		shader.SetUniformMat4("view", view);
-		
-		VAO.Bind();
-		for (unsigned int i = 0; i < 10; i++) {
-			// Calculate the model matrix for each object and pass it to shader before drawing
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, cubePositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, (float)glfwGetTime() * glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			shader.SetUniformMat4("model", model);
-			
-			glDrawArrays(GL_TRIANGLES, 0, 36);
-		}
-		
-		// Check and call events and swap the buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+
+		// Every click of the frame in one batch
+		if (!pickRays.empty()) {
+			pickHits.resize(pickRays.size());
+			cubeTree.RaycastBatch(pickRays.data(), pickRays.size(), pickHits.data());
+			for (const RayHit& hit : pickHits) {
+				if (hit.IsHit()) std::cout << "Picked cube " << hit.Primitive << " at distance " << hit.Distance << std::endl;
+				else std::cout << "Nothing picked" << std::endl;
+			}
+			pickRays.clear();
+		}
+
+		// Frame - MAX_FRAMES_IN_FLIGHT is done with this copy
+		finishedArena = frameArenas[copy(frame)].GetStats();
+		frameArenas[copy(frame)].Reset();
+
+		FrameInput& input = inputs[copy(frame)];
+		input.DeltaTime = deltaTime;
+		glfwGetFramebufferSize(window, &input.ViewportWidth, &input.ViewportHeight);
+		cameras.SetView(mainCamera, camera.GetView());
+		cameras.Update();
+		const CameraMatrices& matrices = cameras.GetMatrices(mainCamera);
+		input.Eye = camera.Position;
+		input.View = matrices.View;
+		input.Projection = matrices.Projection;
+		input.ViewProjection = matrices.ViewProjection;
+		input.ViewFrustum = matrices.ViewFrustum;
+		input.Screenshot = screenshotRequested;
+		input.ToggleRecording = recordingToggled;
+		screenshotRequested = false;
+		recordingToggled = false;
+
+		if (benchmarkRequested) {
+			const char* kernels[] = { "auto", "scalar", "avx2", "avx512" };
+			TransformBenchmark benchmark = RunTransformBenchmark(100000, 20);
+			std::cout << "Transforms (" << kernels[benchmark.Kernel] << "): glm " << benchmark.GlmMilliseconds << " ms, batch "
+				<< benchmark.BatchMilliseconds << " ms, max error " << benchmark.MaxModelError << " / " << benchmark.MaxModelViewProjectionError << std::endl;
+			benchmarkRequested = false;
+		}
+		if (traceRequested) {
+			frameGraph.WriteTrace("frame_trace.json");
+#if PROFILING
+			Profiler::Get().WriteTrace("profile_trace.json");
+#endif
+			std::cout << "Frame arena: peak " << finishedArena.Peak << " of " << finishedArena.Capacity << " bytes, "
+				<< finishedArena.Allocations << " allocations, " << finishedArena.Overflows << " overflows in frame "
+				<< frame - std::min<uint64_t>(frame, TaskGraph::MAX_FRAMES_IN_FLIGHT) << std::endl;
+			traceRequested = false;
+		}
+	}, {}, { inputData }, true);
+
+	// The cubes spin in the vertex shader; the CPU advances the animation clock and builds the
+	// same transforms for the occluders
+	frameGraph.AddStage("simulate", [&](uint64_t frame) {
+		sceneClock += inputs[copy(frame)].DeltaTime;
+		const float time = sceneClock;
+		sceneTimes[copy(frame)] = time;
+
+		InstanceTransforms& transforms = cubeTransforms[copy(frame)];
+		for (size_t i = 0; i < cubeInstances.size(); i++) {
+			const SpinInstance& instance = cubeInstances[i];
+			const glm::quat rotation = glm::angleAxis(instance.AngularSpeed * time + instance.Phase, instance.Axis);
+			transforms.Set(i, instance.Position, rotation, glm::vec3(occluderScale));
+		}
+		ComposeTransforms(transforms, 0, transforms.GetCount(), glm::mat4(1.0f), cubeModels[copy(frame)].data(), nullptr);
+	}, { inputData }, { sceneData, clockData });
+
+	frameGraph.AddStage("cull", [&](uint64_t frame) {
+		const FrameInput& input = inputs[copy(frame)];
+		std::vector<unsigned int>& visible = visibleCubes[copy(frame)];
+
+		// Skip cubes outside the view frustum
+		{
+			PROFILE_SCOPE("CullSpheres");
+			CullSpheres(input.ViewFrustum, cubeBounds, visible);
+		}
+		{
+			PROFILE_SCOPE("SortFrontToBack");
+
+			// Front to back, so near cubes fill the depth buffer before far ones are queried.
+			// Distances are computed once into frame memory instead of in every comparison.
+			const glm::vec3 eye = input.Eye;
+			float* distances = frameArenas[copy(frame)].Allocate<float>(cubeInstances.size());
+			for (unsigned int cube : visible) distances[cube] = glm::dot(cubePositions[cube] - eye, cubePositions[cube] - eye);
+			std::sort(visible.begin(), visible.end(), [distances](unsigned int a, unsigned int b) {
+				return distances[a] < distances[b];
+			});
+		}
+
+		// Behind the nearest cubes, in the same front to back order
+		PROFILE_SCOPE("OcclusionCull");
+		OcclusionCuller& occlusion = occlusionCullers[copy(frame)];
+		occlusion.BeginFrame(input.ViewProjection);
+		for (size_t k = 0; k < std::min(visible.size(), maxOccluders); k++) {
+			occlusion.AddOccluder(occluderCorners, occluderIndices, 36, cubeModels[copy(frame)][visible[k]]);
+		}
+		occlusion.Rasterize();
+		occlusion.Cull(cubeBoxes, visible);
+	}, { inputData, sceneData }, { visibilityData });
+
+	frameGraph.AddStage("record", [&](uint64_t frame) {
+		const FrameInput& input = inputs[copy(frame)];
+
+		// Waits only while the render thread is still busy with the frame before last
+		FramePacket& packet = renderThread.BeginFrame();
+		packet.Time = sceneTimes[copy(frame)];
+		packet.ViewportWidth = input.ViewportWidth;
+		packet.ViewportHeight = input.ViewportHeight;
+		packet.Eye = input.Eye;
+		packet.View = input.View;
+		packet.Projection = input.Projection;
+		packet.ViewProjection = input.ViewProjection;
+		packet.Objects = visibleCubes[copy(frame)];
+
+		// List 0 sets the frame up, the cube draws are recorded in chunks across the workers
+		const size_t chunkCount = (packet.Objects.size() + cubesPerChunk - 1) / cubesPerChunk;
+		if (packet.Lists.size() < chunkCount + 1) packet.Lists.resize(chunkCount + 1);
+		packet.ObjectCommands.resize(cubeInstances.size());
+
+		CommandList& setup = packet.Lists[0];
+		setup.BindTexture(0, containerTexture);
+		setup.BindTexture(1, faceTexture);
+		setup.BindShader(cubeProgram);
+		// Draws pick their cube by base instance, GL < 4.2 needs to know whose attributes to move
+		setup.BindVertexArray(cubeVertexArray);
+		setup.SetMat4(projectionUniform, packet.Projection);
+		setup.SetMat4(viewUniform, packet.View);
+		// Spinning happens in the vertex shader, rotation about the center leaves the bounds alone
+		setup.SetFloat(timeUniform, packet.Time);
+
+		JobSystem::Get().ParallelFor(0, chunkCount, [&](size_t first, size_t last) {
+			PROFILE_SCOPE("RecordChunks");
+			for (size_t chunk = first; chunk < last; chunk++) {
+				CommandList& list = packet.Lists[chunk + 1];
+				const size_t end = std::min(packet.Objects.size(), (chunk + 1) * cubesPerChunk);
+				for (size_t k = chunk * cubesPerChunk; k < end; k++) {
+					const unsigned int cube = packet.Objects[k];
+					const size_t begin = list.GetSize();
+					list.DrawArrays(PRIMITIVE_TRIANGLES, 0, 36, 1, cube);
+					packet.ObjectCommands[cube] = CommandRange{ static_cast<unsigned int>(chunk + 1), begin, list.GetSize() };
+				}
+			}
+		}, 1);
+
+		if (input.Screenshot) {
+			packet.Uploads.push_back([&resources]() { resources->Capture.Screenshot("screenshot.png"); });
+		}
+		if (input.ToggleRecording) {
+			packet.Uploads.push_back([&resources]() {
+				if (resources->Capture.IsRecording()) resources->Capture.Stop();
+				else resources->Capture.Start("capture_", CAPTURE_PPM);
+			});
+		}
+	}, { inputData, sceneData, visibilityData }, { packetData });
+
+	// The render thread draws and swaps this frame while the next one is built
+	frameGraph.AddStage("submit", [&](uint64_t) {
+		renderThread.Submit();
+	}, {}, { packetData });
+
+	//Render Loop
+	AllocationTracker& allocations = AllocationTracker::Get();
+	uint64_t allocatingFrames = 0;
+	uint64_t firstAllocatingFrame = 0;
+	size_t mostAllocations = 0;
+	while (!glfwWindowShouldClose(window)) {
+		// Frames overlap, so this counts whatever any thread allocated while the frame was issued
+		const uint64_t frame = frameGraph.GetFrame();
+		if (allocationTest && frame == allocationWarmupFrames) allocations.Start();
+		const AllocationCounts before = allocations.GetCounts();
+
+		frameGraph.Execute();
+
+		if (allocationTest && frame >= allocationWarmupFrames) {
+			const size_t count = allocations.GetCounts().Allocations - before.Allocations;
+			if (count > 0) {
+				if (allocatingFrames == 0) firstAllocatingFrame = frame;
+				allocatingFrames++;
+				mostAllocations = std::max(mostAllocations, count);
+			}
+			if (frame + 1 == allocationWarmupFrames + allocationTestFrames) glfwSetWindowShouldClose(window, true);
+		}
+	}
+	frameGraph.Finish();
+
+	int result = 0;
+	if (allocationTest) {
+		allocations.Stop();
+		if (frameGraph.GetFrame() < allocationWarmupFrames + allocationTestFrames) {
+			std::cout << "ERROR::ALLOCATION_TEST::CLOSED_EARLY after " << frameGraph.GetFrame() << " frames" << std::endl;
+			result = 1;
+		}
+		else if (allocatingFrames > 0) {
+			std::cout << "ERROR::ALLOCATION_TEST::FRAMES_ALLOCATED " << allocatingFrames << " of " << allocationTestFrames
+				<< " frames, first " << firstAllocatingFrame << ", at most " << mostAllocations << " allocations" << std::endl;
+			allocations.PrintCallSites();
+			result = 1;
+		}
+		else {
+			std::cout << "Allocation test passed: " << allocationTestFrames << " frames without heap allocations" << std::endl;
+		}
 	}
 	
+	renderThread.Stop();
+	JobSystem::Get().Shutdown();
+#if PROFILING
+	Profiler::Get().PrintStats();
+#endif
+
 	// Terminate, clearing all previously allocated GLFW resources
 	glfwTerminate();
-	return 0;
+	return result;
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+	// The render thread picks the new size up from the next frame packet
+	// Minimized windows report a zero sized framebuffer
+	if (width > 0 && height > 0) camera.SetAspectRatio((float)width / (float)height);
 }
 
 void processInput(GLFWwindow* window) {
@@ -241,4 +781,20 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 	camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
+
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
+	if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
+	Ray ray;
+	ray.Origin = camera.Position;
+	ray.Direction = camera.GetView().Forward;
+	pickRays.push_back(ray);
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (action != GLFW_PRESS) return;
+	if (key == GLFW_KEY_F11) screenshotRequested = true;
+	if (key == GLFW_KEY_F12) recordingToggled = true;
+	if (key == GLFW_KEY_F10) benchmarkRequested = true;
+	if (key == GLFW_KEY_F9) traceRequested = true;
 }
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if defined(_MSC_VER)
+	#define NOMINMAX
+	#include <windows.h>
+	#include <dbghelp.h>
+	#if defined(_DEBUG)
+		#include <crtdbg.h>
+	#endif
+#elif defined(__GLIBC__)
+	#include <execinfo.h>
+#endif
+
+#include "AllocationTracker.h"
+
+namespace {
+	struct CallSite {
+		uint64_t Hash;
+		unsigned int Depth;
+		void* Frames[AllocationTracker::MAX_DEPTH];
+		size_t Count;
+		size_t Bytes;
+	};
+
+	// Plain statics: the hooks run before main and after exit, constructors must not matter
+	std::atomic<bool> s_Running(false);
+	std::atomic<bool> s_CallSites(false);
+	std::atomic<size_t> s_Allocations(0);
+	std::atomic<size_t> s_Frees(0);
+	std::atomic<size_t> s_Bytes(0);
+
+	std::atomic_flag s_SiteLock = ATOMIC_FLAG_INIT;
+	CallSite s_Sites[AllocationTracker::MAX_CALL_SITES];
+	size_t s_DroppedSites = 0;
+
+	// Set while the tracker itself runs on this thread: taking a backtrace or printing
+	// may allocate, which must neither recurse nor count
+	thread_local bool t_Inside = false;
+
+	unsigned int CaptureBacktrace(void** frames) {
+#if defined(_MSC_VER)
+		return CaptureStackBackTrace(0, AllocationTracker::MAX_DEPTH, frames, nullptr);
+#elif defined(__GLIBC__)
+		return static_cast<unsigned int>(backtrace(frames, AllocationTracker::MAX_DEPTH));
+#else
+		return 0;
+#endif
+	}
+
+	void RecordCallSite(size_t size) {
+		void* frames[AllocationTracker::MAX_DEPTH];
+		const unsigned int depth = CaptureBacktrace(frames);
+
+		// 64-bit FNV-1a over the return addresses
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned int i = 0; i < depth; i++) {
+			hash ^= static_cast<uint64_t>(reinterpret_cast<uintptr_t>(frames[i]));
+			hash *= 1099511628211ull;
+		}
+		hash |= 1;		// 0 marks a free entry
+
+		while (s_SiteLock.test_and_set(std::memory_order_acquire)) {}
+		for (unsigned int probe = 0; probe < AllocationTracker::MAX_CALL_SITES; probe++) {
+			CallSite& site = s_Sites[(hash + probe) % AllocationTracker::MAX_CALL_SITES];
+			if (site.Hash == 0) {
+				site.Hash = hash;
+				site.Depth = depth;
+				std::copy(frames, frames + depth, site.Frames);
+			}
+			if (site.Hash == hash) {
+				site.Count++;
+				site.Bytes += size;
+				s_SiteLock.clear(std::memory_order_release);
+				return;
+			}
+		}
+		s_DroppedSites++;
+		s_SiteLock.clear(std::memory_order_release);
+	}
+
+	inline void RecordAllocation(size_t size) {
+		if (!s_Running.load(std::memory_order_relaxed) || t_Inside) return;
+		t_Inside = true;
+		s_Allocations.fetch_add(1, std::memory_order_relaxed);
+		s_Bytes.fetch_add(size, std::memory_order_relaxed);
+		if (s_CallSites.load(std::memory_order_relaxed)) RecordCallSite(size);
+		t_Inside = false;
+	}
+
+	inline void RecordFree(void* pointer) {
+		if (!pointer || !s_Running.load(std::memory_order_relaxed) || t_Inside) return;
+		s_Frees.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void PrintFrame(void* frame) {
+#if defined(_MSC_VER)
+		static bool initialized = false;
+		HANDLE process = GetCurrentProcess();
+		if (!initialized) {
+			SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+			SymInitialize(process, nullptr, TRUE);
+			initialized = true;
+		}
+		char buffer[sizeof(SYMBOL_INFO) + 256];
+		SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		symbol->MaxNameLen = 255;
+		DWORD64 displacement = 0;
+		if (SymFromAddr(process, reinterpret_cast<DWORD64>(frame), &displacement, symbol)) std::cout << symbol->Name;
+		else std::cout << frame;
+		IMAGEHLP_LINE64 line = {};
+		line.SizeOfStruct = sizeof(IMAGEHLP_LINE64);
+		DWORD column = 0;
+		if (SymGetLineFromAddr64(process, reinterpret_cast<DWORD64>(frame), &column, &line)) std::cout << " (" << line.FileName << ":" << line.LineNumber << ")";
+		std::cout << std::endl;
+#elif defined(__GLIBC__)
+		char** names = backtrace_symbols(&frame, 1);
+		std::cout << (names ? names[0] : "?") << std::endl;
+		std::free(names);
+#else
+		std::cout << frame << std::endl;
+#endif
+	}
+
+#if ALLOCATION_TRACKING && defined(_MSC_VER) && defined(_DEBUG)
+	int AllocationHook(int type, void* data, size_t size, int blockType, long, const unsigned char*, int) {
+		// The CRT's own bookkeeping is not ours to account for
+		if (blockType == _CRT_BLOCK) return TRUE;
+		if (type == _HOOK_ALLOC || type == _HOOK_REALLOC) RecordAllocation(size);
+		else if (type == _HOOK_FREE) RecordFree(data);
+		return TRUE;
+	}
+#endif
+}
+
+AllocationTracker& AllocationTracker::Get() {
+	static AllocationTracker tracker;
+	return tracker;
+}
+
+void AllocationTracker::Start(bool callSites) {
+	if (!IsAvailable()) {
+		std::cout << "ERROR::ALLOCATION_TRACKER::NOT_COMPILED_IN" << std::endl;
+		return;
+	}
+#if ALLOCATION_TRACKING && defined(_MSC_VER) && defined(_DEBUG)
+	_CrtSetAllocHook(AllocationHook);
+#endif
+	if (callSites) {
+		// The first backtrace loads the unwinder, which allocates; get that over with now
+		void* frames[MAX_DEPTH];
+		t_Inside = true;
+		CaptureBacktrace(frames);
+		t_Inside = false;
+	}
+	s_CallSites.store(callSites);
+	s_Running.store(true);
+}
+
+void AllocationTracker::Stop() {
+	s_Running.store(false);
+}
+
+bool AllocationTracker::IsRunning() const {
+	return s_Running.load();
+}
+
+AllocationCounts AllocationTracker::GetCounts() const {
+	AllocationCounts counts;
+	counts.Allocations = s_Allocations.load(std::memory_order_relaxed);
+	counts.Frees = s_Frees.load(std::memory_order_relaxed);
+	counts.Bytes = s_Bytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+void AllocationTracker::ClearCallSites() {
+	while (s_SiteLock.test_and_set(std::memory_order_acquire)) {}
+	for (CallSite& site : s_Sites) site = CallSite();
+	s_DroppedSites = 0;
+	s_SiteLock.clear(std::memory_order_release);
+}
+
+void AllocationTracker::PrintCallSites(unsigned int count) const {
+	const bool inside = t_Inside;
+	t_Inside = true;
+
+	// Copied out so symbolizing does not hold the lock the hooks take
+	static CallSite sites[MAX_CALL_SITES];
+	unsigned int used = 0;
+	while (s_SiteLock.test_and_set(std::memory_order_acquire)) {}
+	for (const CallSite& site : s_Sites) {
+		if (site.Hash) sites[used++] = site;
+	}
+	const size_t dropped = s_DroppedSites;
+	s_SiteLock.clear(std::memory_order_release);
+
+	std::sort(sites, sites + used, [](const CallSite& a, const CallSite& b) { return a.Count > b.Count; });
+	std::cout << "Allocation call sites: " << used;
+	if (dropped) std::cout << ", " << dropped << " allocations past a full table not attributed";
+	std::cout << std::endl;
+	for (unsigned int i = 0; i < std::min(count, used); i++) {
+		const CallSite& site = sites[i];
+		std::cout << "#" << i + 1 << ": " << site.Count << " allocations, " << site.Bytes << " bytes" << std::endl;
+		for (unsigned int frame = 0; frame < site.Depth; frame++) {
+			std::cout << "    ";
+			PrintFrame(site.Frames[frame]);
+		}
+	}
+	t_Inside = inside;
+}
+
+#if ALLOCATION_TRACKING && defined(__GLIBC__)
+// Interposed over the C library's allocator, which stays reachable under its internal names
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* pointer, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void __libc_free(void* pointer);
+
+	void* malloc(size_t size) {
+		RecordAllocation(size);
+		return __libc_malloc(size);
+	}
+	void* calloc(size_t count, size_t size) {
+		RecordAllocation(count * size);
+		return __libc_calloc(count, size);
+	}
+	void* realloc(void* pointer, size_t size) {
+		if (size) RecordAllocation(size);
+		else RecordFree(pointer);
+		return __libc_realloc(pointer, size);
+	}
+	void* memalign(size_t alignment, size_t size) {
+		RecordAllocation(size);
+		return __libc_memalign(alignment, size);
+	}
+	void* aligned_alloc(size_t alignment, size_t size) {
+		RecordAllocation(size);
+		return __libc_memalign(alignment, size);
+	}
+	int posix_memalign(void** pointer, size_t alignment, size_t size) {
+		// No internal name to forward to, memalign does the work after the checks it skips
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+		RecordAllocation(size);
+		void* result = __libc_memalign(alignment, size);
+		if (!result) return ENOMEM;
+		*pointer = result;
+		return 0;
+	}
+	void free(void* pointer) {
+		RecordFree(pointer);
+		__libc_free(pointer);
+	}
+}
+#elif ALLOCATION_TRACKING && !(defined(_MSC_VER) && defined(_DEBUG))
+// Replacement global operators, the standard allows a program to provide its own
+void* operator new(size_t size) {
+	RecordAllocation(size);
+	if (void* pointer = std::malloc(size ? size : 1)) return pointer;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	RecordAllocation(size);
+	return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept {
+	return operator new(size, nothrow);
+}
+void operator delete(void* pointer) noexcept {
+	RecordFree(pointer);
+	std::free(pointer);
+}
+void operator delete[](void* pointer) noexcept {
+	operator delete(pointer);
+}
+void operator delete(void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+void operator delete[](void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+	operator delete(pointer);
+}
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+	operator delete(pointer);
+}
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap hooks compiled in, idle until the tracker is started. On by default in debug
+// builds only; define as 1 to track a release build, or 0 to leave the allocator untouched.
+// What gets hooked depends on the runtime:
+//  - MSVC debug CRT: the CRT allocation hook, malloc and operator new alike
+//  - MSVC release: the global operator new and delete, malloc is not seen
+//  - glibc: malloc, calloc, realloc, memalign, aligned_alloc, posix_memalign and free,
+//    operator new goes through them; the obsolete valloc and pvalloc are not seen
+#ifndef ALLOCATION_TRACKING
+	#ifdef _DEBUG
+		#define ALLOCATION_TRACKING 1
+	#else
+		#define ALLOCATION_TRACKING 0
+	#endif
+#endif
+
+struct AllocationCounts {
+	size_t Allocations;
+	size_t Frees;
+	size_t Bytes;
+};
+
+// Counts heap allocations on every thread while running, and optionally where they came
+// from: each allocation's backtrace is hashed into a fixed table of call sites, so the
+// tracker itself never allocates. For checking that steady-state frames stay off the heap;
+// snapshot the counts around a frame and compare.
+class AllocationTracker {
+public:
+	enum : unsigned int { MAX_CALL_SITES = 1024, MAX_DEPTH = 16 };
+
+	static AllocationTracker& Get();
+
+	// callSites = false only counts, which is far cheaper than taking a backtrace each time
+	void Start(bool callSites = true);
+	void Stop();
+	bool IsRunning() const;
+	inline bool IsAvailable() const { return ALLOCATION_TRACKING != 0; }
+
+	// Since the first Start, on all threads
+	AllocationCounts GetCounts() const;
+
+	void ClearCallSites();
+	// The call sites with the most allocations, symbolized where debug info allows
+	void PrintCallSites(unsigned int count = 10) const;
+
+private:
+	AllocationTracker() {}
+	AllocationTracker(const AllocationTracker&) = delete;
+	AllocationTracker& operator=(const AllocationTracker&) = delete;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+
+#include "glm.hpp"
+
+// Axis aligned bounding box, an empty box has Min > Max on every axis
+struct AABB {
+	glm::vec3 Min = glm::vec3(1e30f);
+	glm::vec3 Max = glm::vec3(-1e30f);
+
+	AABB() = default;
+	AABB(const glm::vec3& min, const glm::vec3& max) : Min(min), Max(max) {}
+
+	inline void Grow(const glm::vec3& point) { Min = glm::min(Min, point); Max = glm::max(Max, point); }
+	inline void Grow(const AABB& box) { Min = glm::min(Min, box.Min); Max = glm::max(Max, box.Max); }
+
+	inline glm::vec3 GetCenter() const { return (Min + Max) * 0.5f; }
+	inline glm::vec3 GetExtent() const { return Max - Min; }
+	inline bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+	inline float GetSurfaceArea() const {
+		if (IsEmpty()) return 0.0f;
+		glm::vec3 e = Max - Min;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	inline bool Overlaps(const AABB& other) const {
+		return Min.x <= other.Max.x && Max.x >= other.Min.x &&
+			   Min.y <= other.Max.y && Max.y >= other.Min.y &&
+			   Min.z <= other.Max.z && Max.z >= other.Min.z;
+	}
+
+	// Squared distance from a point to the box, 0 inside
+	inline float DistanceSquared(const glm::vec3& point) const {
+		glm::vec3 d = glm::max(glm::max(Min - point, point - Max), glm::vec3(0.0f));
+		return glm::dot(d, d);
+	}
+};
+
+struct Ray {
+	glm::vec3 Origin;
+	glm::vec3 Direction;
+	float MaxDistance = 1e30f;
+};
+
+struct RayHit {
+	unsigned int Primitive = 0xFFFFFFFFu;
+	float Distance = 1e30f;
+
+	inline bool IsHit() const { return Primitive != 0xFFFFFFFFu; }
+};
+
+// Reciprocal direction for the slab test. A zero component becomes a huge finite value
+// rather than infinity: a ray starting on a slab plane then gives 0 instead of 0 * inf = NaN.
+inline glm::vec3 InverseDirection(const glm::vec3& direction) {
+	glm::vec3 inverse;
+	for (int i = 0; i < 3; i++) {
+		inverse[i] = std::fabs(direction[i]) > 1e-30f ? 1.0f / direction[i] : std::copysign(1e30f, direction[i]);
+	}
+	return inverse;
+}
+
+// Slab test, invDirection from InverseDirection(), returns the entry distance in tmin (0 when starting inside)
+inline bool IntersectRayBox(const Ray& ray, const glm::vec3& invDirection, const AABB& box, float& tmin) {
+	glm::vec3 t1 = (box.Min - ray.Origin) * invDirection;
+	glm::vec3 t2 = (box.Max - ray.Origin) * invDirection;
+	glm::vec3 tNear = glm::min(t1, t2);
+	glm::vec3 tFar = glm::max(t1, t2);
+	float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+	float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, ray.MaxDistance));
+	tmin = enter;
+	return enter <= exit;
+}
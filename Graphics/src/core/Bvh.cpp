@@ -0,0 +1,607 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+
+#include "gtc/matrix_transform.hpp"
+
+#include "Bvh.h"
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+
+#if CPU_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace {
+	const unsigned int SAH_BINS = 12;
+	// Subtrees smaller than this are not worth a job of their own
+	const unsigned int PARALLEL_BUILD_THRESHOLD = 4096;
+	// Past this depth nodes split at the median, which bounds the depth by MEDIAN_SPLIT_DEPTH + 32
+	// however skewed the SAH splits get. Traversal keeps at most three siblings per level of the
+	// collapsed tree, no deeper than the binary one, plus the four children just pushed.
+	const unsigned int MEDIAN_SPLIT_DEPTH = 48;
+	const unsigned int TRAVERSAL_STACK_SIZE = 256;
+	static_assert(TRAVERSAL_STACK_SIZE >= 3 * (MEDIAN_SPLIT_DEPTH + 32) + 4, "traversal stack too small for the deepest tree");
+}
+
+struct Bvh::BuildNode {
+	AABB Box;
+	unsigned int First = 0;
+	unsigned int Count = 0;
+	std::unique_ptr<BuildNode> Left;
+	std::unique_ptr<BuildNode> Right;
+
+	inline bool IsLeaf() const { return !Left; }
+};
+
+struct Bvh::BuildContext {
+	const std::vector<AABB>& Bounds;
+	std::vector<glm::vec3> Centroids;
+	std::vector<unsigned int>& Indices;
+
+	BuildContext(const std::vector<AABB>& bounds, std::vector<unsigned int>& indices) :
+		Bounds(bounds), Indices(indices) {}
+};
+
+Bvh::Bvh() : m_MaxLeafSize(4) {
+}
+
+void Bvh::Clear() {
+	m_Nodes.clear();
+	m_Primitives.clear();
+	m_Bounds.clear();
+}
+
+void Bvh::Build(const std::vector<AABB>& bounds) {
+	Clear();
+	if (bounds.empty()) return;
+
+	m_Primitives.resize(bounds.size());
+	std::iota(m_Primitives.begin(), m_Primitives.end(), 0u);
+
+	BuildContext context(bounds, m_Primitives);
+	context.Centroids.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); i++) {
+		context.Centroids[i] = bounds[i].GetCenter();
+	}
+
+	BuildNode root;
+	BuildRecursive(context, root, 0, static_cast<unsigned int>(bounds.size()), 0);
+
+	m_Nodes.reserve(bounds.size() / 2 + 1);
+	Flatten(root);
+
+	m_Bounds.resize(bounds.size());
+	for (size_t i = 0; i < m_Primitives.size(); i++) {
+		m_Bounds[i] = bounds[m_Primitives[i]];
+	}
+}
+
+void Bvh::BuildRecursive(BuildContext& context, BuildNode& node, unsigned int first, unsigned int count, unsigned int depth) {
+	node.First = first;
+	node.Count = count;
+
+	AABB centroidBox;
+	for (unsigned int i = first; i < first + count; i++) {
+		const unsigned int primitive = context.Indices[i];
+		node.Box.Grow(context.Bounds[primitive]);
+		centroidBox.Grow(context.Centroids[primitive]);
+	}
+	if (count <= 1) return;
+
+	const glm::vec3 extent = centroidBox.GetExtent();
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	unsigned int* begin = context.Indices.data() + first;
+	unsigned int* end = begin + count;
+	unsigned int* middle = begin + count / 2;
+
+	if (depth >= MEDIAN_SPLIT_DEPTH) {
+		if (count <= m_MaxLeafSize) return;
+		if (extent[axis] > 0.0f) {
+			std::nth_element(begin, middle, end, [&](unsigned int a, unsigned int b) {
+				return context.Centroids[a][axis] < context.Centroids[b][axis];
+			});
+		}
+	}
+	else if (extent[axis] > 0.0f) {
+		// Binned SAH: bucket centroids along the widest axis and sweep the bucket boundaries
+		const float scale = SAH_BINS * (1.0f - 1e-5f) / extent[axis];
+		const float origin = centroidBox.Min[axis];
+		auto binOf = [&](unsigned int primitive) {
+			return static_cast<unsigned int>((context.Centroids[primitive][axis] - origin) * scale);
+		};
+
+		AABB binBox[SAH_BINS];
+		unsigned int binCount[SAH_BINS] = {};
+		for (unsigned int* it = begin; it != end; ++it) {
+			const unsigned int bin = binOf(*it);
+			binBox[bin].Grow(context.Bounds[*it]);
+			binCount[bin]++;
+		}
+
+		float rightArea[SAH_BINS];
+		unsigned int rightCount[SAH_BINS];
+		AABB sweep;
+		unsigned int sweepCount = 0;
+		for (unsigned int i = SAH_BINS - 1; i > 0; i--) {
+			sweep.Grow(binBox[i]);
+			sweepCount += binCount[i];
+			rightArea[i] = sweep.GetSurfaceArea();
+			rightCount[i] = sweepCount;
+		}
+
+		float bestCost = 1e30f;
+		unsigned int bestSplit = 0;
+		sweep = AABB();
+		sweepCount = 0;
+		for (unsigned int i = 1; i < SAH_BINS; i++) {
+			sweep.Grow(binBox[i - 1]);
+			sweepCount += binCount[i - 1];
+			if (sweepCount == 0 || rightCount[i] == 0) continue;
+			const float cost = sweep.GetSurfaceArea() * sweepCount + rightArea[i] * rightCount[i];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+
+		// Relative to one box test, compare splitting against testing every primitive here
+		const float area = node.Box.GetSurfaceArea();
+		const float splitCost = area > 0.0f ? 1.0f + bestCost / area : 1e30f;
+		if (count <= m_MaxLeafSize && splitCost >= static_cast<float>(count)) return;
+
+		if (bestSplit > 0) {
+			middle = std::partition(begin, end, [&](unsigned int primitive) { return binOf(primitive) < bestSplit; });
+		}
+		if (middle == begin || middle == end) {
+			middle = begin + count / 2;
+			std::nth_element(begin, middle, end, [&](unsigned int a, unsigned int b) {
+				return context.Centroids[a][axis] < context.Centroids[b][axis];
+			});
+		}
+	}
+	else if (count <= m_MaxLeafSize) {
+		return;
+	}
+
+	const unsigned int leftCount = static_cast<unsigned int>(middle - begin);
+	node.Left.reset(new BuildNode());
+	node.Right.reset(new BuildNode());
+
+	// Hand large left subtrees to a job while this one builds the right side
+	if (count >= PARALLEL_BUILD_THRESHOLD && JobSystem::Get().GetWorkerCount() > 1) {
+		JobCounter left;
+		JobSystem::Get().Run([&]() { BuildRecursive(context, *node.Left, first, leftCount, depth + 1); }, &left);
+		BuildRecursive(context, *node.Right, first + leftCount, count - leftCount, depth + 1);
+		JobSystem::Get().Wait(left);
+	}
+	else {
+		BuildRecursive(context, *node.Left, first, leftCount, depth + 1);
+		BuildRecursive(context, *node.Right, first + leftCount, count - leftCount, depth + 1);
+	}
+}
+
+unsigned int Bvh::Flatten(const BuildNode& node) {
+	const unsigned int index = static_cast<unsigned int>(m_Nodes.size());
+	m_Nodes.push_back(Node());
+
+	// Pull grandchildren up until there are four children, opening the largest ones first
+	const BuildNode* children[4];
+	unsigned int childCount = 0;
+	if (node.IsLeaf()) {
+		children[childCount++] = &node;
+	}
+	else {
+		children[childCount++] = node.Left.get();
+		children[childCount++] = node.Right.get();
+		while (childCount < 4) {
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (unsigned int i = 0; i < childCount; i++) {
+				if (children[i]->IsLeaf()) continue;
+				const float area = children[i]->Box.GetSurfaceArea();
+				if (area > largestArea) {
+					largestArea = area;
+					largest = static_cast<int>(i);
+				}
+			}
+			if (largest < 0) break;
+			const BuildNode* opened = children[largest];
+			children[largest] = opened->Left.get();
+			children[childCount++] = opened->Right.get();
+		}
+	}
+
+	for (unsigned int i = 0; i < childCount; i++) {
+		// Recursing may grow m_Nodes, so only touch the node through its index
+		const unsigned int child = children[i]->IsLeaf() ? LEAF : Flatten(*children[i]);
+		Node& flat = m_Nodes[index];
+		SetChild(flat, i, children[i]->Box);
+		flat.Child[i] = child;
+		flat.First[i] = children[i]->First;
+		flat.Count[i] = children[i]->Count;
+	}
+	m_Nodes[index].ChildCount = childCount;
+	return index;
+}
+
+void Bvh::Refit(const std::vector<AABB>& bounds) {
+	for (size_t i = 0; i < m_Primitives.size(); i++) {
+		m_Bounds[i] = bounds[m_Primitives[i]];
+	}
+
+	// Children come after their parent, so a reverse sweep visits them first
+	for (size_t n = m_Nodes.size(); n-- > 0;) {
+		Node& node = m_Nodes[n];
+		for (unsigned int i = 0; i < node.ChildCount; i++) {
+			AABB box;
+			if (node.Child[i] == LEAF) {
+				for (unsigned int p = node.First[i]; p < node.First[i] + node.Count[i]; p++) {
+					box.Grow(m_Bounds[p]);
+				}
+			}
+			else {
+				const Node& child = m_Nodes[node.Child[i]];
+				for (unsigned int c = 0; c < child.ChildCount; c++) {
+					box.Grow(GetChild(child, c));
+				}
+			}
+			SetChild(node, i, box);
+		}
+	}
+}
+
+AABB Bvh::GetBounds() const {
+	AABB box;
+	if (m_Nodes.empty()) return box;
+	for (unsigned int i = 0; i < m_Nodes[0].ChildCount; i++) {
+		box.Grow(GetChild(m_Nodes[0], i));
+	}
+	return box;
+}
+
+void Bvh::SetChild(Node& node, unsigned int slot, const AABB& box) {
+	node.MinX[slot] = box.Min.x;
+	node.MinY[slot] = box.Min.y;
+	node.MinZ[slot] = box.Min.z;
+	node.MaxX[slot] = box.Max.x;
+	node.MaxY[slot] = box.Max.y;
+	node.MaxZ[slot] = box.Max.z;
+}
+
+AABB Bvh::GetChild(const Node& node, unsigned int slot) {
+	return AABB(glm::vec3(node.MinX[slot], node.MinY[slot], node.MinZ[slot]),
+				glm::vec3(node.MaxX[slot], node.MaxY[slot], node.MaxZ[slot]));
+}
+
+// Per node tests, bit i of the results refers to child slot i
+
+static unsigned int ValidMask(const Bvh::Node& node) {
+	return (1u << node.ChildCount) - 1;
+}
+
+// visible: box not outside any plane, inside: box completely inside every plane
+static void ClassifyChildren(const Bvh::Node& node, const Frustum& frustum, unsigned int& visible, unsigned int& inside) {
+#if CPU_SSE2
+	__m128 outside = _mm_setzero_ps();
+	__m128 straddle = _mm_setzero_ps();
+	for (const glm::vec4& p : frustum.Planes) {
+		const __m128 px = _mm_loadu_ps(p.x > 0.0f ? node.MaxX : node.MinX);
+		const __m128 py = _mm_loadu_ps(p.y > 0.0f ? node.MaxY : node.MinY);
+		const __m128 pz = _mm_loadu_ps(p.z > 0.0f ? node.MaxZ : node.MinZ);
+		const __m128 nx = _mm_loadu_ps(p.x > 0.0f ? node.MinX : node.MaxX);
+		const __m128 ny = _mm_loadu_ps(p.y > 0.0f ? node.MinY : node.MaxY);
+		const __m128 nz = _mm_loadu_ps(p.z > 0.0f ? node.MinZ : node.MaxZ);
+		const __m128 a = _mm_set1_ps(p.x), b = _mm_set1_ps(p.y), c = _mm_set1_ps(p.z), w = _mm_set1_ps(p.w);
+
+		__m128 farDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, a), _mm_mul_ps(py, b)), _mm_add_ps(_mm_mul_ps(pz, c), w));
+		__m128 nearDistance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, a), _mm_mul_ps(ny, b)), _mm_add_ps(_mm_mul_ps(nz, c), w));
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(farDistance, _mm_setzero_ps()));
+		straddle = _mm_or_ps(straddle, _mm_cmplt_ps(nearDistance, _mm_setzero_ps()));
+	}
+	const unsigned int valid = ValidMask(node);
+	visible = ~static_cast<unsigned int>(_mm_movemask_ps(outside)) & valid;
+	inside = visible & ~static_cast<unsigned int>(_mm_movemask_ps(straddle));
+#else
+	visible = 0;
+	inside = 0;
+	for (unsigned int i = 0; i < node.ChildCount; i++) {
+		bool out = false, cut = false;
+		for (const glm::vec4& p : frustum.Planes) {
+			float farDistance = p.x * (p.x > 0.0f ? node.MaxX[i] : node.MinX[i]) + p.y * (p.y > 0.0f ? node.MaxY[i] : node.MinY[i]) +
+						p.z * (p.z > 0.0f ? node.MaxZ[i] : node.MinZ[i]) + p.w;
+			float nearDistance = p.x * (p.x > 0.0f ? node.MinX[i] : node.MaxX[i]) + p.y * (p.y > 0.0f ? node.MinY[i] : node.MaxY[i]) +
+						 p.z * (p.z > 0.0f ? node.MinZ[i] : node.MaxZ[i]) + p.w;
+			out |= farDistance < 0.0f;
+			cut |= nearDistance < 0.0f;
+		}
+		if (!out) visible |= 1u << i;
+		if (!out && !cut) inside |= 1u << i;
+	}
+#endif
+}
+
+static unsigned int IntersectChildren(const Bvh::Node& node, const Ray& ray, const glm::vec3& invDirection, float maxDistance, float enter[4]) {
+#if CPU_SSE2
+	const __m128 ox = _mm_set1_ps(ray.Origin.x), oy = _mm_set1_ps(ray.Origin.y), oz = _mm_set1_ps(ray.Origin.z);
+	const __m128 ix = _mm_set1_ps(invDirection.x), iy = _mm_set1_ps(invDirection.y), iz = _mm_set1_ps(invDirection.z);
+
+	const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinX), ox), ix);
+	const __m128 x2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxX), ox), ix);
+	const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinY), oy), iy);
+	const __m128 y2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxY), oy), iy);
+	const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinZ), oz), iz);
+	const __m128 z2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxZ), oz), iz);
+
+	__m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(x1, x2), _mm_min_ps(y1, y2)), _mm_max_ps(_mm_min_ps(z1, z2), _mm_setzero_ps()));
+	__m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(x1, x2), _mm_max_ps(y1, y2)), _mm_min_ps(_mm_max_ps(z1, z2), _mm_set1_ps(maxDistance)));
+	_mm_storeu_ps(enter, tmin);
+	return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tmin, tmax))) & ValidMask(node);
+#else
+	unsigned int mask = 0;
+	Ray clipped = ray;
+	clipped.MaxDistance = maxDistance;
+	for (unsigned int i = 0; i < node.ChildCount; i++) {
+		AABB box(glm::vec3(node.MinX[i], node.MinY[i], node.MinZ[i]), glm::vec3(node.MaxX[i], node.MaxY[i], node.MaxZ[i]));
+		if (IntersectRayBox(clipped, invDirection, box, enter[i])) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+static unsigned int OverlapChildren(const Bvh::Node& node, const glm::vec3& center, float radius) {
+#if CPU_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+	const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.MinX), cx), _mm_sub_ps(cx, _mm_loadu_ps(node.MaxX))), zero);
+	const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.MinY), cy), _mm_sub_ps(cy, _mm_loadu_ps(node.MaxY))), zero);
+	const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.MinZ), cz), _mm_sub_ps(cz, _mm_loadu_ps(node.MaxZ))), zero);
+	const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(radius * radius)))) & ValidMask(node);
+#else
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < node.ChildCount; i++) {
+		AABB box(glm::vec3(node.MinX[i], node.MinY[i], node.MinZ[i]), glm::vec3(node.MaxX[i], node.MaxY[i], node.MaxZ[i]));
+		if (box.DistanceSquared(center) <= radius * radius) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+size_t Bvh::CullFrustum(const Frustum& frustum, std::vector<unsigned int>& visible) const {
+	visible.clear();
+	if (m_Nodes.empty()) return 0;
+
+	unsigned int stack[TRAVERSAL_STACK_SIZE];
+	unsigned int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const Node& node = m_Nodes[stack[--top]];
+		unsigned int visibleMask, insideMask;
+		ClassifyChildren(node, frustum, visibleMask, insideMask);
+
+		for (unsigned int i = 0; i < node.ChildCount; i++) {
+			if (!(visibleMask & (1u << i))) continue;
+			const unsigned int first = node.First[i];
+			const unsigned int last = first + node.Count[i];
+
+			if (insideMask & (1u << i)) {
+				visible.insert(visible.end(), m_Primitives.begin() + first, m_Primitives.begin() + last);
+			}
+			else if (node.Child[i] == LEAF) {
+				for (unsigned int p = first; p < last; p++) {
+					if (frustum.ContainsBox(m_Bounds[p].Min, m_Bounds[p].Max)) visible.push_back(m_Primitives[p]);
+				}
+			}
+			else {
+				stack[top++] = node.Child[i];
+			}
+		}
+	}
+	return visible.size();
+}
+
+bool Bvh::Raycast(const Ray& ray, RayHit& hit) const {
+	hit = RayHit();
+	if (m_Nodes.empty()) return false;
+
+	const glm::vec3 invDirection = InverseDirection(ray.Direction);
+	float closest = ray.MaxDistance;
+
+	struct Entry { unsigned int node; float distance; };
+	Entry stack[TRAVERSAL_STACK_SIZE];
+	unsigned int top = 0;
+	stack[top++] = { 0, 0.0f };
+
+	while (top > 0) {
+		const Entry entry = stack[--top];
+		if (entry.distance > closest) continue;
+		const Node& node = m_Nodes[entry.node];
+
+		float enter[4];
+		unsigned int mask = IntersectChildren(node, ray, invDirection, closest, enter);
+
+		// Push inner children farthest first so the nearest one is visited next
+		Entry children[4];
+		unsigned int childCount = 0;
+		for (unsigned int i = 0; i < node.ChildCount; i++) {
+			if (!(mask & (1u << i))) continue;
+			if (node.Child[i] == LEAF) {
+				for (unsigned int p = node.First[i]; p < node.First[i] + node.Count[i]; p++) {
+					Ray clipped = ray;
+					clipped.MaxDistance = closest;
+					float distance;
+					if (IntersectRayBox(clipped, invDirection, m_Bounds[p], distance) && distance < closest) {
+						closest = distance;
+						hit.Primitive = m_Primitives[p];
+						hit.Distance = distance;
+					}
+				}
+			}
+			else {
+				Entry child = { node.Child[i], enter[i] };
+				unsigned int j = childCount++;
+				while (j > 0 && children[j - 1].distance < child.distance) {
+					children[j] = children[j - 1];
+					j--;
+				}
+				children[j] = child;
+			}
+		}
+		for (unsigned int i = 0; i < childCount; i++) {
+			stack[top++] = children[i];
+		}
+	}
+	return hit.IsHit();
+}
+
+void Bvh::RaycastBatch(const Ray* rays, size_t count, RayHit* hits) const {
+	// Rays are independent, each job takes a run of them through the whole tree
+	JobSystem::Get().ParallelFor(0, count, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) Raycast(rays[i], hits[i]);
+	}, 256);
+}
+
+size_t Bvh::QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& result) const {
+	result.clear();
+	if (m_Nodes.empty()) return 0;
+
+	unsigned int stack[TRAVERSAL_STACK_SIZE];
+	unsigned int top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const Node& node = m_Nodes[stack[--top]];
+		const unsigned int mask = OverlapChildren(node, center, radius);
+		for (unsigned int i = 0; i < node.ChildCount; i++) {
+			if (!(mask & (1u << i))) continue;
+			if (node.Child[i] != LEAF) {
+				stack[top++] = node.Child[i];
+				continue;
+			}
+			for (unsigned int p = node.First[i]; p < node.First[i] + node.Count[i]; p++) {
+				if (m_Bounds[p].DistanceSquared(center) <= radius * radius) result.push_back(m_Primitives[p]);
+			}
+		}
+	}
+	return result.size();
+}
+
+static std::vector<AABB> RandomBoxes(size_t count, float worldSize, float maxSize, std::mt19937& random) {
+	std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+	std::uniform_real_distribution<float> size(0.0f, maxSize);
+	std::vector<AABB> boxes(count);
+	for (AABB& box : boxes) {
+		box.Min = glm::vec3(position(random), position(random), position(random));
+		box.Max = box.Min + glm::vec3(size(random), size(random), size(random));
+	}
+	return boxes;
+}
+
+// Every query of the tree against a loop over all boxes, returns the number of mismatches
+static unsigned int CheckBvh(const Bvh& bvh, const std::vector<AABB>& boxes, float worldSize, std::mt19937& random, const char* name) {
+	std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	unsigned int failures = 0;
+	auto check = [&failures, name](bool passed, const char* what, size_t query) {
+		if (passed) return;
+		std::cout << "ERROR::BVH_TEST::" << what << " " << name << " query " << query << std::endl;
+		failures++;
+	};
+
+	std::vector<unsigned int> found, expected;
+	auto sameSet = [&found, &expected]() {
+		std::sort(found.begin(), found.end());
+		std::sort(expected.begin(), expected.end());
+		return found == expected;
+	};
+
+	for (size_t query = 0; query < 16; query++) {
+		const glm::vec3 eye(position(random), position(random), position(random));
+		const glm::vec3 target(position(random), position(random), position(random));
+		const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 0.5f * worldSize) *
+			glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+		const Frustum frustum = Frustum::FromMatrix(viewProjection);
+		bvh.CullFrustum(frustum, found);
+		expected.clear();
+		for (unsigned int i = 0; i < boxes.size(); i++) {
+			if (frustum.ContainsBox(boxes[i].Min, boxes[i].Max)) expected.push_back(i);
+		}
+		check(sameSet(), "FRUSTUM", query);
+	}
+
+	// Some rays axis-parallel, some starting inside boxes, some limited in length
+	const size_t rayCount = 512;
+	std::vector<Ray> rays(rayCount);
+	for (size_t i = 0; i < rayCount; i++) {
+		Ray& ray = rays[i];
+		ray.Origin = i % 8 == 0 ? boxes[i % boxes.size()].GetCenter() : glm::vec3(position(random), position(random), position(random));
+		ray.Direction = i % 4 == 1 ? glm::vec3(0.0f, 0.0f, i % 8 < 4 ? 1.0f : -1.0f) : glm::vec3(direction(random), direction(random), direction(random));
+		if (i % 16 == 3) ray.MaxDistance = 0.1f * worldSize;
+	}
+	std::vector<RayHit> hits(rayCount);
+	bvh.RaycastBatch(rays.data(), rayCount, hits.data());
+	for (size_t i = 0; i < rayCount; i++) {
+		const glm::vec3 invDirection = InverseDirection(rays[i].Direction);
+		RayHit closest;
+		for (unsigned int p = 0; p < boxes.size(); p++) {
+			float distance;
+			if (IntersectRayBox(rays[i], invDirection, boxes[p], distance) && distance < closest.Distance) {
+				closest.Primitive = p;
+				closest.Distance = distance;
+			}
+		}
+		RayHit single;
+		bvh.Raycast(rays[i], single);
+		// Boxes hit at the same distance may come back in either order, compare the distance
+		check(hits[i].IsHit() == closest.IsHit() && (!closest.IsHit() || hits[i].Distance == closest.Distance), "RAY", i);
+		check(single.Primitive == hits[i].Primitive && single.Distance == hits[i].Distance, "RAY_BATCH", i);
+	}
+
+	for (size_t query = 0; query < 64; query++) {
+		const glm::vec3 center(position(random), position(random), position(random));
+		const float radius = query % 2 ? 0.02f * worldSize : 0.1f * worldSize;
+		bvh.QuerySphere(center, radius, found);
+		expected.clear();
+		for (unsigned int i = 0; i < boxes.size(); i++) {
+			if (boxes[i].DistanceSquared(center) <= radius * radius) expected.push_back(i);
+		}
+		check(sameSet(), "SPHERE", query);
+	}
+	return failures;
+}
+
+unsigned int RunBvhTest() {
+	std::mt19937 random(42);
+	unsigned int failures = 0;
+
+	// Scattered objects, then the same ones moved a little and refitted
+	const float worldSize = 200.0f;
+	std::vector<AABB> boxes = RandomBoxes(100000, worldSize, 2.0f, random);
+	Bvh bvh;
+	bvh.Build(boxes);
+	failures += CheckBvh(bvh, boxes, worldSize, random, "built");
+
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	for (AABB& box : boxes) {
+		const glm::vec3 move(offset(random), offset(random), offset(random));
+		box.Min += move;
+		box.Max += move;
+	}
+	bvh.Refit(boxes);
+	failures += CheckBvh(bvh, boxes, worldSize, random, "refitted");
+
+	// Piled up in one spot and on one line, where SAH finds no split and the tree gets deep
+	std::vector<AABB> pile(20000, AABB(glm::vec3(1.0f), glm::vec3(2.0f)));
+	for (size_t i = 0; i < 5000; i++) pile[i] = AABB(glm::vec3(i * 1e-3f, 0.0f, 0.0f), glm::vec3(i * 1e-3f + 0.5f, 0.5f, 0.5f));
+	bvh.Build(pile);
+	failures += CheckBvh(bvh, pile, 10.0f, random, "pile");
+
+	return failures;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+// Bounding volume hierarchy over a fixed set of primitives (scene objects or triangles),
+// each given by its AABB. Built with the binned surface area heuristic, then collapsed
+// into 4-wide nodes whose child boxes are tested together with SSE.
+// Nodes are stored depth first in one array, children always after their parent.
+class Bvh {
+public:
+	struct Node {
+		// Child boxes, one lane per child. Read with unaligned loads, std::vector in C++14
+		// only promises the alignment of new, 8 bytes on 32-bit Windows
+		float MinX[4];
+		float MinY[4];
+		float MinZ[4];
+		float MaxX[4];
+		float MaxY[4];
+		float MaxZ[4];
+		// Node index for inner children, LEAF for leaves
+		unsigned int Child[4];
+		// Range in the primitive order covered by the child's whole subtree
+		unsigned int First[4];
+		unsigned int Count[4];
+		unsigned int ChildCount;
+	};
+
+	enum : unsigned int { LEAF = 0xFFFFFFFFu };
+
+private:
+	std::vector<Node> m_Nodes;
+	std::vector<unsigned int> m_Primitives;	// primitive ids in tree order
+	std::vector<AABB> m_Bounds;				// bounds in tree order
+	unsigned int m_MaxLeafSize;
+
+public:
+	Bvh();
+
+	// Large subtrees are built as jobs when the job system runs
+	void Build(const std::vector<AABB>& bounds);
+	// Updates boxes for primitives that moved a little, keeps the topology
+	void Refit(const std::vector<AABB>& bounds);
+	void Clear();
+
+	// Hierarchical culling, subtrees fully inside the frustum are accepted without further tests
+	size_t CullFrustum(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+	// Closest primitive box hit by the ray
+	bool Raycast(const Ray& ray, RayHit& hit) const;
+	// Many rays at once, e.g. every pick of a frame, spread over the job system when it runs
+	void RaycastBatch(const Ray* rays, size_t count, RayHit* hits) const;
+	// Primitives whose box touches the sphere, e.g. for camera collision
+	size_t QuerySphere(const glm::vec3& center, float radius, std::vector<unsigned int>& result) const;
+
+	inline void SetMaxLeafSize(unsigned int size) { m_MaxLeafSize = size; }
+	inline size_t GetNodeCount() const { return m_Nodes.size(); }
+	inline size_t GetPrimitiveCount() const { return m_Primitives.size(); }
+	AABB GetBounds() const;
+
+private:
+	struct BuildNode;
+	struct BuildContext;
+
+	void BuildRecursive(BuildContext& context, BuildNode& node, unsigned int first, unsigned int count, unsigned int depth);
+	unsigned int Flatten(const BuildNode& node);
+	static void SetChild(Node& node, unsigned int slot, const AABB& box);
+	static AABB GetChild(const Node& node, unsigned int slot);
+};
+
+// Builds trees over random boxes and compares CullFrustum, Raycast, RaycastBatch and
+// QuerySphere with brute force, before and after moving the boxes and refitting.
+// Prints every case that fails and returns the number of failures.
+unsigned int RunBvhTest();
@@ -4,7 +4,13 @@ Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch) :
 	Front(glm::vec3(0.0f, 0.0f, -1.0f)), 
 	MovementSpeed(SPEED),
 	MouseSensitivity(SENSITIVITY),
-	Zoom(ZOOM)
+	Zoom(ZOOM),
+	m_AspectRatio(4.0f / 3.0f),
+	m_NearPlane(NEAR_PLANE),
+	m_FarPlane(FAR_PLANE),
+	m_VectorsDirty(true),
+	m_ViewDirty(true),
+	m_ProjectionDirty(true)
 {
 	Position = position;
 	WorldUp = up;
@@ -17,7 +23,13 @@ Camera::Camera(float posX, float posY, float posZ, float upX, float upY, float u
 	Front(glm::vec3(0.0f, 0.0f, -1.0f)),
 	MovementSpeed(SPEED),
 	MouseSensitivity(SENSITIVITY),
-	Zoom(ZOOM)
+	Zoom(ZOOM),
+	m_AspectRatio(4.0f / 3.0f),
+	m_NearPlane(NEAR_PLANE),
+	m_FarPlane(FAR_PLANE),
+	m_VectorsDirty(true),
+	m_ViewDirty(true),
+	m_ProjectionDirty(true)
 {
 	Position = glm::vec3(posX, posY, posZ);
 	WorldUp = glm::vec3(upX, upY, upZ);
@@ -27,11 +39,14 @@ Camera::Camera(float posX, float posY, float posZ, float upX, float upY, float u
 }
 
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime) {
+	// Moving needs the current basis, a pending mouse rotation has to be applied first
+	if (m_VectorsDirty) updateCameraVectors();
 	float velocity = MovementSpeed * deltaTime;
 	if (direction == FORWARD)	Position += Front * velocity;
 	if (direction == BACKWARD)	Position -= Front * velocity;
 	if (direction == LEFT)		Position -= Right * velocity;
 	if (direction == RIGHT)		Position += Right * velocity;
+	m_ViewDirty = true;
 }
 
 void Camera::ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch) {
@@ -46,13 +61,53 @@ void Camera::ProcessMouseMovement(float xoffset, float yoffset, GLboolean constr
 		if (Pitch >  89.0f) Pitch =  89.0f;
 		if (Pitch < -89.0f) Pitch = -89.0f;
 	}
-	updateCameraVectors();
+	// Several mouse events can arrive per frame, the trig runs once when the basis is needed
+	m_VectorsDirty = true;
+	m_ViewDirty = true;
 }
 
 void Camera::ProcessMouseScroll(float yoffset) {
 	Zoom -= (float)yoffset;
 	if (Zoom <  1.0f) Zoom =  1.0f;
 	if (Zoom > 45.0f) Zoom = 45.0f;
+	m_ProjectionDirty = true;
+}
+
+void Camera::SetAspectRatio(float aspectRatio) {
+	if (aspectRatio == m_AspectRatio) return;
+	m_AspectRatio = aspectRatio;
+	m_ProjectionDirty = true;
+}
+
+void Camera::SetClipPlanes(float nearPlane, float farPlane) {
+	m_NearPlane = nearPlane;
+	m_FarPlane = farPlane;
+	m_ProjectionDirty = true;
+}
+
+CameraView Camera::GetView() {
+	if (m_VectorsDirty) updateCameraVectors();
+	CameraView view;
+	view.Position = Position;
+	view.Forward = Front;
+	view.Up = Up;
+	view.Projection = PROJECTION_PERSPECTIVE;
+	view.FovY = Zoom;
+	view.AspectRatio = m_AspectRatio;
+	view.NearPlane = m_NearPlane;
+	view.FarPlane = m_FarPlane;
+	return view;
+}
+
+void Camera::Update() {
+	if (!m_VectorsDirty && !m_ViewDirty && !m_ProjectionDirty) return;
+	if (m_VectorsDirty) updateCameraVectors();
+
+	CameraView view = GetView();
+	if (m_ProjectionDirty) ComputeProjectionMatrices(view, m_Matrices);
+	ComputeViewMatrices(view, m_Matrices);
+	m_ViewDirty = false;
+	m_ProjectionDirty = false;
 }
 
 void Camera::updateCameraVectors()
@@ -67,5 +122,7 @@ void Camera::updateCameraVectors()
 	// Recalculate Right and Up vector
 	Right = glm::normalize(glm::cross(Front, WorldUp));
 	Up    = glm::normalize(glm::cross(Right, Front));
+	m_VectorsDirty = false;
+	m_ViewDirty = true;
 }
 
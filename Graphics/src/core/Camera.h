@@ -4,6 +4,9 @@
 #include "glm.hpp"
 #include "gtc/matrix_transform.hpp"
 
+#include "Frustum.h"
+#include "CameraBatch.h"
+
 #include <vector>
 
 // Define several possible options for camera movement.
@@ -20,6 +23,8 @@ const float PITCH		= 0.0f;
 const float SPEED		= 2.5f;
 const float SENSITIVITY = 0.1f;
 const float ZOOM		= 45.0f;
+const float NEAR_PLANE	= 0.1f;
+const float FAR_PLANE	= 100.0f;
 
 class Camera
 {
@@ -38,7 +43,21 @@ public:
 	void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
 	void ProcessMouseScroll(float yoffset);
 
-	inline glm::mat4 GetViewMatrix() { return glm::lookAt(Position, Position + Front, Up); }
+	void SetAspectRatio(float aspectRatio);
+	void SetClipPlanes(float nearPlane, float farPlane);
+	// Call after writing Position, Yaw, Pitch or Zoom directly
+	inline void MarkDirty() { m_VectorsDirty = m_ViewDirty = m_ProjectionDirty = true; }
+
+	// Matrices are cached and only rebuilt when something they depend on changed
+	inline const glm::mat4& GetViewMatrix() { Update(); return m_Matrices.View; }
+	inline const glm::mat4& GetProjectionMatrix() { Update(); return m_Matrices.Projection; }
+	inline const glm::mat4& GetViewProjectionMatrix() { Update(); return m_Matrices.ViewProjection; }
+	inline const glm::mat4& GetInverseViewProjectionMatrix() { Update(); return m_Matrices.InverseViewProjection; }
+	inline const Frustum& GetFrustum() { Update(); return m_Matrices.ViewFrustum; }
+	inline const CameraMatrices& GetMatrices() { Update(); return m_Matrices; }
+
+	// Snapshot for a CameraBatch
+	CameraView GetView();
 
 public:
 	// Camera Attributes
@@ -58,5 +77,15 @@ public:
 	float Zoom;
 
 private:
+	float m_AspectRatio;
+	float m_NearPlane;
+	float m_FarPlane;
+
+	CameraMatrices m_Matrices;
+	bool m_VectorsDirty;
+	bool m_ViewDirty;
+	bool m_ProjectionDirty;
+
+	void Update();
 	void updateCameraVectors();
 };
\ No newline at end of file
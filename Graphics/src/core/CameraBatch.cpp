@@ -0,0 +1,98 @@
+#include "CameraBatch.h"
+#include "gtc/matrix_transform.hpp"
+
+void ComputeViewMatrices(const CameraView& view, CameraMatrices& matrices) {
+	matrices.View = glm::lookAt(view.Position, view.Position + view.Forward, view.Up);
+
+	// The view matrix is a rigid transform, its inverse is the transposed rotation
+	// combined with the camera position
+	glm::mat4 inverse = glm::transpose(glm::mat4(glm::mat3(matrices.View)));
+	inverse[3] = glm::vec4(view.Position, 1.0f);
+	matrices.InverseView = inverse;
+
+	matrices.ViewProjection = matrices.Projection * matrices.View;
+	matrices.InverseViewProjection = matrices.InverseView * matrices.InverseProjection;
+	matrices.ViewFrustum = Frustum::FromMatrix(matrices.ViewProjection);
+}
+
+void ComputeProjectionMatrices(const CameraView& view, CameraMatrices& matrices) {
+	if (view.Projection == PROJECTION_PERSPECTIVE) {
+		matrices.Projection = glm::perspective(glm::radians(view.FovY), view.AspectRatio, view.NearPlane, view.FarPlane);
+	}
+	else {
+		const float halfWidth = view.HalfHeight * view.AspectRatio;
+		matrices.Projection = glm::ortho(-halfWidth, halfWidth, -view.HalfHeight, view.HalfHeight, view.NearPlane, view.FarPlane);
+	}
+	matrices.InverseProjection = glm::inverse(matrices.Projection);
+}
+
+unsigned int CameraBatch::Add(camera_role role, const CameraView& view) {
+	m_Roles.push_back(role);
+	m_Views.push_back(view);
+	m_Matrices.push_back(CameraMatrices());
+	m_Dirty.push_back(DIRTY_VIEW | DIRTY_PROJECTION);
+	return static_cast<unsigned int>(m_Views.size() - 1);
+}
+
+void CameraBatch::Clear() {
+	m_Roles.clear();
+	m_Views.clear();
+	m_Matrices.clear();
+	m_Dirty.clear();
+}
+
+void CameraBatch::SetTransform(unsigned int index, const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up) {
+	CameraView& view = m_Views[index];
+	view.Position = position;
+	view.Forward = forward;
+	view.Up = up;
+	m_Dirty[index] |= DIRTY_VIEW;
+}
+
+void CameraBatch::SetPerspective(unsigned int index, float fovY, float aspectRatio, float nearPlane, float farPlane) {
+	CameraView& view = m_Views[index];
+	view.Projection = PROJECTION_PERSPECTIVE;
+	view.FovY = fovY;
+	view.AspectRatio = aspectRatio;
+	view.NearPlane = nearPlane;
+	view.FarPlane = farPlane;
+	m_Dirty[index] |= DIRTY_PROJECTION;
+}
+
+void CameraBatch::SetOrthographic(unsigned int index, float halfHeight, float aspectRatio, float nearPlane, float farPlane) {
+	CameraView& view = m_Views[index];
+	view.Projection = PROJECTION_ORTHOGRAPHIC;
+	view.HalfHeight = halfHeight;
+	view.AspectRatio = aspectRatio;
+	view.NearPlane = nearPlane;
+	view.FarPlane = farPlane;
+	m_Dirty[index] |= DIRTY_PROJECTION;
+}
+
+void CameraBatch::SetView(unsigned int index, const CameraView& view) {
+	// Only what actually changed is flagged, so copying a camera in every frame stays cheap
+	CameraView& current = m_Views[index];
+	if (view.Position != current.Position || view.Forward != current.Forward || view.Up != current.Up) m_Dirty[index] |= DIRTY_VIEW;
+	if (view.Projection != current.Projection || view.FovY != current.FovY || view.HalfHeight != current.HalfHeight ||
+		view.AspectRatio != current.AspectRatio || view.NearPlane != current.NearPlane || view.FarPlane != current.FarPlane) m_Dirty[index] |= DIRTY_PROJECTION;
+	current = view;
+}
+
+void CameraBatch::Update() {
+	for (size_t i = 0; i < m_Views.size(); i++) {
+		const unsigned char dirty = m_Dirty[i];
+		if (!dirty) continue;
+
+		// View derived matrices depend on the projection, so a projection change redoes both
+		if (dirty & DIRTY_PROJECTION) ComputeProjectionMatrices(m_Views[i], m_Matrices[i]);
+		ComputeViewMatrices(m_Views[i], m_Matrices[i]);
+		m_Dirty[i] = 0;
+	}
+}
+
+int CameraBatch::Find(camera_role role) const {
+	for (size_t i = 0; i < m_Roles.size(); i++) {
+		if (m_Roles[i] == role) return static_cast<int>(i);
+	}
+	return -1;
+}
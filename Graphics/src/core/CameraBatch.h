@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+#include "Frustum.h"
+
+enum camera_role {
+	CAMERA_MAIN,
+	CAMERA_SHADOW,
+	CAMERA_REFLECTION
+};
+
+enum projection_type {
+	PROJECTION_PERSPECTIVE,
+	PROJECTION_ORTHOGRAPHIC
+};
+
+// Everything that defines what a camera sees
+struct CameraView {
+	glm::vec3 Position = glm::vec3(0.0f);
+	glm::vec3 Forward = glm::vec3(0.0f, 0.0f, -1.0f);
+	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	projection_type Projection = PROJECTION_PERSPECTIVE;
+	float FovY = 45.0f;			// degrees, perspective only
+	float HalfHeight = 10.0f;	// world units, orthographic only
+	float AspectRatio = 4.0f / 3.0f;
+	float NearPlane = 0.1f;
+	float FarPlane = 100.0f;
+};
+
+// Everything derived from a CameraView
+struct CameraMatrices {
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::mat4 ViewProjection;
+	glm::mat4 InverseView;
+	glm::mat4 InverseProjection;
+	glm::mat4 InverseViewProjection;
+	Frustum ViewFrustum;
+};
+
+void ComputeViewMatrices(const CameraView& view, CameraMatrices& matrices);
+void ComputeProjectionMatrices(const CameraView& view, CameraMatrices& matrices);
+
+// All cameras of a frame (main, shadow, reflection, ...) kept as plain arrays.
+// Edits only flag a camera, Update() then recomputes every flagged camera in one pass.
+class CameraBatch {
+private:
+	enum : unsigned char {
+		DIRTY_VIEW = 1,
+		DIRTY_PROJECTION = 2
+	};
+
+	std::vector<camera_role> m_Roles;
+	std::vector<CameraView> m_Views;
+	std::vector<CameraMatrices> m_Matrices;
+	std::vector<unsigned char> m_Dirty;
+
+public:
+	unsigned int Add(camera_role role, const CameraView& view);
+	void Clear();
+
+	void SetTransform(unsigned int index, const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up);
+	void SetPerspective(unsigned int index, float fovY, float aspectRatio, float nearPlane, float farPlane);
+	void SetOrthographic(unsigned int index, float halfHeight, float aspectRatio, float nearPlane, float farPlane);
+	// Flags only the view or projection when it differs from what the camera already has
+	void SetView(unsigned int index, const CameraView& view);
+
+	void Update();
+
+	// Index of the first camera with this role, -1 when there is none
+	int Find(camera_role role) const;
+
+	inline const CameraView& GetView(unsigned int index) const { return m_Views[index]; }
+	inline const CameraMatrices& GetMatrices(unsigned int index) const { return m_Matrices[index]; }
+	inline camera_role GetRole(unsigned int index) const { return m_Roles[index]; }
+	inline size_t GetCount() const { return m_Views.size(); }
+};
@@ -0,0 +1,366 @@
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+
+#include "CommandList.h"
+#include "Renderer.h"
+
+namespace {
+	enum command_type : unsigned char {
+		COMMAND_BIND_SHADER,
+		COMMAND_BIND_VERTEX_ARRAY,
+		COMMAND_BIND_TEXTURE,
+		COMMAND_SET_INT,
+		COMMAND_SET_FLOAT,
+		COMMAND_SET_VEC4,
+		COMMAND_SET_MAT4,
+		COMMAND_ENABLE,
+		COMMAND_DISABLE,
+		COMMAND_DEPTH_MASK,
+		COMMAND_COLOR_MASK,
+		COMMAND_DRAW_ARRAYS,
+		COMMAND_DRAW_ELEMENTS
+	};
+
+	// Payloads follow their one byte command unaligned, they are copied in and out
+	struct IdPayload { unsigned int Id; };
+	struct TexturePayload { unsigned int Unit; unsigned int Texture; };
+	struct IntPayload { unsigned int Uniform; int Value; };
+	struct FloatPayload { unsigned int Uniform; float Value; };
+	struct Vec4Payload { unsigned int Uniform; float Value[4]; };
+	struct Mat4Payload { unsigned int Uniform; float Value[16]; };
+	struct DrawPayload { unsigned int Primitive; unsigned int First; unsigned int Count; unsigned int Instances; unsigned int BaseInstance; };
+
+	const GLenum PRIMITIVES[] = { GL_TRIANGLES, GL_LINES, GL_POINTS };
+	const GLenum STATES[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+	// Location not looked up yet
+	const int UNRESOLVED = INT_MIN;
+
+	struct UniformRegistry {
+		std::mutex Mutex;
+		std::unordered_map<std::string, unsigned int> Ids;
+		std::deque<std::string> Names;		// deque, so handed out references stay valid
+	};
+
+	UniformRegistry& GetUniformRegistry() {
+		static UniformRegistry registry;
+		return registry;
+	}
+
+	template<typename T>
+	inline void Read(const unsigned char*& data, T& payload) {
+		std::memcpy(&payload, data, sizeof(T));
+		data += sizeof(T);
+	}
+
+	unsigned int GetTypeSize(unsigned int type) {
+		switch (type) {
+			case GL_BYTE: case GL_UNSIGNED_BYTE:	return 1;
+			case GL_SHORT: case GL_UNSIGNED_SHORT:	return 2;
+			case GL_DOUBLE:							return 8;
+		}
+		return 4;
+	}
+}
+
+unsigned int GetUniformId(const std::string& name) {
+	UniformRegistry& registry = GetUniformRegistry();
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+	std::unordered_map<std::string, unsigned int>::iterator found = registry.Ids.find(name);
+	if (found != registry.Ids.end()) return found->second;
+
+	const unsigned int id = static_cast<unsigned int>(registry.Names.size());
+	registry.Names.push_back(name);
+	registry.Ids[name] = id;
+	return id;
+}
+
+const std::string& GetUniformName(unsigned int id) {
+	UniformRegistry& registry = GetUniformRegistry();
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+	return registry.Names[id];
+}
+
+template<typename T>
+void CommandList::Write(unsigned char command, const T& payload) {
+	const size_t at = m_Data.size();
+	m_Data.resize(at + 1 + sizeof(T));
+	m_Data[at] = command;
+	std::memcpy(&m_Data[at + 1], &payload, sizeof(T));
+	m_Count++;
+}
+
+void CommandList::BindShader(unsigned int program) {
+	Write(COMMAND_BIND_SHADER, IdPayload{ program });
+}
+
+void CommandList::BindVertexArray(unsigned int vertexArray) {
+	Write(COMMAND_BIND_VERTEX_ARRAY, IdPayload{ vertexArray });
+}
+
+void CommandList::BindTexture(unsigned int unit, unsigned int texture) {
+	Write(COMMAND_BIND_TEXTURE, TexturePayload{ unit, texture });
+}
+
+void CommandList::SetInt(unsigned int uniform, int value) {
+	Write(COMMAND_SET_INT, IntPayload{ uniform, value });
+}
+
+void CommandList::SetFloat(unsigned int uniform, float value) {
+	Write(COMMAND_SET_FLOAT, FloatPayload{ uniform, value });
+}
+
+void CommandList::SetVec4(unsigned int uniform, const glm::vec4& value) {
+	Vec4Payload payload;
+	payload.Uniform = uniform;
+	std::memcpy(payload.Value, &value[0], sizeof(payload.Value));
+	Write(COMMAND_SET_VEC4, payload);
+}
+
+void CommandList::SetMat4(unsigned int uniform, const glm::mat4& value) {
+	Mat4Payload payload;
+	payload.Uniform = uniform;
+	std::memcpy(payload.Value, &value[0][0], sizeof(payload.Value));
+	Write(COMMAND_SET_MAT4, payload);
+}
+
+void CommandList::Enable(render_state state) {
+	Write(COMMAND_ENABLE, IdPayload{ static_cast<unsigned int>(state) });
+}
+
+void CommandList::Disable(render_state state) {
+	Write(COMMAND_DISABLE, IdPayload{ static_cast<unsigned int>(state) });
+}
+
+void CommandList::DepthMask(bool write) {
+	Write(COMMAND_DEPTH_MASK, IdPayload{ write ? 1u : 0u });
+}
+
+void CommandList::ColorMask(bool write) {
+	Write(COMMAND_COLOR_MASK, IdPayload{ write ? 1u : 0u });
+}
+
+void CommandList::DrawArrays(primitive_type primitive, unsigned int first, unsigned int count, unsigned int instances, unsigned int baseInstance) {
+	Write(COMMAND_DRAW_ARRAYS, DrawPayload{ static_cast<unsigned int>(primitive), first, count, instances, baseInstance });
+}
+
+void CommandList::DrawElements(primitive_type primitive, unsigned int firstIndex, unsigned int count, unsigned int instances, unsigned int baseInstance) {
+	Write(COMMAND_DRAW_ELEMENTS, DrawPayload{ static_cast<unsigned int>(primitive), firstIndex, count, instances, baseInstance });
+}
+
+CommandReplayer::CommandReplayer() :
+	m_Program(0),
+	m_Locations(nullptr),
+	m_VertexArray(0),
+	m_ShiftedLayouts(0),
+	m_DrawCalls(0)
+{
+}
+
+void CommandReplayer::Reset() {
+	m_Program = 0;
+	m_Locations = nullptr;
+	m_ProgramLocations.clear();
+	m_VertexArray = 0;
+	m_InstancedLayouts.clear();
+	m_ShiftedLayouts = 0;
+}
+
+void CommandReplayer::Execute(const CommandList& list) {
+	Execute(list, 0, list.GetSize());
+}
+
+void CommandReplayer::Execute(const CommandList& list, size_t begin, size_t end) {
+	const unsigned char* data = list.GetData() + begin;
+	const unsigned char* last = list.GetData() + end;
+
+	while (data < last) {
+		switch (*data++) {
+			case COMMAND_BIND_SHADER: {
+				IdPayload command;
+				Read(data, command);
+				glUseProgram(command.Id);
+				m_Program = command.Id;
+				m_Locations = &m_ProgramLocations[command.Id];
+				break;
+			}
+			case COMMAND_BIND_VERTEX_ARRAY: {
+				IdPayload command;
+				Read(data, command);
+				glBindVertexArray(command.Id);
+				m_VertexArray = command.Id;
+				break;
+			}
+			case COMMAND_BIND_TEXTURE: {
+				TexturePayload command;
+				Read(data, command);
+				glActiveTexture(GL_TEXTURE0 + command.Unit);
+				glBindTexture(GL_TEXTURE_2D, command.Texture);
+				break;
+			}
+			case COMMAND_SET_INT: {
+				IntPayload command;
+				Read(data, command);
+				glUniform1i(GetLocation(command.Uniform), command.Value);
+				break;
+			}
+			case COMMAND_SET_FLOAT: {
+				FloatPayload command;
+				Read(data, command);
+				glUniform1f(GetLocation(command.Uniform), command.Value);
+				break;
+			}
+			case COMMAND_SET_VEC4: {
+				Vec4Payload command;
+				Read(data, command);
+				glUniform4fv(GetLocation(command.Uniform), 1, command.Value);
+				break;
+			}
+			case COMMAND_SET_MAT4: {
+				Mat4Payload command;
+				Read(data, command);
+				glUniformMatrix4fv(GetLocation(command.Uniform), 1, GL_FALSE, command.Value);
+				break;
+			}
+			case COMMAND_ENABLE: {
+				IdPayload command;
+				Read(data, command);
+				glEnable(STATES[command.Id]);
+				break;
+			}
+			case COMMAND_DISABLE: {
+				IdPayload command;
+				Read(data, command);
+				glDisable(STATES[command.Id]);
+				break;
+			}
+			case COMMAND_DEPTH_MASK: {
+				IdPayload command;
+				Read(data, command);
+				glDepthMask(command.Id ? GL_TRUE : GL_FALSE);
+				break;
+			}
+			case COMMAND_COLOR_MASK: {
+				IdPayload command;
+				Read(data, command);
+				const GLboolean write = command.Id ? GL_TRUE : GL_FALSE;
+				glColorMask(write, write, write, write);
+				break;
+			}
+			case COMMAND_DRAW_ARRAYS: {
+				DrawPayload command;
+				Read(data, command);
+				const GLenum mode = PRIMITIVES[command.Primitive];
+				if (GLAD_GL_VERSION_4_2 && command.BaseInstance != 0) {
+					glDrawArraysInstancedBaseInstance(mode, command.First, command.Count, command.Instances, command.BaseInstance);
+				}
+				else {
+					if (!GLAD_GL_VERSION_4_2) ShiftInstances(command.BaseInstance);
+					if (command.Instances == 1) glDrawArrays(mode, command.First, command.Count);
+					else glDrawArraysInstanced(mode, command.First, command.Count, command.Instances);
+				}
+				m_DrawCalls++;
+				break;
+			}
+			case COMMAND_DRAW_ELEMENTS: {
+				DrawPayload command;
+				Read(data, command);
+				const GLenum mode = PRIMITIVES[command.Primitive];
+				const void* indices = (const void*)(command.First * sizeof(unsigned int));
+				if (GLAD_GL_VERSION_4_2 && command.BaseInstance != 0) {
+					glDrawElementsInstancedBaseInstance(mode, command.Count, GL_UNSIGNED_INT, indices, command.Instances, command.BaseInstance);
+				}
+				else {
+					if (!GLAD_GL_VERSION_4_2) ShiftInstances(command.BaseInstance);
+					if (command.Instances == 1) glDrawElements(mode, command.Count, GL_UNSIGNED_INT, indices);
+					else glDrawElementsInstanced(mode, command.Count, GL_UNSIGNED_INT, indices, command.Instances);
+				}
+				m_DrawCalls++;
+				break;
+			}
+			default:
+				// Anything after an unknown command would be decoded at the wrong offsets
+				std::cout << "ERROR::COMMAND_LIST::UNKNOWN_COMMAND" << std::endl;
+				return;
+		}
+	}
+}
+
+int CommandReplayer::GetLocation(unsigned int uniform) {
+	if (!m_Locations) return -1;
+	std::vector<int>& locations = *m_Locations;
+	if (uniform >= locations.size()) locations.resize(uniform + 1, UNRESOLVED);
+	if (locations[uniform] == UNRESOLVED) {
+		locations[uniform] = glGetUniformLocation(m_Program, GetUniformName(uniform).c_str());
+		if (locations[uniform] == -1) std::cout << "Warning: uniform " << GetUniformName(uniform) << " not found!" << std::endl;
+	}
+	return locations[uniform];
+}
+
+void CommandReplayer::ShiftInstances(unsigned int baseInstance) {
+	// Nothing is shifted, so instance 0 draws are right as they are
+	if (baseInstance == 0 && m_ShiftedLayouts == 0) return;
+
+	unsigned int vertexArray = m_VertexArray;
+	if (vertexArray == 0) {
+		GLint bound = 0;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bound);
+		vertexArray = bound;
+	}
+
+	std::unordered_map<unsigned int, InstancedLayout>::iterator found = m_InstancedLayouts.find(vertexArray);
+	if (found == m_InstancedLayouts.end()) {
+		if (baseInstance == 0) return;
+
+		// Read the layout once per vertex array, the offsets found are those of instance 0
+		InstancedLayout layout;
+		layout.BaseInstance = 0;
+		GLint count = 0;
+		glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &count);
+		for (GLint location = 0; location < count; location++) {
+			GLint enabled = 0, divisor = 0;
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &divisor);
+			if (!enabled || divisor == 0) continue;
+
+			GLint buffer = 0, size = 0, type = 0, normalized = 0, integer = 0, stride = 0;
+			void* pointer = nullptr;
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_SIZE, &size);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_TYPE, &type);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &normalized);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &integer);
+			glGetVertexAttribiv(location, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &stride);
+			glGetVertexAttribPointerv(location, GL_VERTEX_ATTRIB_ARRAY_POINTER, &pointer);
+
+			InstancedAttribute attribute;
+			attribute.Location = location;
+			attribute.Buffer = buffer;
+			attribute.Size = size;
+			attribute.Type = type;
+			attribute.Normalized = normalized ? GL_TRUE : GL_FALSE;
+			attribute.Integer = integer != 0;
+			attribute.Stride = stride;
+			attribute.Divisor = divisor;
+			attribute.Offset = (size_t)pointer;
+			layout.Attributes.push_back(attribute);
+		}
+		found = m_InstancedLayouts.insert(std::make_pair(vertexArray, layout)).first;
+	}
+
+	InstancedLayout& layout = found->second;
+	if (layout.BaseInstance == baseInstance) return;
+	if (layout.BaseInstance == 0) m_ShiftedLayouts++;
+	else if (baseInstance == 0) m_ShiftedLayouts--;
+	layout.BaseInstance = baseInstance;
+
+	for (const InstancedAttribute& attribute : layout.Attributes) {
+		const size_t stride = attribute.Stride ? attribute.Stride : attribute.Size * GetTypeSize(attribute.Type);
+		const void* pointer = (const void*)(attribute.Offset + (baseInstance / attribute.Divisor) * stride);
+		glBindBuffer(GL_ARRAY_BUFFER, attribute.Buffer);
+		if (attribute.Integer) glVertexAttribIPointer(attribute.Location, attribute.Size, attribute.Type, attribute.Stride, pointer);
+		else glVertexAttribPointer(attribute.Location, attribute.Size, attribute.Type, attribute.Normalized, attribute.Stride, pointer);
+	}
+}
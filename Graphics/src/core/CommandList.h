@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glm.hpp"
+
+enum primitive_type {
+	PRIMITIVE_TRIANGLES,
+	PRIMITIVE_LINES,
+	PRIMITIVE_POINTS
+};
+
+enum render_state {
+	RENDER_STATE_DEPTH_TEST,
+	RENDER_STATE_BLEND,
+	RENDER_STATE_CULL_FACE
+};
+
+// Uniforms are named by small ids in command lists, so recording never touches strings.
+// Any thread may ask, the same name always gets the same id.
+unsigned int GetUniformId(const std::string& name);
+const std::string& GetUniformName(unsigned int id);
+
+// Compact binary stream of bind, uniform, state and draw commands. Recording makes no API
+// calls, so any thread can fill a list; handles are the renderer ids of the objects.
+// Cleared lists keep their memory.
+class CommandList {
+private:
+	std::vector<unsigned char> m_Data;
+	unsigned int m_Count;
+
+public:
+	CommandList() : m_Count(0) {}
+
+	void BindShader(unsigned int program);
+	void BindVertexArray(unsigned int vertexArray);
+	void BindTexture(unsigned int unit, unsigned int texture);
+
+	// Apply to the shader of the last BindShader replayed
+	void SetInt(unsigned int uniform, int value);
+	void SetFloat(unsigned int uniform, float value);
+	void SetVec4(unsigned int uniform, const glm::vec4& value);
+	void SetMat4(unsigned int uniform, const glm::mat4& value);
+
+	void Enable(render_state state);
+	void Disable(render_state state);
+	void DepthMask(bool write);
+	void ColorMask(bool write);
+
+	void DrawArrays(primitive_type primitive, unsigned int first, unsigned int count, unsigned int instances = 1, unsigned int baseInstance = 0);
+	// 32 bit indices of the bound vertex array
+	void DrawElements(primitive_type primitive, unsigned int firstIndex, unsigned int count, unsigned int instances = 1, unsigned int baseInstance = 0);
+
+	inline void Clear() { m_Data.clear(); m_Count = 0; }
+	// Byte offset the next command goes to, marks ranges to replay on their own
+	inline size_t GetSize() const { return m_Data.size(); }
+	inline unsigned int GetCount() const { return m_Count; }
+	inline const unsigned char* GetData() const { return m_Data.data(); }
+
+private:
+	template<typename T>
+	void Write(unsigned char command, const T& payload);
+};
+
+// Commands [Begin, End) of list List
+struct CommandRange {
+	unsigned int List;
+	size_t Begin;
+	size_t End;
+};
+
+// Executes command lists on the GL thread. Uniform locations are looked up once per shader
+// and name. Base instances need GL 4.2; older contexts get them by moving the instanced
+// attributes of the vertex array, which stay moved until a draw asks for another base
+// instance, so draw such vertex arrays through the replayer. The vertex array is the one
+// the last BindVertexArray replayed, code binding another in between must bind it back;
+// lists that never bind one make the replayer ask GL on every shifted draw.
+class CommandReplayer {
+private:
+	struct InstancedAttribute {
+		unsigned int Location;
+		unsigned int Buffer;
+		int Size;
+		unsigned int Type;
+		unsigned char Normalized;
+		bool Integer;
+		int Stride;
+		unsigned int Divisor;
+		size_t Offset;
+	};
+
+	struct InstancedLayout {
+		std::vector<InstancedAttribute> Attributes;
+		unsigned int BaseInstance;		// the attributes point at now
+	};
+
+	unsigned int m_Program;
+	std::vector<int>* m_Locations;
+	std::unordered_map<unsigned int, std::vector<int>> m_ProgramLocations;
+	unsigned int m_VertexArray;			// last bound by a command, 0 before any
+	std::unordered_map<unsigned int, InstancedLayout> m_InstancedLayouts;
+	unsigned int m_ShiftedLayouts;		// layouts with a base instance other than 0
+	unsigned int m_DrawCalls;
+
+public:
+	CommandReplayer();
+
+	void Execute(const CommandList& list);
+	void Execute(const CommandList& list, size_t begin, size_t end);
+	// Forgets cached locations and layouts, after shaders or vertex arrays were recreated
+	void Reset();
+
+	inline unsigned int GetDrawCalls() const { return m_DrawCalls; }
+	inline void ResetDrawCalls() { m_DrawCalls = 0; }
+
+private:
+	int GetLocation(unsigned int uniform);
+	// Points the instanced attributes of the current vertex array at baseInstance, if they are not already
+	void ShiftInstances(unsigned int baseInstance);
+};
@@ -0,0 +1,65 @@
+#include "CpuFeatures.h"
+
+#if CPU_X86
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+#if CPU_X86
+static void Cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, leaf, subleaf);
+	for (int i = 0; i < 4; i++) regs[i] = static_cast<unsigned int>(info[i]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long Xgetbv() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+static CpuFeatures Detect() {
+	CpuFeatures features = {};
+#if CPU_X86
+	unsigned int regs[4];
+	Cpuid(0, 0, regs);
+	const unsigned int maxLeaf = regs[0];
+
+	Cpuid(1, 0, regs);
+	features.SSE41 = (regs[2] & (1u << 19)) != 0;
+	features.FMA = (regs[2] & (1u << 12)) != 0;
+	const bool osxsave = (regs[2] & (1u << 27)) != 0;
+	const bool avx = (regs[2] & (1u << 28)) != 0;
+
+	// The OS has to save the wider registers on context switches, otherwise they are unusable
+	const unsigned long long xcr0 = osxsave ? Xgetbv() : 0;
+	const bool ymmState = (xcr0 & 0x6) == 0x6;
+	const bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+	features.AVX = avx && ymmState;
+	features.FMA = features.FMA && features.AVX;
+	if (maxLeaf >= 7) {
+		Cpuid(7, 0, regs);
+		features.AVX2 = features.AVX && (regs[1] & (1u << 5)) != 0;
+		features.AVX512F = zmmState && (regs[1] & (1u << 16)) != 0;
+	}
+#endif
+	return features;
+}
+
+const CpuFeatures& CpuFeatures::Get() {
+	static const CpuFeatures features = Detect();
+	return features;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Instruction sets usable on the running machine, detected once on first use.
+// Kernels with wider paths compile them with per-function target attributes and
+// pick one at runtime, so a single binary runs everywhere.
+struct CpuFeatures {
+	bool SSE41;
+	bool AVX;
+	bool AVX2;
+	bool FMA;
+	bool AVX512F;
+
+	static const CpuFeatures& Get();
+};
+
+// Marks a function as compiled for an instruction set the build flags do not enable.
+// MSVC emits any intrinsic without extra flags, GCC and Clang need the attribute.
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define CPU_TARGET_AVX2
+	#define CPU_TARGET_AVX512
+#else
+	#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+	#define CPU_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+	#define CPU_X86 1
+#else
+	#define CPU_X86 0
+#endif
+
+// SSE2 is part of every x64 target, 32-bit builds need /arch:SSE2 or -msse2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CPU_SSE2 1
+#else
+	#define CPU_SSE2 0
+#endif
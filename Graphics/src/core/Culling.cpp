@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "Culling.h"
+#include "CpuFeatures.h"
+#include "gtc/matrix_transform.hpp"
+
+#if CPU_X86
+	#include <immintrin.h>
+#endif
+
+void BoundingSpheres::Add(const glm::vec3& center, float radius) {
+	CenterX.push_back(center.x);
+	CenterY.push_back(center.y);
+	CenterZ.push_back(center.z);
+	Radius.push_back(radius);
+}
+
+void BoundingSpheres::Set(size_t index, const glm::vec3& center, float radius) {
+	CenterX[index] = center.x;
+	CenterY[index] = center.y;
+	CenterZ[index] = center.z;
+	Radius[index] = radius;
+}
+
+void BoundingSpheres::Clear() {
+	CenterX.clear();
+	CenterY.clear();
+	CenterZ.clear();
+	Radius.clear();
+}
+
+void BoundingBoxes::Add(const glm::vec3& min, const glm::vec3& max) {
+	MinX.push_back(min.x);
+	MinY.push_back(min.y);
+	MinZ.push_back(min.z);
+	MaxX.push_back(max.x);
+	MaxY.push_back(max.y);
+	MaxZ.push_back(max.z);
+}
+
+void BoundingBoxes::Set(size_t index, const glm::vec3& min, const glm::vec3& max) {
+	MinX[index] = min.x;
+	MinY[index] = min.y;
+	MinZ[index] = min.z;
+	MaxX[index] = max.x;
+	MaxY[index] = max.y;
+	MaxZ[index] = max.z;
+}
+
+void BoundingBoxes::Clear() {
+	MinX.clear();
+	MinY.clear();
+	MinZ.clear();
+	MaxX.clear();
+	MaxY.clear();
+	MaxZ.clear();
+}
+
+// Appends base + j for every set bit j of mask without branching on the bits.
+// Slots past the last visible object are overwritten later or trimmed by the caller.
+static inline size_t Compact(unsigned int* out, size_t count, unsigned int base, unsigned int mask, int lanes) {
+	// Most blocks are entirely outside in large scenes
+	if (mask == 0) return count;
+	for (int j = 0; j < lanes; j++) {
+		out[count] = base + j;
+		count += (mask >> j) & 1;
+	}
+	return count;
+}
+
+// Scalar kernels, used for the tail and on targets without SSE.
+// Every kernel evaluates a plane as ((x * a + d) + y * b) + z * c with separate multiplies
+// and adds, so all paths agree bit for bit. That holds as long as the compiler does not fuse
+// them itself: MSVC does not by default, GCC and Clang need -ffp-contract=off.
+
+static size_t CullSpheresScalar(const Frustum& frustum, const BoundingSpheres& s, size_t begin, size_t end, unsigned int* out, size_t count) {
+	for (size_t i = begin; i < end; i++) {
+		bool inside = true;
+		for (const glm::vec4& p : frustum.Planes) {
+			float d = s.CenterX[i] * p.x + p.w;
+			d += s.CenterY[i] * p.y;
+			d += s.CenterZ[i] * p.z;
+			inside &= d >= -s.Radius[i];
+		}
+		out[count] = static_cast<unsigned int>(i);
+		count += inside ? 1 : 0;
+	}
+	return count;
+}
+
+static size_t CullBoxesScalar(const Frustum& frustum, const BoundingBoxes& b, size_t begin, size_t end, unsigned int* out, size_t count) {
+	for (size_t i = begin; i < end; i++) {
+		bool inside = true;
+		for (const glm::vec4& p : frustum.Planes) {
+			float x = p.x > 0.0f ? b.MaxX[i] : b.MinX[i];
+			float y = p.y > 0.0f ? b.MaxY[i] : b.MinY[i];
+			float z = p.z > 0.0f ? b.MaxZ[i] : b.MinZ[i];
+			float d = x * p.x + p.w;
+			d += y * p.y;
+			d += z * p.z;
+			inside &= d >= 0.0f;
+		}
+		out[count] = static_cast<unsigned int>(i);
+		count += inside ? 1 : 0;
+	}
+	return count;
+}
+
+#if CPU_SSE2
+static size_t CullSpheresSSE(const Frustum& frustum, const BoundingSpheres& s, size_t end, unsigned int* out, size_t& count) {
+	size_t i = 0;
+	for (; i + 4 <= end; i += 4) {
+		const __m128 x = _mm_loadu_ps(&s.CenterX[i]);
+		const __m128 y = _mm_loadu_ps(&s.CenterY[i]);
+		const __m128 z = _mm_loadu_ps(&s.CenterZ[i]);
+		const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&s.Radius[i]));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& p : frustum.Planes) {
+			__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_set1_ps(p.w));
+			d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(p.y)));
+			d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(p.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+		}
+		count = Compact(out, count, static_cast<unsigned int>(i), _mm_movemask_ps(inside), 4);
+	}
+	return i;
+}
+
+static size_t CullBoxesSSE(const Frustum& frustum, const BoundingBoxes& b, size_t end, unsigned int* out, size_t& count) {
+	size_t i = 0;
+	for (; i + 4 <= end; i += 4) {
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (const glm::vec4& p : frustum.Planes) {
+			// The corner to test depends only on the plane, so pick the arrays up front
+			const __m128 x = _mm_loadu_ps(p.x > 0.0f ? &b.MaxX[i] : &b.MinX[i]);
+			const __m128 y = _mm_loadu_ps(p.y > 0.0f ? &b.MaxY[i] : &b.MinY[i]);
+			const __m128 z = _mm_loadu_ps(p.z > 0.0f ? &b.MaxZ[i] : &b.MinZ[i]);
+			__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_set1_ps(p.w));
+			d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(p.y)));
+			d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(p.z)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+		}
+		count = Compact(out, count, static_cast<unsigned int>(i), _mm_movemask_ps(inside), 4);
+	}
+	return i;
+}
+#endif
+
+#if CPU_X86
+CPU_TARGET_AVX2
+static size_t CullSpheresAVX2(const Frustum& frustum, const BoundingSpheres& s, size_t end, unsigned int* out, size_t& count) {
+	size_t i = 0;
+	for (; i + 8 <= end; i += 8) {
+		const __m256 x = _mm256_loadu_ps(&s.CenterX[i]);
+		const __m256 y = _mm256_loadu_ps(&s.CenterY[i]);
+		const __m256 z = _mm256_loadu_ps(&s.CenterZ[i]);
+		const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&s.Radius[i]));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& p : frustum.Planes) {
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(p.x)), _mm256_set1_ps(p.w));
+			d = _mm256_add_ps(d, _mm256_mul_ps(y, _mm256_set1_ps(p.y)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(z, _mm256_set1_ps(p.z)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+		}
+		count = Compact(out, count, static_cast<unsigned int>(i), _mm256_movemask_ps(inside), 8);
+	}
+	return i;
+}
+
+CPU_TARGET_AVX2
+static size_t CullBoxesAVX2(const Frustum& frustum, const BoundingBoxes& b, size_t end, unsigned int* out, size_t& count) {
+	size_t i = 0;
+	for (; i + 8 <= end; i += 8) {
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (const glm::vec4& p : frustum.Planes) {
+			const __m256 x = _mm256_loadu_ps(p.x > 0.0f ? &b.MaxX[i] : &b.MinX[i]);
+			const __m256 y = _mm256_loadu_ps(p.y > 0.0f ? &b.MaxY[i] : &b.MinY[i]);
+			const __m256 z = _mm256_loadu_ps(p.z > 0.0f ? &b.MaxZ[i] : &b.MinZ[i]);
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(p.x)), _mm256_set1_ps(p.w));
+			d = _mm256_add_ps(d, _mm256_mul_ps(y, _mm256_set1_ps(p.y)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(z, _mm256_set1_ps(p.z)));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		count = Compact(out, count, static_cast<unsigned int>(i), _mm256_movemask_ps(inside), 8);
+	}
+	return i;
+}
+#endif
+
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* out) {
+	const size_t total = spheres.GetCount();
+	size_t count = 0;
+	size_t done = 0;
+#if CPU_X86
+	if (CpuFeatures::Get().AVX2)
+		done = CullSpheresAVX2(frustum, spheres, total, out, count);
+#endif
+#if CPU_SSE2
+	if (done == 0)
+		done = CullSpheresSSE(frustum, spheres, total, out, count);
+#endif
+	count = CullSpheresScalar(frustum, spheres, done, total, out, count);
+	return count;
+}
+
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int>& visible) {
+	visible.resize(spheres.GetCount());
+	if (visible.empty()) return 0;
+	visible.resize(CullSpheres(frustum, spheres, visible.data()));
+	return visible.size();
+}
+
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* out) {
+	const size_t total = boxes.GetCount();
+	size_t count = 0;
+	size_t done = 0;
+#if CPU_X86
+	if (CpuFeatures::Get().AVX2)
+		done = CullBoxesAVX2(frustum, boxes, total, out, count);
+#endif
+#if CPU_SSE2
+	if (done == 0)
+		done = CullBoxesSSE(frustum, boxes, total, out, count);
+#endif
+	count = CullBoxesScalar(frustum, boxes, done, total, out, count);
+	return count;
+}
+
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<unsigned int>& visible) {
+	visible.resize(boxes.GetCount());
+	if (visible.empty()) return 0;
+	visible.resize(CullBoxes(frustum, boxes, visible.data()));
+	return visible.size();
+}
+
+CullBenchmark RunCullBenchmark(size_t objectCount, unsigned int iterations) {
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	BoundingSpheres spheres;
+	BoundingBoxes boxes;
+	for (size_t i = 0; i < objectCount; i++) {
+		const glm::vec3 center = glm::vec3(unit(random), unit(random), unit(random)) * 500.0f;
+		const glm::vec3 extent = glm::vec3(2.0f) + glm::vec3(unit(random), unit(random), unit(random));
+		spheres.Add(center, glm::length(extent));
+		boxes.Add(center - extent, center + extent);
+	}
+	const glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+		* glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const Frustum frustum = Frustum::FromMatrix(viewProjection);
+
+	std::vector<unsigned int> visible(objectCount), reference(objectCount);
+	CullBenchmark result = {};
+	iterations = std::max(1u, iterations);
+
+	// Best run, the others mostly measure what else the machine was doing
+	result.SphereMilliseconds = result.BoxMilliseconds = 1e30;
+	for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		result.VisibleSpheres = CullSpheres(frustum, spheres, visible.data());
+		result.SphereMilliseconds = std::min(result.SphereMilliseconds, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	size_t count = CullSpheresScalar(frustum, spheres, 0, objectCount, reference.data(), 0);
+	result.Mismatches += count != result.VisibleSpheres || !std::equal(reference.begin(), reference.begin() + count, visible.begin());
+
+	for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		result.VisibleBoxes = CullBoxes(frustum, boxes, visible.data());
+		result.BoxMilliseconds = std::min(result.BoxMilliseconds, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	count = CullBoxesScalar(frustum, boxes, 0, objectCount, reference.data(), 0);
+	result.Mismatches += count != result.VisibleBoxes || !std::equal(reference.begin(), reference.begin() + count, visible.begin());
+
+	result.Kernel = "scalar";
+#if CPU_SSE2
+	result.Kernel = "sse";
+#endif
+#if CPU_X86
+	if (CpuFeatures::Get().AVX2) result.Kernel = "avx2";
+#endif
+	return result;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+#include "Frustum.h"
+
+// Bounds stored as structure of arrays so the culling kernels can load
+// 4 or 8 objects per instruction. Index i in every array belongs to object i.
+struct BoundingSpheres {
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+
+	void Add(const glm::vec3& center, float radius);
+	void Set(size_t index, const glm::vec3& center, float radius);
+	void Clear();
+	inline size_t GetCount() const { return Radius.size(); }
+};
+
+struct BoundingBoxes {
+	std::vector<float> MinX;
+	std::vector<float> MinY;
+	std::vector<float> MinZ;
+	std::vector<float> MaxX;
+	std::vector<float> MaxY;
+	std::vector<float> MaxZ;
+
+	void Add(const glm::vec3& min, const glm::vec3& max);
+	void Set(size_t index, const glm::vec3& min, const glm::vec3& max);
+	void Clear();
+	inline size_t GetCount() const { return MinX.size(); }
+};
+
+// Writes the indices of all objects intersecting the frustum to visible, in ascending
+// order, and returns how many there are. Uses AVX2 when the CPU has it, SSE otherwise;
+// every path gives the same result.
+// The pointer overloads need room for one index per object and never touch the heap.
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, unsigned int* visible);
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, unsigned int* visible);
+size_t CullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, std::vector<unsigned int>& visible);
+size_t CullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, std::vector<unsigned int>& visible);
+
+struct CullBenchmark {
+	double SphereMilliseconds;		// fastest of the runs
+	double BoxMilliseconds;
+	size_t VisibleSpheres;
+	size_t VisibleBoxes;
+	unsigned int Mismatches;		// sphere and box results that differ from the scalar kernel
+	const char* Kernel;
+};
+
+// Culls random objects spread around a fixed camera, times both tests and checks them against scalar code
+CullBenchmark RunCullBenchmark(size_t objectCount, unsigned int iterations);
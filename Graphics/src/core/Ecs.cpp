@@ -0,0 +1,508 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "Ecs.h"
+
+namespace {
+	std::mutex s_ComponentMutex;
+
+	std::vector<ComponentInfo>& GetComponentInfos() {
+		static std::vector<ComponentInfo> infos;
+		return infos;
+	}
+
+	inline size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+	// Chunks and command payloads hold components aligned to up to 16 bytes, more than new
+	// unsigned char[] promises on 32 bit builds. raw is what to free, the caller keeps it.
+	unsigned char* AllocateAligned(size_t size, void*& raw) {
+		raw = std::malloc(size + 16);
+		if (!raw) return nullptr;
+		return reinterpret_cast<unsigned char*>(AlignUp(reinterpret_cast<uintptr_t>(raw), 16));
+	}
+}
+
+unsigned int RegisterComponent(const ComponentInfo& info) {
+	std::lock_guard<std::mutex> lock(s_ComponentMutex);
+	std::vector<ComponentInfo>& infos = GetComponentInfos();
+	if (infos.size() >= MAX_COMPONENTS) {
+		std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES" << std::endl;
+		return MAX_COMPONENTS - 1;
+	}
+	// Reserved up front so references handed out by GetComponentInfo stay valid
+	if (infos.capacity() < MAX_COMPONENTS) infos.reserve(MAX_COMPONENTS);
+	infos.push_back(info);
+	return static_cast<unsigned int>(infos.size() - 1);
+}
+
+const ComponentInfo& GetComponentInfo(unsigned int id) {
+	return GetComponentInfos()[id];
+}
+
+CommandBuffer::CommandBuffer() :
+	m_BlockUsed(BLOCK_SIZE)
+{
+}
+
+CommandBuffer::~CommandBuffer() {
+	Clear();
+	for (const Block& block : m_Blocks) std::free(block.Raw);
+}
+
+void CommandBuffer::Clear() {
+	// Payloads that were not played back still hold live objects
+	for (const Command& command : m_Commands) {
+		if (command.Payload) GetComponentInfo(command.Component).Destroy(command.Payload);
+	}
+	m_Commands.clear();
+	// Keep the first block for the next frame
+	for (size_t i = 1; i < m_Blocks.size(); i++) std::free(m_Blocks[i].Raw);
+	if (m_Blocks.size() > 1) m_Blocks.resize(1);
+	m_BlockUsed = m_Blocks.empty() ? static_cast<size_t>(BLOCK_SIZE) : 0;
+}
+
+void* CommandBuffer::Allocate(size_t size, size_t alignment) {
+	// Blocks are never reallocated, payloads do not move until playback
+	Block block;
+	if (size > BLOCK_SIZE) {
+		block.Data = AllocateAligned(size, block.Raw);
+		m_Blocks.push_back(block);
+		m_BlockUsed = BLOCK_SIZE;
+		return block.Data;
+	}
+	size_t offset = AlignUp(m_BlockUsed, alignment);
+	if (m_Blocks.empty() || offset + size > BLOCK_SIZE) {
+		block.Data = AllocateAligned(BLOCK_SIZE, block.Raw);
+		m_Blocks.push_back(block);
+		offset = 0;
+	}
+	m_BlockUsed = offset + size;
+	return m_Blocks.back().Data + offset;
+}
+
+World::World() :
+	m_EntityCount(0),
+	m_Iterating(0)
+{
+}
+
+World::~World() {
+	Clear();
+	for (void* raw : m_ChunkMemory) std::free(raw);
+}
+
+bool World::IsAlive(Entity entity) const {
+	const uint32_t index = entity.GetIndex();
+	if (entity.IsNull() || index >= m_Entities.size()) return false;
+	return m_Entities[index].Type && m_Entities[index].Generation == entity.GetGeneration();
+}
+
+bool World::BeginStructuralChange() const {
+	if (m_Iterating > 0) {
+		std::cout << "ERROR::ECS::STRUCTURAL_CHANGE_DURING_ITERATION" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+Archetype* World::GetArchetype(ComponentMask mask) {
+	std::unordered_map<ComponentMask, Archetype*>::iterator found = m_ArchetypeByMask.find(mask);
+	if (found != m_ArchetypeByMask.end()) return found->second;
+
+	std::unique_ptr<Archetype> type(new Archetype());
+	type->Mask = mask;
+	type->EntityCount = 0;
+	std::memset(type->Column, 0xFF, sizeof(type->Column));
+	size_t rowSize = sizeof(Entity);
+	for (unsigned int id = 0; id < MAX_COMPONENTS; id++) {
+		if (!((mask >> id) & 1)) continue;
+		type->Column[id] = static_cast<unsigned char>(type->Components.size());
+		type->Components.push_back(id);
+		type->Sizes.push_back(static_cast<unsigned int>(GetComponentInfo(id).Size));
+		rowSize += GetComponentInfo(id).Size;
+	}
+
+	// As many rows as fit once every array is aligned, padding costs at most 16 bytes per array
+	unsigned int capacity = static_cast<unsigned int>((ECS_CHUNK_SIZE - 16 * type->Components.size()) / rowSize);
+	if (capacity == 0) {
+		std::cout << "ERROR::ECS::COMPONENTS_TOO_LARGE_FOR_CHUNK" << std::endl;
+		capacity = 1;
+	}
+	size_t offset = sizeof(Entity) * capacity;
+	for (unsigned int id : type->Components) {
+		const ComponentInfo& info = GetComponentInfo(id);
+		offset = AlignUp(offset, info.Alignment);
+		type->Offsets.push_back(static_cast<unsigned int>(offset));
+		offset += info.Size * capacity;
+	}
+	type->Capacity = capacity;
+
+	Archetype* result = type.get();
+	m_Archetypes.push_back(std::move(type));
+	m_ArchetypeByMask[mask] = result;
+	return result;
+}
+
+Archetype* World::GetArchetypeWith(Archetype* type, unsigned int component) {
+	std::unordered_map<unsigned int, Archetype*>::iterator edge = type->AddEdges.find(component);
+	if (edge != type->AddEdges.end()) return edge->second;
+	Archetype* target = GetArchetype(type->Mask | (ComponentMask(1) << component));
+	type->AddEdges[component] = target;
+	target->RemoveEdges[component] = type;
+	return target;
+}
+
+Archetype* World::GetArchetypeWithout(Archetype* type, unsigned int component) {
+	std::unordered_map<unsigned int, Archetype*>::iterator edge = type->RemoveEdges.find(component);
+	if (edge != type->RemoveEdges.end()) return edge->second;
+	Archetype* target = GetArchetype(type->Mask & ~(ComponentMask(1) << component));
+	type->RemoveEdges[component] = target;
+	target->AddEdges[component] = type;
+	return target;
+}
+
+Entity World::AllocateEntity() {
+	uint32_t index;
+	if (!m_FreeEntities.empty()) {
+		index = m_FreeEntities.back();
+		m_FreeEntities.pop_back();
+	}
+	else {
+		if (m_Entities.size() > Entity::INDEX_MASK) {
+			std::cout << "ERROR::ECS::TOO_MANY_ENTITIES" << std::endl;
+			return Entity();
+		}
+		index = static_cast<uint32_t>(m_Entities.size());
+		m_Entities.push_back(EntityRecord());
+	}
+	m_EntityCount++;
+	return Entity::Make(index, m_Entities[index].Generation);
+}
+
+const World::EntityRecord& World::Place(Entity entity, Archetype* type) {
+	if (type->Chunks.empty() || type->Chunks.back().Count == type->Capacity) {
+		Chunk chunk;
+		if (!m_FreeChunks.empty()) {
+			chunk.Data = m_FreeChunks.back();
+			m_FreeChunks.pop_back();
+		}
+		else {
+			void* raw;
+			chunk.Data = AllocateAligned(ECS_CHUNK_SIZE, raw);
+			m_ChunkMemory.push_back(raw);
+		}
+		chunk.Count = 0;
+		type->Chunks.push_back(chunk);
+	}
+
+	Chunk& chunk = type->Chunks.back();
+	const uint32_t row = chunk.Count++;
+	chunk.GetEntities()[row] = entity;
+	type->EntityCount++;
+
+	EntityRecord& record = m_Entities[entity.GetIndex()];
+	record.Type = type;
+	record.ChunkIndex = static_cast<uint32_t>(type->Chunks.size() - 1);
+	record.Row = row;
+	return record;
+}
+
+void World::RemoveRow(Archetype* type, uint32_t chunkIndex, uint32_t row) {
+	Chunk& last = type->Chunks.back();
+	const uint32_t lastRow = last.Count - 1;
+	Chunk& chunk = type->Chunks[chunkIndex];
+
+	if (&chunk != &last || row != lastRow) {
+		// Keep chunks packed, the last entity of the archetype fills the hole
+		const Entity moved = last.GetEntities()[lastRow];
+		chunk.GetEntities()[row] = moved;
+		for (unsigned int id : type->Components) {
+			GetComponentInfo(id).MoveConstruct(type->GetComponent(chunk, id, row), type->GetComponent(last, id, lastRow));
+		}
+		EntityRecord& record = m_Entities[moved.GetIndex()];
+		record.ChunkIndex = chunkIndex;
+		record.Row = row;
+	}
+
+	last.Count--;
+	type->EntityCount--;
+	if (last.Count == 0) {
+		m_FreeChunks.push_back(last.Data);
+		type->Chunks.pop_back();
+	}
+}
+
+void World::MoveEntity(Entity entity, Archetype* to) {
+	EntityRecord& record = m_Entities[entity.GetIndex()];
+	Archetype* from = record.Type;
+	const uint32_t fromChunk = record.ChunkIndex, fromRow = record.Row;
+
+	const EntityRecord& placed = Place(entity, to);
+	Chunk& source = from->Chunks[fromChunk];
+	Chunk& destination = to->Chunks[placed.ChunkIndex];
+	for (unsigned int id : from->Components) {
+		void* component = from->GetComponent(source, id, fromRow);
+		if ((to->Mask >> id) & 1) GetComponentInfo(id).MoveConstruct(to->GetComponent(destination, id, placed.Row), component);
+		else GetComponentInfo(id).Destroy(component);
+	}
+
+	// The components are gone already, only the row itself is left to fill
+	RemoveRow(from, fromChunk, fromRow);
+}
+
+void World::Destroy(Entity entity) {
+	if (!IsAlive(entity) || !BeginStructuralChange()) return;
+
+	EntityRecord& record = m_Entities[entity.GetIndex()];
+	Archetype* type = record.Type;
+	Chunk& chunk = type->Chunks[record.ChunkIndex];
+	for (unsigned int id : type->Components) GetComponentInfo(id).Destroy(type->GetComponent(chunk, id, record.Row));
+	const uint32_t chunkIndex = record.ChunkIndex, row = record.Row;
+
+	// Skip generation 0 so a live handle can never be equal to the null handle
+	record.Type = nullptr;
+	record.Generation = (record.Generation + 1) & Entity::GENERATION_MASK;
+	if (record.Generation == 0) record.Generation = 1;
+	m_FreeEntities.push_back(entity.GetIndex());
+	m_EntityCount--;
+
+	RemoveRow(type, chunkIndex, row);
+}
+
+void World::Clear() {
+	for (const std::unique_ptr<Archetype>& type : m_Archetypes) {
+		for (Chunk& chunk : type->Chunks) {
+			for (unsigned int id : type->Components) {
+				for (unsigned int row = 0; row < chunk.Count; row++) GetComponentInfo(id).Destroy(type->GetComponent(chunk, id, row));
+			}
+			m_FreeChunks.push_back(chunk.Data);
+		}
+		type->Chunks.clear();
+		type->EntityCount = 0;
+	}
+	for (uint32_t index = 0; index < m_Entities.size(); index++) {
+		EntityRecord& record = m_Entities[index];
+		if (!record.Type) continue;
+		record.Type = nullptr;
+		record.Generation = (record.Generation + 1) & Entity::GENERATION_MASK;
+		if (record.Generation == 0) record.Generation = 1;
+		m_FreeEntities.push_back(index);
+	}
+	m_EntityCount = 0;
+}
+
+void* World::AddRaw(Entity entity, unsigned int component) {
+	if (!IsAlive(entity) || !BeginStructuralChange()) return nullptr;
+	EntityRecord& record = m_Entities[entity.GetIndex()];
+	Archetype* type = record.Type;
+	if ((type->Mask >> component) & 1) {
+		void* existing = type->GetComponent(type->Chunks[record.ChunkIndex], component, record.Row);
+		GetComponentInfo(component).Destroy(existing);
+		return existing;
+	}
+	Archetype* target = GetArchetypeWith(type, component);
+	MoveEntity(entity, target);
+	return target->GetComponent(target->Chunks[record.ChunkIndex], component, record.Row);
+}
+
+void World::RemoveRaw(Entity entity, unsigned int component) {
+	if (!IsAlive(entity) || !BeginStructuralChange()) return;
+	Archetype* type = m_Entities[entity.GetIndex()].Type;
+	if (!((type->Mask >> component) & 1)) return;
+	MoveEntity(entity, GetArchetypeWithout(type, component));
+}
+
+void* World::GetRaw(Entity entity, unsigned int component) {
+	if (!IsAlive(entity)) return nullptr;
+	const EntityRecord& record = m_Entities[entity.GetIndex()];
+	if (!((record.Type->Mask >> component) & 1)) return nullptr;
+	return record.Type->GetComponent(record.Type->Chunks[record.ChunkIndex], component, record.Row);
+}
+
+void World::Playback(CommandBuffer& commands) {
+	if (!BeginStructuralChange()) return;
+
+	Entity created;
+	for (CommandBuffer::Command& command : commands.m_Commands) {
+		switch (command.Type) {
+		case CommandBuffer::COMMAND_CREATE: {
+			created = AllocateEntity();
+			if (!created.IsNull()) Place(created, GetArchetype(command.Mask));
+			break;
+		}
+		case CommandBuffer::COMMAND_DESTROY:
+			Destroy(command.Target);
+			break;
+		case CommandBuffer::COMMAND_ADD: {
+			// Components of a create go straight into the row reserved for them
+			void* storage = command.Target.IsNull() ? GetRaw(created, command.Component) : AddRaw(command.Target, command.Component);
+			if (storage) {
+				GetComponentInfo(command.Component).MoveConstruct(storage, command.Payload);
+				command.Payload = nullptr;
+			}
+			break;
+		}
+		case CommandBuffer::COMMAND_REMOVE:
+			RemoveRaw(command.Target, command.Component);
+			break;
+		}
+	}
+	commands.Clear();
+}
+
+const std::vector<Archetype*>& World::Match(ComponentMask include, ComponentMask exclude) {
+	CachedQuery* query = nullptr;
+	for (const std::unique_ptr<CachedQuery>& cached : m_Queries) {
+		if (cached->Include == include && cached->Exclude == exclude) { query = cached.get(); break; }
+	}
+	if (!query) {
+		m_Queries.push_back(std::unique_ptr<CachedQuery>(new CachedQuery()));
+		query = m_Queries.back().get();
+		query->Include = include;
+		query->Exclude = exclude;
+		query->Seen = 0;
+	}
+
+	// Archetypes are never removed, so only the new ones need a look
+	for (; query->Seen < m_Archetypes.size(); query->Seen++) {
+		Archetype* type = m_Archetypes[query->Seen].get();
+		if ((type->Mask & include) == include && (type->Mask & exclude) == 0) query->Matches.push_back(type);
+	}
+	return query->Matches;
+}
+
+namespace {
+	struct TestPosition { float X, Y, Z; };
+	struct TestVelocity { float X, Y, Z; };
+	struct TestName { std::string Value; };
+
+	std::atomic<int> s_TestLive(0);
+	std::atomic<int> s_TestMisaligned(0);
+
+	// Counts live instances and checks where it is constructed
+	struct alignas(16) TestAligned {
+		float Values[4];
+
+		explicit TestAligned(float value = 0.0f) { Values[0] = Values[1] = Values[2] = Values[3] = value; Track(); }
+		TestAligned(const TestAligned& other) { std::memcpy(Values, other.Values, sizeof(Values)); Track(); }
+		~TestAligned() { s_TestLive--; }
+
+		void Track() {
+			s_TestLive++;
+			if (reinterpret_cast<uintptr_t>(this) % 16 != 0) s_TestMisaligned++;
+		}
+	};
+}
+
+unsigned int RunEcsTest() {
+	unsigned int failures = 0;
+	auto check = [&failures](bool passed, const char* what, size_t value) {
+		if (passed) return;
+		std::cout << "ERROR::ECS_TEST::" << what << " " << value << std::endl;
+		failures++;
+	};
+	// Every component value follows from the entity's number
+	auto name = [](unsigned int i) { return "entity number " + std::to_string(i); };
+
+	{
+		World world;
+		const unsigned int count = 50000;
+		std::vector<Entity> entities(count);
+		for (unsigned int i = 0; i < count; i++) {
+			entities[i] = world.Create(TestPosition{ float(i), 0.0f, 0.0f }, TestName{ name(i) });
+		}
+
+		// Add / remove moves entities through several archetypes, rows swap as holes get filled
+		for (unsigned int i = 0; i < count; i++) {
+			if (i % 2 == 0) world.Add(entities[i], TestVelocity{ 1.0f, float(i), 0.0f });
+			if (i % 3 == 0) world.Add(entities[i], TestAligned(float(i)));
+		}
+		for (unsigned int i = 0; i < count; i += 5) world.Remove<TestName>(entities[i]);
+		for (unsigned int i = 0; i < count; i += 7) world.Remove<TestVelocity>(entities[i]);
+
+		auto verify = [&](const char* step, const std::vector<unsigned char>& destroyed) {
+			unsigned int wrong = 0;
+			for (unsigned int i = 0; i < count; i++) {
+				if (destroyed[i]) {
+					if (world.IsAlive(entities[i])) wrong++;
+					continue;
+				}
+				const TestPosition* position = world.Get<TestPosition>(entities[i]);
+				const TestVelocity* velocity = world.Get<TestVelocity>(entities[i]);
+				const TestName* label = world.Get<TestName>(entities[i]);
+				const TestAligned* aligned = world.Get<TestAligned>(entities[i]);
+				const bool hasVelocity = i % 2 == 0 && i % 7 != 0, hasName = i % 5 != 0, hasAligned = i % 3 == 0;
+				if (!position || position->X != float(i)) wrong++;
+				if ((velocity != nullptr) != hasVelocity || (velocity && velocity->Y != float(i))) wrong++;
+				if ((label != nullptr) != hasName || (label && label->Value != name(i))) wrong++;
+				if ((aligned != nullptr) != hasAligned || (aligned && aligned->Values[3] != float(i))) wrong++;
+				if (aligned && reinterpret_cast<uintptr_t>(aligned) % 16 != 0) wrong++;
+			}
+			if (wrong > 0) std::cout << "ERROR::ECS_TEST::WRONG_COMPONENTS " << wrong << " " << step << std::endl;
+			failures += wrong > 0;
+		};
+		std::vector<unsigned char> destroyed(count, 0);
+		verify("after adding and removing", destroyed);
+		size_t moving = 0;
+		for (unsigned int i = 0; i < count; i++) moving += i % 2 == 0 && i % 7 != 0;
+		check(Query<TestPosition, TestVelocity>(world).Count() == moving, "QUERY_COUNT", Query<TestPosition, TestVelocity>(world).Count());
+
+		// Structural changes recorded while iterating, applied afterwards
+		CommandBuffer commands;
+		Query<TestPosition>(world).Without<TestName>().Each([&](Entity entity, TestPosition& position) {
+			const unsigned int i = static_cast<unsigned int>(position.X);
+			if (i % 2 == 0) commands.Add(entity, TestName{ name(i) });
+			else commands.Destroy(entity);
+		});
+		for (unsigned int i = 0; i < 100; i++) commands.Create(TestPosition{ float(count + i), 0.0f, 0.0f }, TestAligned(float(count + i)));
+		world.Playback(commands);
+		check(commands.IsEmpty(), "COMMANDS_LEFT", 1);
+		for (unsigned int i = 0; i < count; i += 5) {
+			if (i % 2 == 0) continue;
+			destroyed[i] = 1;
+		}
+		// The renamed ones have their name back, so verify against that
+		unsigned int renamed = 0;
+		for (unsigned int i = 0; i < count; i += 10) renamed += world.Get<TestName>(entities[i]) && world.Get<TestName>(entities[i])->Value == name(i);
+		check(renamed == (count + 9) / 10, "RENAMED", renamed);
+		for (unsigned int i = 0; i < count; i += 10) world.Remove<TestName>(entities[i]);
+		verify("after playback", destroyed);
+		size_t created = 0;
+		Query<TestAligned>(world).Without<TestVelocity>().Each([&](Entity, TestAligned& aligned) { created += aligned.Values[0] >= float(count); });
+		check(created == 100, "CREATED", created);
+
+		// Parallel query with one command buffer per worker; everything without a velocity gets one
+		const unsigned int workers = JobSystem::Get().GetWorkerCount();
+		std::vector<std::unique_ptr<CommandBuffer>> buffers;
+		for (unsigned int w = 0; w < workers; w++) buffers.push_back(std::unique_ptr<CommandBuffer>(new CommandBuffer()));
+		std::atomic<size_t> visited(0);
+		Query<TestPosition>(world).ParallelEach([&](Entity entity, TestPosition& position) {
+			position.Y += 1.0f;
+			visited++;
+			const int worker = JobSystem::GetWorkerIndex();
+			if (!world.Has<TestVelocity>(entity) && worker >= 0) buffers[worker]->Add(entity, TestVelocity{ 2.0f, position.X, 0.0f });
+		});
+		check(visited == world.GetEntityCount(), "PARALLEL_VISITS", visited);
+		for (const std::unique_ptr<CommandBuffer>& buffer : buffers) world.Playback(*buffer);
+		unsigned int wrong = 0;
+		Query<TestPosition>(world).Each([&](Entity entity, TestPosition& position) {
+			const TestVelocity* velocity = world.Get<TestVelocity>(entity);
+			if (position.Y != 1.0f || !velocity || velocity->Y != position.X) wrong++;
+		});
+		check(wrong == 0, "PARALLEL_RESULTS", wrong);
+		check(Query<TestPosition>(world).Without<TestVelocity>().Count() == 0, "PARALLEL_PLAYBACK", Query<TestPosition>(world).Without<TestVelocity>().Count());
+	}
+
+	// Unplayed payloads are destroyed with their buffer
+	{
+		CommandBuffer commands;
+		for (unsigned int i = 0; i < 1000; i++) commands.Create(TestAligned(float(i)));
+	}
+	check(s_TestLive == 0, "LEAKED_COMPONENTS", s_TestLive);
+	check(s_TestMisaligned == 0, "MISALIGNED_COMPONENTS", s_TestMisaligned);
+	return failures;
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ResourcePool.h"
+#include "JobSystem.h"
+
+// Archetype based entity-component storage. Entities with the same set of components share
+// an archetype, whose data lives in 16 KB chunks holding one array per component, so a
+// query walks tightly packed arrays of exactly the components it asks for.
+// Adding or removing components moves the entity to another archetype; while systems run,
+// such structural changes go through a CommandBuffer and are applied afterwards.
+
+typedef Handle<struct EntityTag> Entity;
+typedef uint64_t ComponentMask;
+
+struct ComponentInfo {
+	size_t Size;
+	size_t Alignment;
+	void (*Construct)(void* destination);
+	void (*MoveConstruct)(void* destination, void* source);	// also destroys source
+	void (*Destroy)(void* object);
+};
+
+enum : unsigned int { MAX_COMPONENTS = 64, ECS_CHUNK_SIZE = 16 * 1024 };
+
+unsigned int RegisterComponent(const ComponentInfo& info);
+const ComponentInfo& GetComponentInfo(unsigned int id);
+
+template<typename T>
+ComponentInfo MakeComponentInfo() {
+	static_assert(alignof(T) <= 16, "components are aligned to at most 16 bytes inside chunks");
+	ComponentInfo info;
+	info.Size = sizeof(T);
+	info.Alignment = alignof(T);
+	info.Construct = [](void* destination) { new (destination) T(); };
+	info.MoveConstruct = [](void* destination, void* source) {
+		new (destination) T(std::move(*static_cast<T*>(source)));
+		static_cast<T*>(source)->~T();
+	};
+	info.Destroy = [](void* object) { static_cast<T*>(object)->~T(); };
+	return info;
+}
+
+template<typename T>
+struct ComponentType {
+	static unsigned int GetId() {
+		static const unsigned int id = RegisterComponent(MakeComponentInfo<T>());
+		return id;
+	}
+};
+
+// Dense id per component type, assigned on first use
+template<typename T>
+inline unsigned int ComponentId() { return ComponentType<typename std::decay<T>::type>::GetId(); }
+
+template<typename... Ts>
+ComponentMask MakeComponentMask() {
+	ComponentMask mask = 0;
+	(void)std::initializer_list<int>{ (mask |= ComponentMask(1) << ComponentId<Ts>(), 0)... };
+	return mask;
+}
+
+struct Chunk {
+	unsigned char* Data;	// 16 byte aligned, entity array first, then one array per component
+	unsigned int Count;
+
+	inline Entity* GetEntities() const { return reinterpret_cast<Entity*>(Data); }
+};
+
+struct Archetype {
+	ComponentMask Mask;
+	std::vector<unsigned int> Components;	// sorted ids
+	std::vector<unsigned int> Offsets;		// array offset in a chunk per entry of Components
+	std::vector<unsigned int> Sizes;
+	unsigned char Column[MAX_COMPONENTS];	// component id -> index in Components, 0xFF when absent
+	unsigned int Capacity;					// entities per chunk
+	std::vector<Chunk> Chunks;				// all full except the last
+	size_t EntityCount;
+	std::unordered_map<unsigned int, Archetype*> AddEdges;
+	std::unordered_map<unsigned int, Archetype*> RemoveEdges;
+
+	inline void* GetComponent(const Chunk& chunk, unsigned int id, unsigned int row) const {
+		const unsigned int column = Column[id];
+		return chunk.Data + Offsets[column] + size_t(row) * Sizes[column];
+	}
+	template<typename T>
+	inline T* GetArray(const Chunk& chunk) const {
+		return reinterpret_cast<T*>(chunk.Data + Offsets[Column[ComponentId<T>()]]);
+	}
+};
+
+class World;
+
+// Records structural changes to apply later with World::Playback. Not thread safe itself:
+// give every thread or job its own buffer.
+class CommandBuffer {
+private:
+	enum command_type {
+		COMMAND_CREATE,
+		COMMAND_DESTROY,
+		COMMAND_ADD,
+		COMMAND_REMOVE
+	};
+
+	struct Command {
+		command_type Type;
+		Entity Target;			// null for components of the preceding create
+		unsigned int Component;
+		ComponentMask Mask;		// components of a create
+		void* Payload;
+	};
+
+	enum : size_t { BLOCK_SIZE = 4096 };
+
+	struct Block {
+		void* Raw;				// what to free
+		unsigned char* Data;	// 16 byte aligned
+	};
+
+	std::vector<Command> m_Commands;
+	std::vector<Block> m_Blocks;
+	size_t m_BlockUsed;
+
+	friend class World;
+
+public:
+	CommandBuffer();
+	~CommandBuffer();
+
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+	template<typename... Ts>
+	void Create(Ts&&... components) {
+		m_Commands.push_back(Command{ COMMAND_CREATE, Entity(), 0, MakeComponentMask<Ts...>(), nullptr });
+		(void)std::initializer_list<int>{ (Push(COMMAND_ADD, Entity(), std::forward<Ts>(components)), 0)... };
+	}
+	void Destroy(Entity entity) {
+		m_Commands.push_back(Command{ COMMAND_DESTROY, entity, 0, 0, nullptr });
+	}
+	template<typename T>
+	void Add(Entity entity, T component = T()) {
+		Push(COMMAND_ADD, entity, std::move(component));
+	}
+	template<typename T>
+	void Remove(Entity entity) {
+		m_Commands.push_back(Command{ COMMAND_REMOVE, entity, ComponentId<T>(), 0, nullptr });
+	}
+
+	inline bool IsEmpty() const { return m_Commands.empty(); }
+	void Clear();
+
+private:
+	template<typename T>
+	void Push(command_type type, Entity entity, T&& component) {
+		typedef typename std::decay<T>::type Component;
+		void* payload = Allocate(sizeof(Component), alignof(Component));
+		new (payload) Component(std::forward<T>(component));
+		m_Commands.push_back(Command{ type, entity, ComponentId<Component>(), 0, payload });
+	}
+	void* Allocate(size_t size, size_t alignment);
+};
+
+class World {
+private:
+	struct EntityRecord {
+		Archetype* Type = nullptr;
+		uint32_t ChunkIndex = 0;
+		uint32_t Row = 0;
+		uint32_t Generation = 1;
+	};
+
+	struct CachedQuery {
+		ComponentMask Include;
+		ComponentMask Exclude;
+		std::vector<Archetype*> Matches;
+		size_t Seen;	// archetypes already checked
+	};
+
+	std::vector<EntityRecord> m_Entities;
+	std::vector<uint32_t> m_FreeEntities;
+	std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+	std::unordered_map<ComponentMask, Archetype*> m_ArchetypeByMask;
+	std::vector<std::unique_ptr<CachedQuery>> m_Queries;
+	std::vector<unsigned char*> m_FreeChunks;
+	std::vector<void*> m_ChunkMemory;		// what to free, chunks are only recycled while the world lives
+	size_t m_EntityCount;
+	int m_Iterating;
+
+public:
+	World();
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	template<typename... Ts>
+	Entity Create(Ts&&... components) {
+		Entity entity;
+		Archetype* type = GetArchetype(MakeComponentMask<Ts...>());
+		if (!BeginStructuralChange()) return entity;
+		entity = AllocateEntity();
+		if (entity.IsNull()) return entity;
+		const EntityRecord& record = Place(entity, type);
+		const Chunk& chunk = type->Chunks[record.ChunkIndex];
+		(void)std::initializer_list<int>{ (new (type->GetComponent(chunk, ComponentId<Ts>(), record.Row))
+			typename std::decay<Ts>::type(std::forward<Ts>(components)), 0)... };
+		return entity;
+	}
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+	void Clear();
+
+	// Replaces the component if the entity already has one
+	template<typename T>
+	T* Add(Entity entity, T component = T()) {
+		void* storage = AddRaw(entity, ComponentId<T>());
+		return storage ? new (storage) T(std::move(component)) : nullptr;
+	}
+	template<typename T>
+	void Remove(Entity entity) { RemoveRaw(entity, ComponentId<T>()); }
+	template<typename T>
+	T* Get(Entity entity) { return static_cast<T*>(GetRaw(entity, ComponentId<T>())); }
+	template<typename T>
+	bool Has(Entity entity) const {
+		if (!IsAlive(entity)) return false;
+		return (m_Entities[entity.GetIndex()].Type->Mask >> ComponentId<T>()) & 1;
+	}
+
+	// Applies and clears the recorded commands
+	void Playback(CommandBuffer& commands);
+
+	// Archetypes having every component of include and none of exclude. The result is cached
+	// and only archetypes created since the last call are checked.
+	const std::vector<Archetype*>& Match(ComponentMask include, ComponentMask exclude = 0);
+
+	inline size_t GetEntityCount() const { return m_EntityCount; }
+	inline size_t GetArchetypeCount() const { return m_Archetypes.size(); }
+
+	// Marks a span where structural changes are refused, queries use it while iterating
+	inline void BeginIteration() { m_Iterating++; }
+	inline void EndIteration() { m_Iterating--; }
+
+private:
+	Archetype* GetArchetype(ComponentMask mask);
+	Archetype* GetArchetypeWith(Archetype* type, unsigned int component);
+	Archetype* GetArchetypeWithout(Archetype* type, unsigned int component);
+	Entity AllocateEntity();
+	// Reserves a row at the end of the archetype, components are left unconstructed
+	const EntityRecord& Place(Entity entity, Archetype* type);
+	// Moves the last row of the archetype into the hole at chunkIndex / row, whose components are already destroyed
+	void RemoveRow(Archetype* type, uint32_t chunkIndex, uint32_t row);
+	// Moves shared components over, destroys the others, new ones stay unconstructed
+	void MoveEntity(Entity entity, Archetype* to);
+	void* AddRaw(Entity entity, unsigned int component);
+	void RemoveRaw(Entity entity, unsigned int component);
+	void* GetRaw(Entity entity, unsigned int component);
+	bool BeginStructuralChange() const;
+};
+
+// Iterates the entities having all of Ts, optionally skipping those with excluded components.
+// Callbacks get references (Each) or whole chunk arrays (EachChunk) and must not add or
+// remove components or entities; record those in a CommandBuffer instead.
+template<typename... Ts>
+class EntityQuery {
+private:
+	World& m_World;
+	ComponentMask m_Include;
+	ComponentMask m_Exclude;
+
+public:
+	explicit EntityQuery(World& world) : m_World(world), m_Include(MakeComponentMask<Ts...>()), m_Exclude(0) {}
+
+	template<typename U>
+	EntityQuery& Without() { m_Exclude |= ComponentMask(1) << ComponentId<U>(); return *this; }
+
+	// fn(size_t count, const Entity* entities, Ts* arrays...)
+	template<typename F>
+	void EachChunk(F&& fn) {
+		m_World.BeginIteration();
+		for (Archetype* type : m_World.Match(m_Include, m_Exclude)) {
+			for (const Chunk& chunk : type->Chunks) {
+				fn(size_t(chunk.Count), chunk.GetEntities(), type->template GetArray<Ts>(chunk)...);
+			}
+		}
+		m_World.EndIteration();
+	}
+
+	// fn(Entity entity, Ts&... components)
+	template<typename F>
+	void Each(F&& fn) {
+		EachChunk([&fn](size_t count, const Entity* entities, Ts*... arrays) {
+			for (size_t i = 0; i < count; i++) fn(entities[i], arrays[i]...);
+		});
+	}
+
+	// Same as Each, chunks are spread across the job system. fn runs concurrently and may
+	// only write to the components it is given.
+	template<typename F>
+	void ParallelEach(F&& fn) {
+		std::vector<std::pair<Archetype*, const Chunk*>> chunks;
+		size_t total = 0;
+		for (Archetype* type : m_World.Match(m_Include, m_Exclude)) {
+			for (const Chunk& chunk : type->Chunks) {
+				chunks.push_back(std::make_pair(type, &chunk));
+				total += chunk.Count;
+			}
+		}
+
+		auto run = [&fn](size_t begin, size_t end, const std::vector<std::pair<Archetype*, const Chunk*>>& list) {
+			for (size_t c = begin; c < end; c++) {
+				Archetype* type = list[c].first;
+				const Chunk& chunk = *list[c].second;
+				RunChunk(fn, chunk.Count, chunk.GetEntities(), type->template GetArray<Ts>(chunk)...);
+			}
+		};
+
+		m_World.BeginIteration();
+		if (total < PARALLEL_THRESHOLD) run(0, chunks.size(), chunks);
+		else JobSystem::Get().ParallelFor(0, chunks.size(), [&run, &chunks](size_t begin, size_t end) { run(begin, end, chunks); });
+		m_World.EndIteration();
+	}
+
+	size_t Count() {
+		size_t count = 0;
+		for (Archetype* type : m_World.Match(m_Include, m_Exclude)) count += type->EntityCount;
+		return count;
+	}
+
+private:
+	// Fewer entities than this are not worth splitting into jobs
+	enum : size_t { PARALLEL_THRESHOLD = 16384 };
+
+	template<typename F>
+	static void RunChunk(F& fn, size_t count, const Entity* entities, Ts*... arrays) {
+		for (size_t i = 0; i < count; i++) fn(entities[i], arrays[i]...);
+	}
+};
+
+template<typename... Ts>
+EntityQuery<Ts...> Query(World& world) { return EntityQuery<Ts...>(world); }
+
+// Moves entities between archetypes by adding and removing components, plays back command
+// buffers recorded while iterating, one per worker during a parallel query, and checks every
+// component value, its alignment and that none leaks. Returns the number of failures.
+unsigned int RunEcsTest();
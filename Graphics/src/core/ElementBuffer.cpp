@@ -1,14 +1,39 @@
 #include "ElementBuffer.h"
 #include "Renderer.h"
+#include "ReleaseQueue.h"
 
 ElementBuffer::ElementBuffer(const unsigned int* data, unsigned int count) : m_Count(count) {
-	glGenBuffers(1, &m_RendererID);
+	const unsigned int size = count * sizeof(unsigned int);
+	m_RendererID = ReleaseQueue::Get().AcquireBuffer(size);
+	const bool recycled = m_RendererID != 0;
+	if (!recycled) glGenBuffers(1, &m_RendererID);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_RendererID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, GL_STATIC_DRAW);
+	// Without data a recycled buffer is re-specified empty, not left with its previous contents
+	if (recycled && data)
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, data);
+	else
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 }
 
 ElementBuffer::~ElementBuffer() {
-	glDeleteBuffers(1, &m_RendererID);
+	ReleaseQueue::Get().ReleaseBuffer(m_RendererID, m_Count * sizeof(unsigned int));
+}
+
+ElementBuffer::ElementBuffer(ElementBuffer&& other) noexcept :
+	m_RendererID(other.m_RendererID),
+	m_Count(other.m_Count)
+{
+	other.m_RendererID = 0;
+}
+
+ElementBuffer& ElementBuffer::operator=(ElementBuffer&& other) noexcept {
+	if (this != &other) {
+		ReleaseQueue::Get().ReleaseBuffer(m_RendererID, m_Count * sizeof(unsigned int));
+		m_RendererID = other.m_RendererID;
+		m_Count = other.m_Count;
+		other.m_RendererID = 0;
+	}
+	return *this;
 }
 
 void ElementBuffer::Bind() const {
@@ -9,6 +9,11 @@ public:
 	ElementBuffer(const unsigned int* data, unsigned int count);
 	~ElementBuffer();
 
+	ElementBuffer(const ElementBuffer&) = delete;
+	ElementBuffer& operator=(const ElementBuffer&) = delete;
+	ElementBuffer(ElementBuffer&& other) noexcept;
+	ElementBuffer& operator=(ElementBuffer&& other) noexcept;
+
 	void Bind() const;
 	void Unbind() const;
 
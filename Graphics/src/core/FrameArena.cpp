@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+
+namespace {
+	// Larger requests skip the worker blocks, they would waste most of a block
+	const size_t MAX_BLOCK_ALLOCATION = FrameArena::BLOCK_SIZE / 4;
+
+	inline size_t AlignUp(size_t value, size_t alignment) {
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	inline char* AlignUp(char* pointer, size_t alignment) {
+		return reinterpret_cast<char*>(AlignUp(reinterpret_cast<uintptr_t>(pointer), alignment));
+	}
+
+	// Heap memory for what does not fit; raw is what to free, the caller keeps it
+	void* AllocateAligned(size_t size, size_t alignment, void*& raw) {
+		raw = std::malloc(size + alignment);
+		if (!raw) return nullptr;
+		return AlignUp(static_cast<char*>(raw), alignment);
+	}
+}
+
+FrameArena::FrameArena(size_t capacity) :
+	m_Capacity(AlignUp(capacity, BLOCK_SIZE)),
+	m_Offset(0),
+	m_Generation(1),
+	m_Allocations(0),
+	m_Overflows(0),
+	m_Peak(0)
+{
+	m_Memory = static_cast<char*>(::operator new(m_Capacity));
+	// operator new does not honor the cache line alignment before C++17
+	m_BlockMemory = static_cast<char*>(::operator new(MAX_WORKERS * sizeof(WorkerBlock) + alignof(WorkerBlock)));
+	m_Blocks = reinterpret_cast<WorkerBlock*>(AlignUp(m_BlockMemory, alignof(WorkerBlock)));
+	for (size_t i = 0; i < MAX_WORKERS; i++) new (&m_Blocks[i]) WorkerBlock{ nullptr, nullptr, 0 };
+}
+
+FrameArena::~FrameArena() {
+	for (void* raw : m_Overflow) std::free(raw);
+	::operator delete(m_BlockMemory);
+	::operator delete(m_Memory);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment) {
+	m_Allocations.fetch_add(1, std::memory_order_relaxed);
+	const int worker = JobSystem::GetWorkerIndex();
+	if (worker < 0 || worker >= static_cast<int>(MAX_WORKERS) || size > MAX_BLOCK_ALLOCATION) {
+		return AllocateShared(size, alignment);
+	}
+
+	// Only this worker touches its block
+	WorkerBlock& block = m_Blocks[worker];
+	const uint64_t generation = m_Generation.load(std::memory_order_relaxed);
+	if (block.Generation != generation) {
+		block = WorkerBlock{ nullptr, nullptr, generation };
+	}
+
+	char* pointer = AlignUp(block.Cursor, alignment);
+	if (!block.Cursor || pointer + size > block.End) {
+		const size_t offset = m_Offset.fetch_add(BLOCK_SIZE, std::memory_order_relaxed);
+		if (offset + BLOCK_SIZE > m_Capacity) return AllocateOverflow(size, alignment);
+		block.Cursor = m_Memory + offset;
+		block.End = block.Cursor + BLOCK_SIZE;
+		pointer = AlignUp(block.Cursor, alignment);
+	}
+	block.Cursor = pointer + size;
+	return pointer;
+}
+
+void* FrameArena::AllocateShared(size_t size, size_t alignment) {
+	size_t offset = m_Offset.load(std::memory_order_relaxed);
+	size_t aligned;
+	do {
+		aligned = AlignUp(reinterpret_cast<uintptr_t>(m_Memory) + offset, alignment) - reinterpret_cast<uintptr_t>(m_Memory);
+		if (aligned + size > m_Capacity) return AllocateOverflow(size, alignment);
+	} while (!m_Offset.compare_exchange_weak(offset, aligned + size, std::memory_order_relaxed));
+	return m_Memory + aligned;
+}
+
+void* FrameArena::AllocateOverflow(size_t size, size_t alignment) {
+	if (m_Overflows.fetch_add(1, std::memory_order_relaxed) == 0) {
+		std::cout << "ERROR::FRAME_ARENA::OUT_OF_MEMORY capacity " << m_Capacity << std::endl;
+	}
+	void* raw = nullptr;
+	void* pointer = AllocateAligned(size, alignment, raw);
+	std::lock_guard<std::mutex> lock(m_OverflowMutex);
+	m_Overflow.push_back(raw);
+	return pointer;
+}
+
+void FrameArena::Reset() {
+	const size_t used = std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity);
+	m_Peak = std::max(m_Peak, used);
+#if MEMORY_POISON
+	std::memset(m_Memory, MEMORY_POISON_BYTE, used);
+#endif
+	for (void* raw : m_Overflow) std::free(raw);
+	m_Overflow.clear();
+
+	m_Offset.store(0, std::memory_order_relaxed);
+	m_Allocations.store(0, std::memory_order_relaxed);
+	m_Overflows.store(0, std::memory_order_relaxed);
+	m_Generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+ArenaStats FrameArena::GetStats() const {
+	ArenaStats stats;
+	stats.Capacity = m_Capacity;
+	stats.Used = std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity);
+	stats.Peak = std::max(m_Peak, stats.Used);
+	stats.Allocations = m_Allocations.load(std::memory_order_relaxed);
+	stats.Overflows = m_Overflows.load(std::memory_order_relaxed);
+	return stats;
+}
+
+ScratchAllocator::ScratchAllocator() :
+	m_Memory(static_cast<char*>(::operator new(CAPACITY))),
+	m_Top(0),
+	m_Peak(0)
+{
+}
+
+ScratchAllocator::~ScratchAllocator() {
+	for (void* raw : m_Overflow) std::free(raw);
+	::operator delete(m_Memory);
+}
+
+ScratchAllocator& ScratchAllocator::Get() {
+	thread_local ScratchAllocator allocator;
+	return allocator;
+}
+
+void* ScratchAllocator::Allocate(size_t size, size_t alignment) {
+	const size_t aligned = AlignUp(reinterpret_cast<uintptr_t>(m_Memory) + m_Top, alignment) - reinterpret_cast<uintptr_t>(m_Memory);
+	if (aligned + size > CAPACITY) {
+		void* raw = nullptr;
+		void* pointer = AllocateAligned(size, alignment, raw);
+		m_Overflow.push_back(raw);
+		return pointer;
+	}
+	m_Top = aligned + size;
+	m_Peak = std::max(m_Peak, m_Top);
+	return m_Memory + aligned;
+}
+
+void ScratchAllocator::Rewind(size_t top, size_t overflow) {
+#if MEMORY_POISON
+	if (m_Top > top) std::memset(m_Memory + top, MEMORY_POISON_BYTE, m_Top - top);
+#endif
+	m_Top = top;
+	while (m_Overflow.size() > overflow) {
+		std::free(m_Overflow.back());
+		m_Overflow.pop_back();
+	}
+}
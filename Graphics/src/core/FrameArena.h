@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Debug builds overwrite memory handed back (arena reset, scratch rewind, pool free) with
+// MEMORY_POISON_BYTE, so stale pointers read garbage that stands out instead of old data
+#ifndef MEMORY_POISON
+	#ifdef _DEBUG
+		#define MEMORY_POISON 1
+	#else
+		#define MEMORY_POISON 0
+	#endif
+#endif
+#define MEMORY_POISON_BYTE 0xDD
+
+struct ArenaStats {
+	size_t Capacity;
+	size_t Used;			// bytes taken since the last reset, handed out blocks count in full
+	size_t Peak;			// most bytes used by any frame
+	size_t Allocations;		// since the last reset
+	size_t Overflows;		// allocations that did not fit and went to the heap, since the last reset
+};
+
+// Linear allocator for data that lives one frame. Allocation bumps a pointer, Reset takes
+// everything back at once; nothing is destroyed, so only trivially destructible types
+// belong here. Job system workers carve private blocks from the region and allocate from
+// them without contention, other threads bump the shared offset atomically. Reset must
+// not run concurrently with allocations: keep one arena per frame in flight and reset it
+// once that frame is done.
+class FrameArena {
+public:
+	enum : size_t { BLOCK_SIZE = 64 * 1024, MAX_WORKERS = 64 };
+
+private:
+	struct alignas(64) WorkerBlock {
+		char* Cursor;
+		char* End;
+		uint64_t Generation;
+	};
+
+	char* m_Memory;
+	size_t m_Capacity;
+	std::atomic<size_t> m_Offset;
+	std::atomic<uint64_t> m_Generation;		// bumped by Reset, outdates the worker blocks
+	char* m_BlockMemory;
+	WorkerBlock* m_Blocks;		// MAX_WORKERS of them, cache line aligned inside m_BlockMemory
+	std::atomic<size_t> m_Allocations;
+	std::atomic<size_t> m_Overflows;
+	size_t m_Peak;
+
+	std::mutex m_OverflowMutex;
+	std::vector<void*> m_Overflow;
+
+public:
+	explicit FrameArena(size_t capacity = 16 * 1024 * 1024);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	template<typename T>
+	T* Allocate(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	template<typename T, typename... Args>
+	T* New(Args&&... args) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destroyed");
+		return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// O(1), apart from poisoning in debug builds and freeing overflow allocations
+	void Reset();
+
+	ArenaStats GetStats() const;
+
+private:
+	void* AllocateShared(size_t size, size_t alignment);
+	void* AllocateOverflow(size_t size, size_t alignment);
+};
+
+// Standard allocator on top of a frame arena, for containers that live one frame
+template<typename T>
+class ArenaAllocator {
+private:
+	FrameArena* m_Arena;
+
+public:
+	typedef T value_type;
+
+	ArenaAllocator(FrameArena& arena) : m_Arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_Arena(&other.GetArena()) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(m_Arena->Allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T*, size_t) {}
+
+	inline FrameArena& GetArena() const { return *m_Arena; }
+};
+
+template<typename T, typename U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return &a.GetArena() == &b.GetArena(); }
+template<typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return &a.GetArena() != &b.GetArena(); }
+
+// Stack of temporary memory private to the calling thread. Open a ScratchScope, allocate,
+// and everything allocated inside goes back when the scope closes.
+class ScratchAllocator {
+public:
+	enum : size_t { CAPACITY = 1024 * 1024 };
+
+private:
+	char* m_Memory;
+	size_t m_Top;
+	size_t m_Peak;
+	std::vector<void*> m_Overflow;		// allocations past the capacity, freed on rewind
+
+	friend class ScratchScope;
+
+public:
+	ScratchAllocator();
+	~ScratchAllocator();
+	ScratchAllocator(const ScratchAllocator&) = delete;
+	ScratchAllocator& operator=(const ScratchAllocator&) = delete;
+
+	// The calling thread's allocator
+	static ScratchAllocator& Get();
+
+	void* Allocate(size_t size, size_t alignment = 16);
+
+	template<typename T>
+	T* Allocate(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "scratch memory is never destroyed");
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	inline size_t GetUsed() const { return m_Top; }
+	inline size_t GetPeak() const { return m_Peak; }
+
+private:
+	void Rewind(size_t top, size_t overflow);
+};
+
+class ScratchScope {
+private:
+	ScratchAllocator& m_Allocator;
+	size_t m_Top;
+	size_t m_Overflow;
+
+public:
+	ScratchScope() : m_Allocator(ScratchAllocator::Get()), m_Top(m_Allocator.m_Top), m_Overflow(m_Allocator.m_Overflow.size()) {}
+	~ScratchScope() { m_Allocator.Rewind(m_Top, m_Overflow); }
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	inline ScratchAllocator& GetAllocator() const { return m_Allocator; }
+};
@@ -0,0 +1,323 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "FrameCapture.h"
+
+FrameCapture::FrameCapture(unsigned int ringSize, size_t maxQueuedJobs) :
+	m_Slots(ringSize < 2 ? 2 : ringSize),
+	m_NextSlot(0),
+	m_Recording(false),
+	m_Format(CAPTURE_PPM),
+	m_FrameIndex(0),
+	m_PendingFormat(CAPTURE_PNG),
+	m_MaxQueuedJobs(maxQueuedJobs),
+	m_Quit(false),
+	m_Encoding(false),
+	m_DroppedFrames(0)
+{
+	for (Slot& slot : m_Slots) {
+		glGenBuffers(1, &slot.pbo);
+		slot.size = 0;
+		slot.fence = nullptr;
+		slot.width = 0;
+		slot.height = 0;
+		slot.format = CAPTURE_PPM;
+	}
+	m_Worker = std::thread(&FrameCapture::WorkerLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+	Flush();
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_Condition.notify_all();
+	m_Worker.join();
+
+	for (Slot& slot : m_Slots) {
+		glDeleteBuffers(1, &slot.pbo);
+	}
+}
+
+void FrameCapture::Start(const std::string& prefix, capture_format format) {
+	m_Recording = true;
+	m_Prefix = prefix;
+	m_Format = format;
+	m_FrameIndex = 0;
+}
+
+void FrameCapture::Stop() {
+	m_Recording = false;
+}
+
+void FrameCapture::Screenshot(const std::string& path, capture_format format) {
+	m_PendingPath = path;
+	m_PendingFormat = format;
+}
+
+void FrameCapture::Update(int width, int height) {
+	const unsigned int count = static_cast<unsigned int>(m_Slots.size());
+
+	// Hand finished readbacks to the encoder, oldest first. Fences signal in order,
+	// so the first one still in flight means every later one is too.
+	for (unsigned int i = 0; i < count; i++) {
+		Slot& slot = m_Slots[(m_NextSlot + i) % count];
+		if (!slot.fence) continue;
+		GLenum status = glClientWaitSync(slot.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		Retire(slot);
+	}
+
+	// Nothing to capture is the common case, it must not touch a string
+	if (m_PendingPath.empty() && !m_Recording) return;
+	// Minimized: keep the request for when there is a framebuffer to read again
+	if (width <= 0 || height <= 0) return;
+
+	std::string path;
+	capture_format format;
+	if (!m_PendingPath.empty()) {
+		path = m_PendingPath;
+		format = m_PendingFormat;
+		m_PendingPath.clear();
+	}
+	else if (m_Recording) {
+		static const char* extensions[] = { ".ppm", ".png", ".raw" };
+		char index[16];
+		std::snprintf(index, sizeof(index), "%06u", m_FrameIndex++);
+		path = m_Prefix + index + extensions[m_Format];
+		format = m_Format;
+	}
+
+	Slot& slot = m_Slots[m_NextSlot];
+	if (slot.fence) {
+		// The ring is full, the oldest readback is count frames old and about to finish
+		glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		Retire(slot);
+	}
+	Issue(slot, width, height, path, format);
+	m_NextSlot = (m_NextSlot + 1) % count;
+}
+
+void FrameCapture::Flush() {
+	const unsigned int count = static_cast<unsigned int>(m_Slots.size());
+	for (unsigned int i = 0; i < count; i++) {
+		Slot& slot = m_Slots[(m_NextSlot + i) % count];
+		if (!slot.fence) continue;
+		glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		Retire(slot);
+	}
+
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Condition.wait(lock, [this] { return m_Jobs.empty() && !m_Encoding; });
+}
+
+void FrameCapture::Issue(Slot& slot, int width, int height, const std::string& path, capture_format format) {
+	const unsigned int size = static_cast<unsigned int>(width) * static_cast<unsigned int>(height) * 4;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if (slot.size < size) {
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		slot.size = size;
+	}
+	// With a pack buffer bound the pointer is an offset and the call returns immediately
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.width = width;
+	slot.height = height;
+	slot.path = path;
+	slot.format = format;
+}
+
+void FrameCapture::Retire(Slot& slot) {
+	Job job;
+	job.width = slot.width;
+	job.height = slot.height;
+	job.path = slot.path;
+	job.format = slot.format;
+	job.pixels.resize(static_cast<size_t>(slot.width) * slot.height * 4);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, job.pixels.size(), GL_MAP_READ_BIT);
+	if (mapped) {
+		memcpy(job.pixels.data(), mapped, job.pixels.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	if (!mapped) {
+		std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED" << std::endl;
+		return;
+	}
+	Submit(std::move(job));
+}
+
+void FrameCapture::Submit(Job&& job) {
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		// Never let a slow disk back up into the render loop
+		if (m_Jobs.size() >= m_MaxQueuedJobs) {
+			m_DroppedFrames++;
+			return;
+		}
+		m_Jobs.push_back(std::move(job));
+	}
+	m_Condition.notify_all();
+}
+
+void FrameCapture::WorkerLoop() {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (true) {
+		m_Condition.wait(lock, [this] { return m_Quit || !m_Jobs.empty(); });
+		if (m_Jobs.empty()) return;
+
+		Job job = std::move(m_Jobs.front());
+		m_Jobs.pop_front();
+		m_Encoding = true;
+		lock.unlock();
+
+		switch (job.format) {
+			case CAPTURE_PPM: WritePPM(job); break;
+			case CAPTURE_PNG: WritePNG(job); break;
+			case CAPTURE_RAW: WriteRaw(job); break;
+		}
+
+		lock.lock();
+		m_Encoding = false;
+		m_Condition.notify_all();
+	}
+}
+
+void FrameCapture::WritePPM(const Job& job) {
+	std::ofstream file(job.path, std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << job.path << std::endl;
+		return;
+	}
+	file << "P6\n" << job.width << " " << job.height << "\n255\n";
+
+	// GL rows start at the bottom, image files at the top
+	std::vector<unsigned char> row(static_cast<size_t>(job.width) * 3);
+	for (int y = job.height - 1; y >= 0; y--) {
+		const unsigned char* src = &job.pixels[static_cast<size_t>(y) * job.width * 4];
+		for (int x = 0; x < job.width; x++) {
+			row[x * 3 + 0] = src[x * 4 + 0];
+			row[x * 3 + 1] = src[x * 4 + 1];
+			row[x * 3 + 2] = src[x * 4 + 2];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+}
+
+void FrameCapture::WriteRaw(const Job& job) {
+	// Tightly packed RGBA8, top row first, no header
+	std::ofstream file(job.path, std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << job.path << std::endl;
+		return;
+	}
+	const size_t stride = static_cast<size_t>(job.width) * 4;
+	for (int y = job.height - 1; y >= 0; y--) {
+		file.write(reinterpret_cast<const char*>(&job.pixels[y * stride]), stride);
+	}
+}
+
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+	static uint32_t table[256];
+	static bool initialized = false;
+	if (!initialized) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		initialized = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+	out.push_back(static_cast<unsigned char>(value >> 24));
+	out.push_back(static_cast<unsigned char>(value >> 16));
+	out.push_back(static_cast<unsigned char>(value >> 8));
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+static void WriteChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+	std::vector<unsigned char> chunk;
+	PutBigEndian(chunk, static_cast<uint32_t>(data.size()));
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutBigEndian(chunk, Crc32(&chunk[4], chunk.size() - 4));
+	file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+void FrameCapture::WritePNG(const Job& job) {
+	// Stored (uncompressed) deflate blocks: a capture must never cost more than a frame to encode
+	std::ofstream file(job.path, std::ios::binary);
+	if (!file) {
+		std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << job.path << std::endl;
+		return;
+	}
+	static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<unsigned char> header;
+	PutBigEndian(header, job.width);
+	PutBigEndian(header, job.height);
+	header.push_back(8);	// bit depth
+	header.push_back(2);	// color type RGB
+	header.push_back(0);	// compression
+	header.push_back(0);	// filter
+	header.push_back(0);	// interlace
+	WriteChunk(file, "IHDR", header);
+
+	// Scanlines, each prefixed with filter type 0
+	std::vector<unsigned char> scanlines;
+	scanlines.reserve(static_cast<size_t>(job.height) * (job.width * 3 + 1));
+	for (int y = job.height - 1; y >= 0; y--) {
+		const unsigned char* src = &job.pixels[static_cast<size_t>(y) * job.width * 4];
+		scanlines.push_back(0);
+		for (int x = 0; x < job.width; x++) {
+			scanlines.push_back(src[x * 4 + 0]);
+			scanlines.push_back(src[x * 4 + 1]);
+			scanlines.push_back(src[x * 4 + 2]);
+		}
+	}
+
+	std::vector<unsigned char> zlib;
+	zlib.reserve(scanlines.size() + scanlines.size() / 65535 * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t offset = 0;
+	do {
+		const size_t length = std::min<size_t>(scanlines.size() - offset, 65535);
+		const bool last = offset + length == scanlines.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<unsigned char>(length));
+		zlib.push_back(static_cast<unsigned char>(length >> 8));
+		zlib.push_back(static_cast<unsigned char>(~length));
+		zlib.push_back(static_cast<unsigned char>(~length >> 8));
+		zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+		offset += length;
+	} while (offset < scanlines.size());
+
+	uint32_t a = 1, b = 0;
+	for (unsigned char byte : scanlines) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(zlib, (b << 16) | a);
+	WriteChunk(file, "IDAT", zlib);
+	WriteChunk(file, "IEND", std::vector<unsigned char>());
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glad/glad.h"
+
+enum capture_format {
+	CAPTURE_PPM,
+	CAPTURE_PNG,
+	CAPTURE_RAW
+};
+
+// Reads the back buffer without stalling the pipeline. Each capture goes into one of a
+// ring of pixel pack buffers guarded by a fence; the buffer is mapped a few frames later,
+// once the GPU is done with it, and the pixels are encoded and written on a worker thread.
+class FrameCapture {
+private:
+	struct Slot {
+		unsigned int pbo;
+		unsigned int size;
+		GLsync fence;
+		int width;
+		int height;
+		std::string path;
+		capture_format format;
+	};
+
+	struct Job {
+		std::vector<unsigned char> pixels;	// RGBA, bottom row first
+		int width;
+		int height;
+		std::string path;
+		capture_format format;
+	};
+
+	std::vector<Slot> m_Slots;
+	unsigned int m_NextSlot;
+
+	// Continuous capture
+	bool m_Recording;
+	std::string m_Prefix;
+	capture_format m_Format;
+	unsigned int m_FrameIndex;
+
+	// Single frame request for the next Update()
+	std::string m_PendingPath;
+	capture_format m_PendingFormat;
+
+	// Encoder thread
+	std::thread m_Worker;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::deque<Job> m_Jobs;
+	size_t m_MaxQueuedJobs;
+	bool m_Quit;
+	bool m_Encoding;
+	unsigned int m_DroppedFrames;
+
+public:
+	FrameCapture(unsigned int ringSize = 3, size_t maxQueuedJobs = 8);
+	~FrameCapture();
+
+	// Writes <prefix>000000.<ext>, <prefix>000001.<ext>, ... every frame until Stop()
+	void Start(const std::string& prefix, capture_format format = CAPTURE_PPM);
+	void Stop();
+	// Captures only the next frame
+	void Screenshot(const std::string& path, capture_format format = CAPTURE_PNG);
+
+	// Call once per frame after rendering and before swapping buffers
+	void Update(int width, int height);
+	// Waits for every outstanding readback and encode, used on shutdown
+	void Flush();
+
+	inline bool IsRecording() const { return m_Recording; }
+	inline unsigned int GetDroppedFrames() const { return m_DroppedFrames; }
+
+private:
+	void Issue(Slot& slot, int width, int height, const std::string& path, capture_format format);
+	void Retire(Slot& slot);
+	void Submit(Job&& job);
+	void WorkerLoop();
+
+	static void WritePPM(const Job& job);
+	static void WritePNG(const Job& job);
+	static void WriteRaw(const Job& job);
+};
@@ -0,0 +1,41 @@
+#include "Frustum.h"
+
+Frustum Frustum::FromMatrix(const glm::mat4& m) {
+	// Rows of the matrix, glm stores columns
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.Planes[FRUSTUM_LEFT]	= row3 + row0;
+	frustum.Planes[FRUSTUM_RIGHT]	= row3 - row0;
+	frustum.Planes[FRUSTUM_BOTTOM]	= row3 + row1;
+	frustum.Planes[FRUSTUM_TOP]		= row3 - row1;
+	frustum.Planes[FRUSTUM_NEAR]	= row3 + row2;
+	frustum.Planes[FRUSTUM_FAR]		= row3 - row2;
+
+	// Normalize so plane distances are in world units, needed for sphere tests
+	for (glm::vec4& plane : frustum.Planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return frustum;
+}
+
+bool Frustum::ContainsSphere(const glm::vec3& center, float radius) const {
+	for (const glm::vec4& plane : Planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	}
+	return true;
+}
+
+bool Frustum::ContainsBox(const glm::vec3& min, const glm::vec3& max) const {
+	for (const glm::vec4& plane : Planes) {
+		// Corner furthest along the plane normal
+		glm::vec3 corner(plane.x > 0.0f ? max.x : min.x,
+						 plane.y > 0.0f ? max.y : min.y,
+						 plane.z > 0.0f ? max.z : min.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
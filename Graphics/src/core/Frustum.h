@@ -0,0 +1,24 @@
+#pragma once
+
+#include "glm.hpp"
+
+enum frustum_plane {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR
+};
+
+// Six planes (xyz = normal pointing inwards, w = distance) in world space.
+// A point p is inside when dot(plane.xyz, p) + plane.w >= 0 for every plane.
+struct Frustum {
+	glm::vec4 Planes[6];
+
+	// Extracts the planes from a view-projection matrix with OpenGL clip conventions
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+	bool ContainsSphere(const glm::vec3& center, float radius) const;
+	bool ContainsBox(const glm::vec3& min, const glm::vec3& max) const;
+};
@@ -0,0 +1,136 @@
+#include <iostream>
+
+#include "glad/glad.h"
+
+#include "GpuProfiler.h"
+
+GpuProfiler::GpuProfiler() :
+	m_Supported(false),
+	m_Current(nullptr),
+	m_FrameNumber(0),
+	m_Overflow(0),
+	m_ClockOffset(0),
+	m_Track(nullptr),
+	m_DroppedFrames(0)
+{
+	// Timestamps are core in 3.3; a counter without bits means the driver only pretends
+	if (GLAD_GL_VERSION_3_3 && glQueryCounter && glGetQueryObjectui64v && glGetInteger64v) {
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		m_Supported = bits > 0;
+	}
+	if (!m_Supported) {
+		std::cout << "Warning: GPU timer queries unavailable, GPU profiling is off" << std::endl;
+		return;
+	}
+
+	for (Frame& frame : m_Frames) {
+		frame.Scopes.reserve(MAX_SCOPES);
+		frame.Queries.resize(2 * MAX_SCOPES);
+		glGenQueries(2 * MAX_SCOPES, frame.Queries.data());
+		frame.Pending = false;
+		frame.Number = 0;
+	}
+	m_Open.reserve(MAX_SCOPES);
+	m_LastFrame.reserve(MAX_SCOPES);
+	m_Track = &Profiler::Get().CreateTrack("GPU");
+	Calibrate();
+}
+
+GpuProfiler::~GpuProfiler() {
+	if (!m_Supported) return;
+	for (Frame& frame : m_Frames) glDeleteQueries(static_cast<GLsizei>(frame.Queries.size()), frame.Queries.data());
+}
+
+void GpuProfiler::BeginFrame() {
+	if (!m_Supported) return;
+
+	if (m_Current) {
+		// Close what was left open, the frame is unreadable otherwise
+		while (!m_Open.empty()) Pop();
+		m_Current->Pending = !m_Current->Scopes.empty();
+	}
+	Collect();
+	if (m_FrameNumber % CALIBRATION_INTERVAL == 0) Calibrate();
+
+	Frame& frame = m_Frames[m_FrameNumber % FRAME_COUNT];
+	if (frame.Pending) {
+		// The GPU is FRAME_COUNT frames behind, waiting here would stall the pipeline
+		frame.Pending = false;
+		m_DroppedFrames++;
+	}
+	frame.Scopes.clear();
+	frame.Number = m_FrameNumber++;
+	m_Current = &frame;
+	m_Overflow = 0;
+}
+
+void GpuProfiler::Push(const char* name) {
+	if (!m_Supported || !m_Current) return;
+	if (m_Overflow > 0 || m_Current->Scopes.size() == MAX_SCOPES) {
+		m_Overflow++;
+		return;
+	}
+
+	const unsigned int index = static_cast<unsigned int>(m_Current->Scopes.size());
+	m_Current->Scopes.push_back(Scope{ name, static_cast<unsigned int>(m_Open.size()) });
+	m_Open.push_back(index);
+	glQueryCounter(m_Current->Queries[2 * index], GL_TIMESTAMP);
+}
+
+void GpuProfiler::Pop() {
+	if (!m_Supported || !m_Current) return;
+	if (m_Overflow > 0) {
+		m_Overflow--;
+		return;
+	}
+	if (m_Open.empty()) return;
+
+	const unsigned int index = m_Open.back();
+	m_Open.pop_back();
+	glQueryCounter(m_Current->Queries[2 * index + 1], GL_TIMESTAMP);
+}
+
+void GpuProfiler::Calibrate() {
+	// The GPU clock when the command reaches it, close enough to now with nothing queued in between
+	GLint64 gpu = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu);
+	m_ClockOffset = static_cast<int64_t>(Profiler::Now()) - static_cast<int64_t>(gpu);
+}
+
+void GpuProfiler::Collect() {
+	for (;;) {
+		Frame* oldest = nullptr;
+		for (Frame& frame : m_Frames) {
+			if (frame.Pending && (!oldest || frame.Number < oldest->Number)) oldest = &frame;
+		}
+		if (!oldest) return;
+
+		// Timestamps land in order and every scope ends inside a top level one, so the end
+		// of the last top level scope is the last result of the frame
+		GLuint lastQuery = 0;
+		for (size_t i = 0; i < oldest->Scopes.size(); i++) {
+			if (oldest->Scopes[i].Depth == 0) lastQuery = oldest->Queries[2 * i + 1];
+		}
+		GLint available = 0;
+		glGetQueryObjectiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+
+		Read(*oldest);
+		oldest->Pending = false;
+	}
+}
+
+void GpuProfiler::Read(Frame& frame) {
+	m_LastFrame.clear();
+	for (size_t i = 0; i < frame.Scopes.size(); i++) {
+		const Scope& scope = frame.Scopes[i];
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.Queries[2 * i], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.Queries[2 * i + 1], GL_QUERY_RESULT, &end);
+		if (end < begin) end = begin;
+
+		m_LastFrame.push_back(GpuTiming{ scope.Name, scope.Depth, (end - begin) / 1e6 });
+		Profiler::Get().Record(*m_Track, scope.Name, begin + m_ClockOffset, end + m_ClockOffset, scope.Depth);
+	}
+}
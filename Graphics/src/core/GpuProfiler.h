@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.h"
+
+#if PROFILING
+	// Times the GPU work issued in the rest of the enclosing block, render thread only
+	#define GPU_PROFILE_SCOPE(profiler, name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, name)
+#else
+	#define GPU_PROFILE_SCOPE(profiler, name) ((void)0)
+#endif
+
+struct GpuTiming {
+	const char* Name;
+	unsigned int Depth;
+	double Milliseconds;
+};
+
+// GPU pass timings from timestamp queries, which unlike GL_TIME_ELAPSED may nest. Each
+// frame writes its own set of queries out of a ring of FRAME_COUNT, and results are read
+// once the GPU has them, two or three frames later; a frame whose results still are not
+// there when its queries come around again is dropped, never waited for. Timings go on a
+// "GPU" track of the CPU profiler, shifted onto the CPU clock, so passes line up with the
+// threads that issued them. Without timer queries (GL < 3.3, or no timestamp bits as on
+// some software rasterizers) every call does nothing. The scopes vanish when PROFILING is
+// 0, the object and its BeginFrame calls should go behind #if PROFILING as well.
+class GpuProfiler {
+public:
+	enum : unsigned int { FRAME_COUNT = 4, MAX_SCOPES = 64, CALIBRATION_INTERVAL = 120 };
+
+private:
+	struct Scope {
+		const char* Name;
+		unsigned int Depth;
+	};
+
+	struct Frame {
+		std::vector<Scope> Scopes;
+		std::vector<unsigned int> Queries;	// begin and end timestamp per scope
+		bool Pending;						// issued, results not read yet
+		uint64_t Number;
+	};
+
+	bool m_Supported;
+	Frame m_Frames[FRAME_COUNT];
+	Frame* m_Current;
+	uint64_t m_FrameNumber;
+	std::vector<unsigned int> m_Open;		// scopes not popped yet, innermost last
+	unsigned int m_Overflow;				// scopes past MAX_SCOPES still open, not timed
+
+	int64_t m_ClockOffset;					// CPU nanoseconds minus GPU nanoseconds
+	Profiler::Track* m_Track;
+	std::vector<GpuTiming> m_LastFrame;
+	size_t m_DroppedFrames;
+
+public:
+	GpuProfiler();
+	~GpuProfiler();
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Call once per frame before any scope: collects finished frames and starts a new one
+	void BeginFrame();
+	void Push(const char* name);
+	void Pop();
+
+	inline bool IsSupported() const { return m_Supported; }
+	// Most recent frame with results, scopes in the order they began
+	inline const std::vector<GpuTiming>& GetLastFrame() const { return m_LastFrame; }
+	inline size_t GetDroppedFrames() const { return m_DroppedFrames; }
+
+private:
+	void Calibrate();
+	// Reads every issued frame the GPU has finished, oldest first
+	void Collect();
+	void Read(Frame& frame);
+};
+
+class GpuProfileScope {
+private:
+	GpuProfiler& m_Profiler;
+
+public:
+	GpuProfileScope(GpuProfiler& profiler, const char* name) : m_Profiler(profiler) { m_Profiler.Push(name); }
+	~GpuProfileScope() { m_Profiler.Pop(); }
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
@@ -0,0 +1,21 @@
+#include <cstddef>
+
+#include "InstanceAnimation.h"
+#include "Renderer.h"
+
+SpinInstanceBuffer::SpinInstanceBuffer(const std::vector<SpinInstance>& instances) :
+	m_Buffer(instances.data(), static_cast<unsigned int>(instances.size() * sizeof(SpinInstance))),
+	m_Count(static_cast<unsigned int>(instances.size()))
+{
+}
+
+void SpinInstanceBuffer::AddToVertexArray(const VertexArray& vertexArray, unsigned int location) {
+	vertexArray.Bind();
+	m_Buffer.Bind();
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(SpinInstance), (void*)offsetof(SpinInstance, Position));
+	glVertexAttribDivisor(location, 1);
+	glEnableVertexAttribArray(location + 1);
+	glVertexAttribPointer(location + 1, 4, GL_FLOAT, GL_FALSE, sizeof(SpinInstance), (void*)offsetof(SpinInstance, Axis));
+	glVertexAttribDivisor(location + 1, 1);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+
+#include "VertexBuffer.h"
+
+class VertexArray;
+
+// An object spinning about its center. The vertex shader builds the transform from this
+// and a time uniform, so once uploaded the CPU never touches it again.
+struct SpinInstance {
+	glm::vec3 Position;
+	float Phase;			// angle at time 0, radians
+	glm::vec3 Axis;			// unit length
+	float AngularSpeed;		// radians per second
+};
+
+// Spin instances in a static vertex buffer, read as two vec4 attributes that advance once
+// per instance: (position, phase) and (axis, angular speed). Single instances are drawn
+// with the base instance of a CommandList draw.
+class SpinInstanceBuffer {
+private:
+	VertexBuffer m_Buffer;
+	unsigned int m_Count;
+
+public:
+	explicit SpinInstanceBuffer(const std::vector<SpinInstance>& instances);
+
+	// Adds the attributes at location and location + 1 to vertexArray
+	void AddToVertexArray(const VertexArray& vertexArray, unsigned int location = 2);
+
+	inline unsigned int GetCount() const { return m_Count; }
+};
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "InstanceTransforms.h"
+#include "CpuFeatures.h"
+#include "gtc/matrix_transform.hpp"
+
+#if CPU_X86
+	#include <immintrin.h>
+#endif
+
+void InstanceTransforms::Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	PositionX.push_back(position.x);
+	PositionY.push_back(position.y);
+	PositionZ.push_back(position.z);
+	RotationX.push_back(rotation.x);
+	RotationY.push_back(rotation.y);
+	RotationZ.push_back(rotation.z);
+	RotationW.push_back(rotation.w);
+	ScaleX.push_back(scale.x);
+	ScaleY.push_back(scale.y);
+	ScaleZ.push_back(scale.z);
+}
+
+void InstanceTransforms::Set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	PositionX[index] = position.x;
+	PositionY[index] = position.y;
+	PositionZ[index] = position.z;
+	RotationX[index] = rotation.x;
+	RotationY[index] = rotation.y;
+	RotationZ[index] = rotation.z;
+	RotationW[index] = rotation.w;
+	ScaleX[index] = scale.x;
+	ScaleY[index] = scale.y;
+	ScaleZ[index] = scale.z;
+}
+
+void InstanceTransforms::Clear() {
+	PositionX.clear();
+	PositionY.clear();
+	PositionZ.clear();
+	RotationX.clear();
+	RotationY.clear();
+	RotationZ.clear();
+	RotationW.clear();
+	ScaleX.clear();
+	ScaleY.clear();
+	ScaleZ.clear();
+}
+
+// Every kernel computes the same 16 values per instance, in column-major order:
+//   columns 0-2: rotation matrix columns times the scale, w = 0
+//   column 3:    position, w = 1
+// and the MVP as viewProjection times those columns, the last one with an implicit w = 1.
+
+static void ComposeScalar(const InstanceTransforms& t, size_t begin, size_t end, size_t first,
+						  const glm::mat4& vp, glm::mat4* models, glm::mat4* mvps) {
+	for (size_t i = begin; i < end; i++) {
+		const float x = t.RotationX[i], y = t.RotationY[i], z = t.RotationZ[i], w = t.RotationW[i];
+		const float xx = x * x, yy = y * y, zz = z * z;
+		const float xy = x * y, xz = x * z, yz = y * z;
+		const float wx = w * x, wy = w * y, wz = w * z;
+		const float sx = t.ScaleX[i], sy = t.ScaleY[i], sz = t.ScaleZ[i];
+
+		glm::mat4 model;
+		model[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * sx, 2.0f * (xy + wz) * sx, 2.0f * (xz - wy) * sx, 0.0f);
+		model[1] = glm::vec4(2.0f * (xy - wz) * sy, (1.0f - 2.0f * (xx + zz)) * sy, 2.0f * (yz + wx) * sy, 0.0f);
+		model[2] = glm::vec4(2.0f * (xz + wy) * sz, 2.0f * (yz - wx) * sz, (1.0f - 2.0f * (xx + yy)) * sz, 0.0f);
+		model[3] = glm::vec4(t.PositionX[i], t.PositionY[i], t.PositionZ[i], 1.0f);
+
+		if (models) models[i - first] = model;
+		if (mvps) mvps[i - first] = vp * model;
+	}
+}
+
+#if CPU_X86
+CPU_TARGET_AVX2
+static inline void Transpose8x8(__m256* r) {
+	const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+	const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+	const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+	const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+	const __m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44), s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+	const __m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44), s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+	const __m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44), s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+	const __m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44), s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+	r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// m holds element e of 8 instances in m[e], written out as 8 consecutive matrices
+CPU_TARGET_AVX2
+static inline void Store8(__m256* m, float* out) {
+	Transpose8x8(m);
+	Transpose8x8(m + 8);
+	for (int k = 0; k < 8; k++) {
+		_mm256_storeu_ps(out + 16 * k, m[k]);
+		_mm256_storeu_ps(out + 16 * k + 8, m[8 + k]);
+	}
+}
+
+CPU_TARGET_AVX2
+static size_t ComposeAVX2(const InstanceTransforms& t, size_t begin, size_t end, size_t first,
+						  const glm::mat4& vp, glm::mat4* models, glm::mat4* mvps) {
+	const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	size_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		const __m256 x = _mm256_loadu_ps(&t.RotationX[i]), y = _mm256_loadu_ps(&t.RotationY[i]);
+		const __m256 z = _mm256_loadu_ps(&t.RotationZ[i]), w = _mm256_loadu_ps(&t.RotationW[i]);
+		const __m256 sx = _mm256_loadu_ps(&t.ScaleX[i]), sy = _mm256_loadu_ps(&t.ScaleY[i]), sz = _mm256_loadu_ps(&t.ScaleZ[i]);
+		const __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+		const __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+		const __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+		__m256 m[16];
+		m[0] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), sx);
+		m[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+		m[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+		m[3] = zero;
+		m[4] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+		m[5] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), sy);
+		m[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+		m[7] = zero;
+		m[8] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+		m[9] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+		m[10] = _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), sz);
+		m[11] = zero;
+		m[12] = _mm256_loadu_ps(&t.PositionX[i]);
+		m[13] = _mm256_loadu_ps(&t.PositionY[i]);
+		m[14] = _mm256_loadu_ps(&t.PositionZ[i]);
+		m[15] = one;
+
+		if (mvps) {
+			__m256 p[16];
+			for (int column = 0; column < 4; column++) {
+				const __m256 c0 = m[column * 4], c1 = m[column * 4 + 1], c2 = m[column * 4 + 2];
+				for (int row = 0; row < 4; row++) {
+					__m256 v = column == 3 ? _mm256_set1_ps(vp[3][row]) : zero;
+					v = _mm256_fmadd_ps(_mm256_set1_ps(vp[0][row]), c0, v);
+					v = _mm256_fmadd_ps(_mm256_set1_ps(vp[1][row]), c1, v);
+					p[column * 4 + row] = _mm256_fmadd_ps(_mm256_set1_ps(vp[2][row]), c2, v);
+				}
+			}
+			Store8(p, &mvps[i - first][0][0]);
+		}
+		if (models) Store8(m, &models[i - first][0][0]);
+	}
+	return i;
+}
+
+CPU_TARGET_AVX512
+static inline void Transpose16x16(__m512* r) {
+	__m512 t[16];
+	for (int k = 0; k < 16; k += 2) {
+		t[k] = _mm512_unpacklo_ps(r[k], r[k + 1]);
+		t[k + 1] = _mm512_unpackhi_ps(r[k], r[k + 1]);
+	}
+	for (int k = 0; k < 16; k += 4) {
+		r[k] = _mm512_shuffle_ps(t[k], t[k + 2], 0x44);
+		r[k + 1] = _mm512_shuffle_ps(t[k], t[k + 2], 0xEE);
+		r[k + 2] = _mm512_shuffle_ps(t[k + 1], t[k + 3], 0x44);
+		r[k + 3] = _mm512_shuffle_ps(t[k + 1], t[k + 3], 0xEE);
+	}
+	for (int k = 0; k < 16; k += 8) {
+		for (int j = 0; j < 4; j++) {
+			t[k + j] = _mm512_shuffle_f32x4(r[k + j], r[k + j + 4], 0x88);
+			t[k + j + 4] = _mm512_shuffle_f32x4(r[k + j], r[k + j + 4], 0xDD);
+		}
+	}
+	for (int j = 0; j < 8; j++) {
+		r[j] = _mm512_shuffle_f32x4(t[j], t[j + 8], 0x88);
+		r[j + 8] = _mm512_shuffle_f32x4(t[j], t[j + 8], 0xDD);
+	}
+}
+
+CPU_TARGET_AVX512
+static size_t ComposeAVX512(const InstanceTransforms& t, size_t begin, size_t end, size_t first,
+							const glm::mat4& vp, glm::mat4* models, glm::mat4* mvps) {
+	const __m512 one = _mm512_set1_ps(1.0f), two = _mm512_set1_ps(2.0f), zero = _mm512_setzero_ps();
+	size_t i = begin;
+	for (; i + 16 <= end; i += 16) {
+		const __m512 x = _mm512_loadu_ps(&t.RotationX[i]), y = _mm512_loadu_ps(&t.RotationY[i]);
+		const __m512 z = _mm512_loadu_ps(&t.RotationZ[i]), w = _mm512_loadu_ps(&t.RotationW[i]);
+		const __m512 sx = _mm512_loadu_ps(&t.ScaleX[i]), sy = _mm512_loadu_ps(&t.ScaleY[i]), sz = _mm512_loadu_ps(&t.ScaleZ[i]);
+		const __m512 xx = _mm512_mul_ps(x, x), yy = _mm512_mul_ps(y, y), zz = _mm512_mul_ps(z, z);
+		const __m512 xy = _mm512_mul_ps(x, y), xz = _mm512_mul_ps(x, z), yz = _mm512_mul_ps(y, z);
+		const __m512 wx = _mm512_mul_ps(w, x), wy = _mm512_mul_ps(w, y), wz = _mm512_mul_ps(w, z);
+
+		__m512 m[16];
+		m[0] = _mm512_mul_ps(_mm512_fnmadd_ps(two, _mm512_add_ps(yy, zz), one), sx);
+		m[1] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_add_ps(xy, wz)), sx);
+		m[2] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_sub_ps(xz, wy)), sx);
+		m[3] = zero;
+		m[4] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_sub_ps(xy, wz)), sy);
+		m[5] = _mm512_mul_ps(_mm512_fnmadd_ps(two, _mm512_add_ps(xx, zz), one), sy);
+		m[6] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_add_ps(yz, wx)), sy);
+		m[7] = zero;
+		m[8] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_add_ps(xz, wy)), sz);
+		m[9] = _mm512_mul_ps(_mm512_mul_ps(two, _mm512_sub_ps(yz, wx)), sz);
+		m[10] = _mm512_mul_ps(_mm512_fnmadd_ps(two, _mm512_add_ps(xx, yy), one), sz);
+		m[11] = zero;
+		m[12] = _mm512_loadu_ps(&t.PositionX[i]);
+		m[13] = _mm512_loadu_ps(&t.PositionY[i]);
+		m[14] = _mm512_loadu_ps(&t.PositionZ[i]);
+		m[15] = one;
+
+		// After the transpose register k holds the whole matrix of instance i + k
+		if (mvps) {
+			__m512 p[16];
+			for (int column = 0; column < 4; column++) {
+				const __m512 c0 = m[column * 4], c1 = m[column * 4 + 1], c2 = m[column * 4 + 2];
+				for (int row = 0; row < 4; row++) {
+					__m512 v = column == 3 ? _mm512_set1_ps(vp[3][row]) : zero;
+					v = _mm512_fmadd_ps(_mm512_set1_ps(vp[0][row]), c0, v);
+					v = _mm512_fmadd_ps(_mm512_set1_ps(vp[1][row]), c1, v);
+					p[column * 4 + row] = _mm512_fmadd_ps(_mm512_set1_ps(vp[2][row]), c2, v);
+				}
+			}
+			Transpose16x16(p);
+			float* out = &mvps[i - first][0][0];
+			for (int k = 0; k < 16; k++) _mm512_storeu_ps(out + 16 * k, p[k]);
+		}
+		if (models) {
+			Transpose16x16(m);
+			float* out = &models[i - first][0][0];
+			for (int k = 0; k < 16; k++) _mm512_storeu_ps(out + 16 * k, m[k]);
+		}
+	}
+	return i;
+}
+#endif
+
+static InstanceTransforms RandomTransforms(size_t count, std::mt19937& random, std::vector<glm::vec3>* positions,
+										   std::vector<glm::quat>* rotations, std::vector<glm::vec3>* scales) {
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	InstanceTransforms transforms;
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec3 position = glm::vec3(unit(random), unit(random), unit(random)) * 100.0f;
+		const glm::quat rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+		const glm::vec3 scale = glm::vec3(1.5f) + glm::vec3(unit(random), unit(random), unit(random));
+		transforms.Add(position, rotation, scale);
+		if (positions) positions->push_back(position);
+		if (rotations) rotations->push_back(rotation);
+		if (scales) scales->push_back(scale);
+	}
+	return transforms;
+}
+
+static transform_kernel MeasureAutoKernel() {
+#if CPU_X86
+	const CpuFeatures& cpu = CpuFeatures::Get();
+	if (!cpu.AVX2 || !cpu.FMA) return TRANSFORM_KERNEL_SCALAR;
+	if (!cpu.AVX512F) return TRANSFORM_KERNEL_AVX2;
+
+	// Wider is not always faster: AVX-512 may lower the clock, and the 16x16 transposes
+	// cost more than they save on some parts. Keep AVX2 unless AVX-512 wins here.
+	const size_t count = 4096;
+	std::mt19937 random(1234);
+	const InstanceTransforms transforms = RandomTransforms(count, random, nullptr, nullptr, nullptr);
+	std::vector<glm::mat4> models(count), mvps(count);
+	double best[2] = { 0.0, 0.0 };
+	const transform_kernel kernels[2] = { TRANSFORM_KERNEL_AVX2, TRANSFORM_KERNEL_AVX512 };
+	for (int run = 0; run < 5; run++) {
+		for (int k = 0; k < 2; k++) {
+			const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			ComposeTransforms(transforms, 0, count, glm::mat4(1.0f), models.data(), mvps.data(), kernels[k]);
+			const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (run == 0 || elapsed < best[k]) best[k] = elapsed;
+		}
+	}
+	return best[1] < best[0] ? TRANSFORM_KERNEL_AVX512 : TRANSFORM_KERNEL_AVX2;
+#else
+	return TRANSFORM_KERNEL_SCALAR;
+#endif
+}
+
+transform_kernel SelectTransformKernel(transform_kernel kernel) {
+	if (kernel == TRANSFORM_KERNEL_AUTO) {
+		// Timed once, thread safe through the static initialization
+		static const transform_kernel automatic = MeasureAutoKernel();
+		return automatic;
+	}
+#if CPU_X86
+	const CpuFeatures& cpu = CpuFeatures::Get();
+	if (kernel == TRANSFORM_KERNEL_AVX512 && cpu.AVX512F && cpu.AVX2 && cpu.FMA) return TRANSFORM_KERNEL_AVX512;
+	if (kernel != TRANSFORM_KERNEL_SCALAR && cpu.AVX2 && cpu.FMA) return TRANSFORM_KERNEL_AVX2;
+#endif
+	return TRANSFORM_KERNEL_SCALAR;
+}
+
+void ComposeTransforms(const InstanceTransforms& transforms, size_t first, size_t count,
+					   const glm::mat4& viewProjection, glm::mat4* models, glm::mat4* modelViewProjections,
+					   transform_kernel kernel) {
+	const size_t end = std::min(first + count, transforms.GetCount());
+	if (first >= end || (!models && !modelViewProjections)) return;
+
+	size_t done = first;
+#if CPU_X86
+	kernel = SelectTransformKernel(kernel);
+	if (kernel == TRANSFORM_KERNEL_AVX512)
+		done = ComposeAVX512(transforms, done, end, first, viewProjection, models, modelViewProjections);
+	if (kernel != TRANSFORM_KERNEL_SCALAR)
+		done = ComposeAVX2(transforms, done, end, first, viewProjection, models, modelViewProjections);
+#endif
+	ComposeScalar(transforms, done, end, first, viewProjection, models, modelViewProjections);
+}
+
+static float MaxRelativeError(const glm::mat4* a, const glm::mat4* b, size_t count) {
+	float error = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				const float x = a[i][column][row], y = b[i][column][row];
+				error = std::max(error, std::fabs(x - y) / std::max(1.0f, std::fabs(y)));
+			}
+		}
+	}
+	return error;
+}
+
+TransformBenchmark RunTransformBenchmark(size_t instanceCount, unsigned int iterations, transform_kernel kernel) {
+	std::mt19937 random(1234);
+	std::vector<glm::vec3> positions, scales;
+	std::vector<glm::quat> rotations;
+	const InstanceTransforms transforms = RandomTransforms(instanceCount, random, &positions, &rotations, &scales);
+	const glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+		* glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::vector<glm::mat4> glmModels(instanceCount), glmMvps(instanceCount);
+	std::vector<glm::mat4> models(instanceCount), mvps(instanceCount);
+	TransformBenchmark result;
+	iterations = std::max(1u, iterations);
+	// Settles the AUTO choice outside the timed loop
+	result.Kernel = SelectTransformKernel(kernel);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+		for (size_t i = 0; i < instanceCount; i++) {
+			glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(rotations[i]);
+			model = glm::scale(model, scales[i]);
+			glmModels[i] = model;
+			glmMvps[i] = viewProjection * model;
+		}
+	}
+	result.GlmMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+		ComposeTransforms(transforms, 0, instanceCount, viewProjection, models.data(), mvps.data(), result.Kernel);
+	}
+	result.BatchMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+	result.MaxModelError = MaxRelativeError(models.data(), glmModels.data(), instanceCount);
+	result.MaxModelViewProjectionError = MaxRelativeError(mvps.data(), glmMvps.data(), instanceCount);
+	return result;
+}
+
+unsigned int RunTransformTest() {
+	const char* names[] = { "auto", "scalar", "avx2", "avx512" };
+	unsigned int failures = 0;
+	for (int kernel = TRANSFORM_KERNEL_AUTO; kernel <= TRANSFORM_KERNEL_AVX512; kernel++) {
+		const transform_kernel requested = static_cast<transform_kernel>(kernel);
+		if (requested != TRANSFORM_KERNEL_AUTO && SelectTransformKernel(requested) != requested) {
+			std::cout << "Transform test " << names[kernel] << ": not supported by this CPU, skipped" << std::endl;
+			continue;
+		}
+		// Not a multiple of 16, so every kernel hands a tail to the narrower ones
+		const TransformBenchmark benchmark = RunTransformBenchmark(10007, 1, requested);
+		const bool passed = benchmark.MaxModelError <= TRANSFORM_TOLERANCE && benchmark.MaxModelViewProjectionError <= TRANSFORM_TOLERANCE;
+		if (!passed) {
+			std::cout << "ERROR::TRANSFORM_TEST::" << names[kernel] << " max error " << benchmark.MaxModelError << " / "
+				<< benchmark.MaxModelViewProjectionError << " above " << TRANSFORM_TOLERANCE << std::endl;
+			failures++;
+		}
+		else {
+			std::cout << "Transform test " << names[kernel] << " (" << names[benchmark.Kernel] << "): max error "
+				<< benchmark.MaxModelError << " / " << benchmark.MaxModelViewProjectionError << std::endl;
+		}
+	}
+	return failures;
+}
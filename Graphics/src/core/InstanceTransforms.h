@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/quaternion.hpp"
+
+// Translation, rotation and scale of many instances as structure of arrays, so the
+// compose kernels load 8 or 16 instances per instruction. Rotations are unit quaternions.
+struct InstanceTransforms {
+	std::vector<float> PositionX;
+	std::vector<float> PositionY;
+	std::vector<float> PositionZ;
+	std::vector<float> RotationX;
+	std::vector<float> RotationY;
+	std::vector<float> RotationZ;
+	std::vector<float> RotationW;
+	std::vector<float> ScaleX;
+	std::vector<float> ScaleY;
+	std::vector<float> ScaleZ;
+
+	void Add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f));
+	void Set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale = glm::vec3(1.0f));
+	void Clear();
+	inline size_t GetCount() const { return PositionX.size(); }
+};
+
+enum transform_kernel {
+	TRANSFORM_KERNEL_AUTO,
+	TRANSFORM_KERNEL_SCALAR,
+	TRANSFORM_KERNEL_AVX2,
+	TRANSFORM_KERNEL_AVX512
+};
+
+// Builds translate * rotate * scale for instances [first, first + count) and, when
+// modelViewProjections is given, viewProjection times that. Output k belongs to instance
+// first + k, so both pointers can go straight into (mapped) instance buffers; either may
+// be null. AUTO runs AVX2 when the CPU has it, or AVX-512 when a one time timing on first
+// use finds it faster; a kernel the CPU lacks falls back to the next narrower one.
+void ComposeTransforms(const InstanceTransforms& transforms, size_t first, size_t count,
+					   const glm::mat4& viewProjection, glm::mat4* models, glm::mat4* modelViewProjections,
+					   transform_kernel kernel = TRANSFORM_KERNEL_AUTO);
+
+// The kernel ComposeTransforms runs for kernel on this CPU
+transform_kernel SelectTransformKernel(transform_kernel kernel);
+
+struct TransformBenchmark {
+	double GlmMilliseconds;			// glm::translate * mat4_cast * glm::scale, one instance at a time
+	double BatchMilliseconds;
+	float MaxModelError;			// largest difference to the glm result, relative to the element size
+	float MaxModelViewProjectionError;
+	transform_kernel Kernel;		// kernel that ran
+};
+
+// Largest relative difference to glm any kernel may show, a few float ulps of rounding
+const float TRANSFORM_TOLERANCE = 1e-5f;
+
+// Times both paths over random instances and checks the batch result against glm
+TransformBenchmark RunTransformBenchmark(size_t instanceCount, unsigned int iterations, transform_kernel kernel = TRANSFORM_KERNEL_AUTO);
+
+// Runs every kernel the CPU supports on random instances and compares against glm,
+// printing each result. Returns the number of kernels above TRANSFORM_TOLERANCE.
+unsigned int RunTransformTest();
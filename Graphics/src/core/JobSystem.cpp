@@ -0,0 +1,334 @@
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "JobSystem.h"
+
+namespace {
+	// Jobs each worker can have in flight before further ones go to the heap
+	const size_t JOB_RING_SIZE = 4096;
+	// Slots looked at before giving up on the ring; jobs mostly finish in the order they were
+	// made, so when this many in a row are busy the rest are too
+	const size_t JOB_RING_PROBES = 64;
+	// Rounds an idle worker keeps looking for work before going to sleep
+	const int IDLE_SPINS = 64;
+
+	thread_local int s_WorkerIndex = -1;
+}
+
+WorkStealingDeque::WorkStealingDeque() :
+	m_Top(0),
+	m_Bottom(0)
+{
+	for (std::atomic<Job*>& job : m_Jobs) job.store(nullptr, std::memory_order_relaxed);
+}
+
+bool WorkStealingDeque::Push(Job* job) {
+	const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_Top.load(std::memory_order_acquire);
+	if (bottom - top >= static_cast<int64_t>(CAPACITY)) return false;
+
+	m_Jobs[bottom & MASK].store(job, std::memory_order_relaxed);
+	// Publishes the job to thieves, they read the bottom with acquire
+	m_Bottom.store(bottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* WorkStealingDeque::Pop() {
+	const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom) {
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[bottom & MASK].load(std::memory_order_relaxed);
+	if (top == bottom) {
+		// Last job, race the thieves for it
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::Steal() {
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+	if (top >= bottom) return nullptr;
+
+	Job* job = m_Jobs[top & MASK].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+	return job;
+}
+
+JobSystem& JobSystem::Get() {
+	static JobSystem instance;
+	return instance;
+}
+
+JobSystem::JobSystem() :
+	m_Pending(0),
+	m_Sleeping(0),
+	m_Running(false),
+	m_StealSeed(1)
+{
+}
+
+JobSystem::~JobSystem() {
+	Shutdown();
+}
+
+int JobSystem::GetWorkerIndex() {
+	return s_WorkerIndex;
+}
+
+void JobSystem::Start(unsigned int threads) {
+	if (!m_Workers.empty()) {
+		std::cout << "ERROR::JOB_SYSTEM::ALREADY_STARTED" << std::endl;
+		return;
+	}
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+	m_Running = true;
+	for (unsigned int i = 0; i < threads; i++) {
+		m_Workers.push_back(std::unique_ptr<Worker>(new Worker()));
+		m_Workers.back()->Jobs = std::vector<Job>(JOB_RING_SIZE);
+		for (Job& job : m_Workers.back()->Jobs) job.InFlight.store(0, std::memory_order_relaxed);
+	}
+	s_WorkerIndex = 0;
+	for (unsigned int i = 1; i < threads; i++) {
+		m_Workers[i]->Thread = std::thread(&JobSystem::WorkerLoop, this, static_cast<int>(i));
+	}
+}
+
+void JobSystem::Shutdown() {
+	if (m_Workers.empty()) return;
+
+	// Help drain what is queued, workers keep going until they find nothing either
+	while (Job* job = FindJob(s_WorkerIndex)) Execute(job);
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Running = false;
+	}
+	m_WakeUp.notify_all();
+	for (std::unique_ptr<Worker>& worker : m_Workers) {
+		if (worker->Thread.joinable()) worker->Thread.join();
+	}
+	m_Workers.clear();
+	s_WorkerIndex = -1;
+}
+
+Job* JobSystem::AllocateJob() {
+	const int index = s_WorkerIndex;
+	if (index < 0 || m_Workers.empty()) {
+		// Outside threads are rare, they pay for an allocation
+		Job* job = new Job();
+		job->InFlight.store(2, std::memory_order_relaxed);
+		return job;
+	}
+
+	Worker& worker = *m_Workers[index];
+	for (size_t attempt = 0; attempt < JOB_RING_PROBES; attempt++) {
+		Job& job = worker.Jobs[worker.NextJob++ & (JOB_RING_SIZE - 1)];
+		if (job.InFlight.load(std::memory_order_acquire) == 0) {
+			job.InFlight.store(1, std::memory_order_relaxed);
+			return &job;
+		}
+	}
+	// The ring is full of jobs queued or running further up this stack; helping here could recurse
+	// without end, so take the slow path instead
+	Job* job = new Job();
+	job->InFlight.store(2, std::memory_order_relaxed);
+	return job;
+}
+
+void JobSystem::Schedule(Job* job) {
+	if (m_Workers.empty()) {
+		// Not started: behave like a plain function call
+		Execute(job);
+		return;
+	}
+
+	const int index = s_WorkerIndex;
+	if (index >= 0) {
+		if (!m_Workers[index]->Deque.Push(job)) {
+			Execute(job);
+			return;
+		}
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_InjectedMutex);
+		m_Injected.push_back(job);
+	}
+
+	m_Pending.fetch_add(1);
+	if (m_Sleeping.load() > 0) {
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_WakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(int index) {
+	if (m_Pending.load(std::memory_order_relaxed) <= 0) return nullptr;
+
+	Job* job = nullptr;
+	if (index >= 0) job = m_Workers[index]->Deque.Pop();
+
+	if (!job) {
+		std::lock_guard<std::mutex> lock(m_InjectedMutex);
+		if (!m_Injected.empty()) {
+			job = m_Injected.back();
+			m_Injected.pop_back();
+		}
+	}
+
+	if (!job) {
+		// Start at a random victim so thieves spread out
+		const unsigned int count = static_cast<unsigned int>(m_Workers.size());
+		unsigned int seed = m_StealSeed.fetch_add(0x9E3779B9u, std::memory_order_relaxed);
+		seed ^= seed >> 16;
+		const unsigned int start = seed % count;
+		for (unsigned int i = 0; i < count && !job; i++) {
+			const unsigned int victim = (start + i) % count;
+			if (static_cast<int>(victim) != index) job = m_Workers[victim]->Deque.Steal();
+		}
+	}
+
+	if (job) m_Pending.fetch_sub(1);
+	return job;
+}
+
+void JobSystem::Execute(Job* job) {
+	job->Invoke(*job);
+	job->Destroy(*job);
+	JobCounter* counter = job->Counter;
+	if (job->InFlight.load(std::memory_order_relaxed) == 2) delete job;
+	else job->InFlight.store(0, std::memory_order_release);
+	if (!counter) return;
+
+	// The lock is the last thing touched, Wait takes it once before letting the counter go
+	std::vector<Job*> continuations;
+	while (counter->m_Lock.test_and_set(std::memory_order_acquire)) {}
+	if (counter->m_Value.fetch_sub(1, std::memory_order_acq_rel) == 1) continuations.swap(counter->m_Continuations);
+	counter->m_Lock.clear(std::memory_order_release);
+
+	for (Job* continuation : continuations) Schedule(continuation);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+	const int index = s_WorkerIndex;
+	while (!counter.IsDone()) {
+		if (Job* job = FindJob(index)) Execute(job);
+		else std::this_thread::yield();
+	}
+	while (counter.m_Lock.test_and_set(std::memory_order_acquire)) {}
+	counter.m_Lock.clear(std::memory_order_release);
+}
+
+bool JobSystem::Help() {
+	Job* job = FindJob(s_WorkerIndex);
+	if (!job) return false;
+	Execute(job);
+	return true;
+}
+
+void JobSystem::WorkerLoop(int index) {
+	s_WorkerIndex = index;
+	int idle = 0;
+	for (;;) {
+		if (Job* job = FindJob(index)) {
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+		if (!m_Running) break;
+		if (++idle < IDLE_SPINS) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_Sleeping.fetch_add(1);
+		m_WakeUp.wait(lock, [this]() { return m_Pending.load() > 0 || !m_Running; });
+		m_Sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+namespace {
+	// Stands in for a job's real work, the result is kept so it is not optimized away
+	float Work(unsigned int seed, unsigned int rounds) {
+		float value = static_cast<float>(seed & 1023) * 0.001f;
+		for (unsigned int i = 0; i < rounds; i++) value = std::sqrt(value * value + 1.0f) * 0.5f;
+		return value;
+	}
+
+	void ForkJoin(unsigned int depth, unsigned int seed, std::atomic<unsigned int>& sink) {
+		if (depth == 0) {
+			if (Work(seed, 256) < 0.0f) sink.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		JobCounter counter;
+		JobSystem::Get().Run([depth, seed, &sink]() { ForkJoin(depth - 1, 2 * seed + 1, sink); }, &counter);
+		ForkJoin(depth - 1, 2 * seed, sink);
+		JobSystem::Get().Wait(counter);
+	}
+
+	template<typename F>
+	double BestOf(unsigned int iterations, F&& fn) {
+		double best = 0.0;
+		for (unsigned int i = 0; i < iterations; i++) {
+			const auto start = std::chrono::high_resolution_clock::now();
+			fn();
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (i == 0 || milliseconds < best) best = milliseconds;
+		}
+		return best;
+	}
+}
+
+std::vector<JobScaling> RunJobScalingBenchmark(unsigned int maxThreads, unsigned int iterations) {
+	JobSystem& jobs = JobSystem::Get();
+	const unsigned int previous = jobs.IsRunning() ? jobs.GetWorkerCount() : 0;
+	if (maxThreads == 0) maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	maxThreads = std::min(maxThreads, 64u);
+
+	const size_t LOOP_COUNT = 1 << 20;
+	const unsigned int SMALL_JOB_COUNT = 1 << 16;
+	const unsigned int FORK_JOIN_DEPTH = 14;
+	std::vector<float> values(LOOP_COUNT);
+	std::atomic<unsigned int> sink(0);
+
+	std::vector<JobScaling> results;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+		jobs.Shutdown();
+		jobs.Start(threads);
+
+		JobScaling result = {};
+		result.Threads = threads;
+		result.ParallelForMilliseconds = BestOf(iterations, [&]() {
+			jobs.ParallelFor(0, LOOP_COUNT, [&values](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) values[i] = Work(static_cast<unsigned int>(i), 32);
+			});
+		});
+		result.SmallJobsMilliseconds = BestOf(iterations, [&]() {
+			JobCounter counter;
+			for (unsigned int i = 0; i < SMALL_JOB_COUNT; i++) {
+				jobs.Run([i, &sink]() { if (Work(i, 16) < 0.0f) sink.fetch_add(1, std::memory_order_relaxed); }, &counter);
+			}
+			jobs.Wait(counter);
+		});
+		result.ForkJoinMilliseconds = BestOf(iterations, [&]() { ForkJoin(FORK_JOIN_DEPTH, 1, sink); });
+		results.push_back(result);
+
+		if (threads == maxThreads) break;
+	}
+
+	jobs.Shutdown();
+	if (previous) jobs.Start(previous);
+	return results;
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// Counts unfinished jobs. Wait on it, or attach continuations that are scheduled as soon
+// as it reaches zero. A counter can be reused once it is done.
+class JobCounter {
+private:
+	std::atomic<int> m_Value;
+	std::atomic_flag m_Lock;
+	std::vector<Job*> m_Continuations;
+
+	friend class JobSystem;
+
+public:
+	JobCounter() : m_Value(0) { m_Lock.clear(); }
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	inline bool IsDone() const { return m_Value.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+	enum : size_t { STORAGE_SIZE = 64 };
+
+	void (*Invoke)(Job& job);
+	void (*Destroy)(Job& job);
+	JobCounter* Counter;
+	std::atomic<int> InFlight;
+	alignas(16) unsigned char Storage[STORAGE_SIZE];	// the callable, or a pointer to it when larger
+};
+
+// Chase-Lev work stealing deque of a fixed size. The owning thread pushes and pops at the
+// bottom, any other thread steals from the top.
+class WorkStealingDeque {
+private:
+	enum : size_t { CAPACITY = 4096, MASK = CAPACITY - 1 };
+
+	// Kept on separate cache lines, thieves hammer the top while the owner works the bottom
+	std::atomic<int64_t> m_Top;
+	char m_Padding[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> m_Bottom;
+	std::atomic<Job*> m_Jobs[CAPACITY];
+
+public:
+	WorkStealingDeque();
+
+	// Owner only, false when full
+	bool Push(Job* job);
+	Job* Pop();
+	// Any thread
+	Job* Steal();
+	inline bool IsEmpty() const { return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed); }
+};
+
+// One worker per core, each with its own deque; idle workers steal from the others.
+// The thread calling Start counts as worker 0 and runs jobs while it waits. Threads
+// outside the system may schedule too, their jobs go through a shared queue.
+class JobSystem {
+private:
+	struct Worker {
+		WorkStealingDeque Deque;
+		std::vector<Job> Jobs;		// ring the worker allocates its jobs from
+		size_t NextJob = 0;
+		std::thread Thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_Workers;
+	std::vector<Job*> m_Injected;
+	std::mutex m_InjectedMutex;
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeUp;
+	std::atomic<int> m_Pending;
+	std::atomic<int> m_Sleeping;
+	std::atomic<bool> m_Running;
+	std::atomic<unsigned int> m_StealSeed;
+
+public:
+	static JobSystem& Get();
+
+	// threads = 0 uses every hardware thread, the calling thread included
+	void Start(unsigned int threads = 0);
+	// Finishes queued jobs and joins the workers
+	void Shutdown();
+
+	template<typename F>
+	void Run(F&& fn, JobCounter* counter = nullptr) {
+		Schedule(MakeJob(std::forward<F>(fn), counter));
+	}
+
+	// Runs fn once dependency is done, right away if it already is
+	template<typename F>
+	void RunAfter(JobCounter& dependency, F&& fn, JobCounter* counter = nullptr) {
+		Job* job = MakeJob(std::forward<F>(fn), counter);
+		while (dependency.m_Lock.test_and_set(std::memory_order_acquire)) {}
+		if (dependency.IsDone()) {
+			dependency.m_Lock.clear(std::memory_order_release);
+			Schedule(job);
+			return;
+		}
+		dependency.m_Continuations.push_back(job);
+		dependency.m_Lock.clear(std::memory_order_release);
+	}
+
+	// Runs other jobs until the counter reaches zero
+	void Wait(JobCounter& counter);
+	// Runs one queued job if there is any, for threads waiting on something other than a counter
+	bool Help();
+
+	// Calls fn(first, last) over subranges of [begin, end) and returns when all are done.
+	// Ranges are split in halves on demand, so idle workers steal big pieces first;
+	// grain = 0 picks the smallest piece from the range size and the worker count.
+	template<typename F>
+	void ParallelFor(size_t begin, size_t end, F&& fn, size_t grain = 0) {
+		if (end <= begin) return;
+		const size_t count = end - begin;
+		if (grain == 0) grain = std::max<size_t>(1, count / (GetWorkerCount() * 8));
+		if (count <= grain || GetWorkerCount() == 1) {
+			fn(begin, end);
+			return;
+		}
+		JobCounter counter;
+		Split(begin, end, grain, fn, counter);
+		Wait(counter);
+	}
+
+	inline bool IsRunning() const { return !m_Workers.empty(); }
+	inline unsigned int GetWorkerCount() const { return m_Workers.empty() ? 1u : static_cast<unsigned int>(m_Workers.size()); }
+	// 0 for the thread that started the system, -1 for threads outside it
+	static int GetWorkerIndex();
+
+private:
+	JobSystem();
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	template<typename F>
+	Job* MakeJob(F&& fn, JobCounter* counter) {
+		typedef typename std::decay<F>::type Callable;
+		Job* job = AllocateJob();
+		job->Counter = counter;
+		if (counter) counter->m_Value.fetch_add(1, std::memory_order_relaxed);
+		Store<Callable>(*job, std::forward<F>(fn), std::integral_constant<bool,
+			sizeof(Callable) <= Job::STORAGE_SIZE && alignof(Callable) <= 16>());
+		return job;
+	}
+
+	template<typename Callable, typename F>
+	static void Store(Job& job, F&& fn, std::true_type) {
+		new (job.Storage) Callable(std::forward<F>(fn));
+		job.Invoke = [](Job& self) { (*reinterpret_cast<Callable*>(self.Storage))(); };
+		job.Destroy = [](Job& self) { reinterpret_cast<Callable*>(self.Storage)->~Callable(); };
+	}
+	template<typename Callable, typename F>
+	static void Store(Job& job, F&& fn, std::false_type) {
+		// Too big to fit inline, worth one allocation
+		*reinterpret_cast<Callable**>(job.Storage) = new Callable(std::forward<F>(fn));
+		job.Invoke = [](Job& self) { (**reinterpret_cast<Callable**>(self.Storage))(); };
+		job.Destroy = [](Job& self) { delete *reinterpret_cast<Callable**>(self.Storage); };
+	}
+
+	template<typename F>
+	void Split(size_t begin, size_t end, size_t grain, F& fn, JobCounter& counter) {
+		// Hand the upper half to the deque and keep going with the lower one
+		while (end - begin > grain) {
+			const size_t middle = begin + (end - begin) / 2;
+			Run([this, middle, end, grain, &fn, &counter]() { Split(middle, end, grain, fn, counter); }, &counter);
+			end = middle;
+		}
+		fn(begin, end);
+	}
+
+	Job* AllocateJob();
+	void Schedule(Job* job);
+	Job* FindJob(int worker);
+	void Execute(Job* job);
+	void WorkerLoop(int worker);
+};
+
+struct JobScaling {
+	unsigned int Threads;
+	double ParallelForMilliseconds;	// one compute bound loop split with ParallelFor
+	double SmallJobsMilliseconds;	// many tiny jobs on one counter, scheduling overhead
+	double ForkJoinMilliseconds;	// recursive Run and Wait, mostly stealing
+};
+
+// Restarts the job system with 1, 2, 4, ... threads up to maxThreads (every hardware thread
+// when 0, at most 64) and times the same work on each; best of iterations runs. Leaves the
+// system running with the thread count it had, or stopped.
+std::vector<JobScaling> RunJobScalingBenchmark(unsigned int maxThreads, unsigned int iterations);
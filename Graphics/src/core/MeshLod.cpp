@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "MeshLod.h"
+#include "Camera.h"
+
+namespace {
+	// Symmetric 4x4 matrix of the summed plane equations, error of a point is p^T Q p
+	struct Quadric {
+		double A2 = 0, AB = 0, AC = 0, AD = 0;
+		double B2 = 0, BC = 0, BD = 0;
+		double C2 = 0, CD = 0;
+		double D2 = 0;
+		double Weight = 0;
+
+		void AddPlane(const glm::dvec3& n, double d, double weight) {
+			A2 += weight * n.x * n.x; AB += weight * n.x * n.y; AC += weight * n.x * n.z; AD += weight * n.x * d;
+			B2 += weight * n.y * n.y; BC += weight * n.y * n.z; BD += weight * n.y * d;
+			C2 += weight * n.z * n.z; CD += weight * n.z * d;
+			D2 += weight * d * d;
+		}
+
+		void Add(const Quadric& q) {
+			A2 += q.A2; AB += q.AB; AC += q.AC; AD += q.AD;
+			B2 += q.B2; BC += q.BC; BD += q.BD;
+			C2 += q.C2; CD += q.CD;
+			D2 += q.D2;
+			Weight += q.Weight;
+		}
+
+		double Evaluate(const glm::dvec3& p) const {
+			double r = A2 * p.x * p.x + B2 * p.y * p.y + C2 * p.z * p.z + D2
+				+ 2.0 * (AB * p.x * p.y + AC * p.x * p.z + BC * p.y * p.z + AD * p.x + BD * p.y + CD * p.z);
+			return r > 0.0 ? r : 0.0;
+		}
+	};
+
+	inline uint64_t EdgeKey(unsigned int a, unsigned int b) { return (uint64_t(a) << 32) | b; }
+
+	struct Collapse {
+		unsigned int From;	// position ids
+		unsigned int To;
+		double Cost;
+
+		bool operator<(const Collapse& other) const { return Cost < other.Cost; }
+	};
+
+	// Simplifier state kept across levels, so quadrics and errors accumulate from the full mesh
+	class Simplifier {
+	private:
+		const float* m_Vertices;
+		unsigned int m_Stride;
+		std::vector<unsigned int> m_Position;	// vertex -> first vertex with the same position
+		std::vector<unsigned int> m_Wedges;		// vertices grouped by position
+		std::vector<unsigned int> m_WedgeFirst;	// position -> range in m_Wedges
+		std::vector<unsigned int> m_WedgeCount;
+		std::vector<Quadric> m_Quadrics;		// indexed by position id
+		std::vector<unsigned int> m_Indices;
+		double m_Error;
+
+	public:
+		Simplifier(const float* vertices, size_t vertexCount, unsigned int stride,
+				   const unsigned int* indices, size_t indexCount, float borderWeight);
+
+		// Returns false once nothing more can be collapsed under maxError
+		bool Run(size_t targetTriangles, double maxError);
+
+		inline const std::vector<unsigned int>& GetIndices() const { return m_Indices; }
+		inline float GetError() const { return static_cast<float>(std::sqrt(m_Error)); }
+
+	private:
+		inline glm::dvec3 GetPosition(unsigned int vertex) const {
+			const float* p = m_Vertices + size_t(vertex) * m_Stride;
+			return glm::dvec3(p[0], p[1], p[2]);
+		}
+		unsigned int FindWedge(unsigned int wedge, unsigned int to, const std::unordered_set<uint64_t>& edges,
+							   const std::vector<unsigned char>& alive) const;
+		bool Flips(unsigned int from, unsigned int to, const std::vector<unsigned int>& target,
+				   const std::vector<unsigned int>& adjacency, const std::vector<unsigned int>& adjacencyFirst) const;
+	};
+
+	Simplifier::Simplifier(const float* vertices, size_t vertexCount, unsigned int stride,
+						   const unsigned int* indices, size_t indexCount, float borderWeight) :
+		m_Vertices(vertices), m_Stride(stride), m_Error(0.0)
+	{
+		// Weld vertices that are identical in every attribute, then group the rest by position
+		struct VertexHash {
+			const float* Vertices; unsigned int Floats; unsigned int Stride;
+			size_t operator()(unsigned int v) const {
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(Vertices + size_t(v) * Stride);
+				size_t h = 2166136261u;
+				for (size_t i = 0; i < Floats * sizeof(float); i++) h = (h ^ bytes[i]) * 16777619u;
+				return h;
+			}
+		};
+		struct VertexEqual {
+			const float* Vertices; unsigned int Floats; unsigned int Stride;
+			bool operator()(unsigned int a, unsigned int b) const {
+				return std::memcmp(Vertices + size_t(a) * Stride, Vertices + size_t(b) * Stride, Floats * sizeof(float)) == 0;
+			}
+		};
+
+		std::vector<unsigned int> weld(vertexCount);
+		std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> unique(vertexCount,
+			VertexHash{ vertices, stride, stride }, VertexEqual{ vertices, stride, stride });
+		std::unordered_map<unsigned int, unsigned int, VertexHash, VertexEqual> positions(vertexCount,
+			VertexHash{ vertices, 3, stride }, VertexEqual{ vertices, 3, stride });
+		m_Position.resize(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			weld[v] = unique.emplace(v, v).first->second;
+			m_Position[v] = positions.emplace(v, v).first->second;
+		}
+
+		m_Indices.resize(indexCount);
+		for (size_t i = 0; i < indexCount; i++) m_Indices[i] = weld[indices[i]];
+
+		// Wedges: the distinct vertices at each position
+		m_WedgeFirst.assign(vertexCount, 0);
+		m_WedgeCount.assign(vertexCount, 0);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			if (weld[v] == v) m_WedgeCount[m_Position[v]]++;
+		}
+		unsigned int offset = 0;
+		for (unsigned int p = 0; p < vertexCount; p++) {
+			m_WedgeFirst[p] = offset;
+			offset += m_WedgeCount[p];
+			m_WedgeCount[p] = 0;
+		}
+		m_Wedges.resize(offset);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			if (weld[v] == v) m_Wedges[m_WedgeFirst[m_Position[v]] + m_WedgeCount[m_Position[v]]++] = v;
+		}
+
+		// Face planes, weighted by area so the error is a mean over the surface
+		m_Quadrics.resize(vertexCount);
+		std::unordered_set<uint64_t> edges(m_Indices.size() * 2);
+		for (size_t i = 0; i + 2 < m_Indices.size(); i += 3) {
+			for (int e = 0; e < 3; e++) edges.insert(EdgeKey(m_Indices[i + e], m_Indices[i + (e + 1) % 3]));
+		}
+		for (size_t i = 0; i + 2 < m_Indices.size(); i += 3) {
+			const unsigned int corners[3] = { m_Indices[i], m_Indices[i + 1], m_Indices[i + 2] };
+			const glm::dvec3 p0 = GetPosition(corners[0]), p1 = GetPosition(corners[1]), p2 = GetPosition(corners[2]);
+			glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const double length = glm::length(normal);
+			if (length == 0.0) continue;
+			normal /= length;
+			const double area = length * 0.5;
+
+			Quadric face;
+			face.AddPlane(normal, -glm::dot(normal, p0), area);
+			face.Weight = area;
+			for (unsigned int c : corners) m_Quadrics[m_Position[c]].Add(face);
+
+			// Edges without a twin are open borders or seams, keep them in place with a plane
+			// through the edge, perpendicular to the face
+			for (int e = 0; e < 3; e++) {
+				const unsigned int a = corners[e], b = corners[(e + 1) % 3];
+				if (edges.count(EdgeKey(b, a))) continue;
+				const glm::dvec3 edge = GetPosition(b) - GetPosition(a);
+				const double edgeLength = glm::length(edge);
+				if (edgeLength == 0.0) continue;
+				const glm::dvec3 side = glm::cross(edge / edgeLength, normal);
+
+				Quadric border;
+				border.AddPlane(side, -glm::dot(side, GetPosition(a)), edgeLength * edgeLength * borderWeight);
+				m_Quadrics[m_Position[a]].Add(border);
+				m_Quadrics[m_Position[b]].Add(border);
+			}
+		}
+	}
+
+	unsigned int Simplifier::FindWedge(unsigned int wedge, unsigned int to, const std::unordered_set<uint64_t>& edges,
+									   const std::vector<unsigned char>& alive) const {
+		for (unsigned int i = 0; i < m_WedgeCount[to]; i++) {
+			const unsigned int other = m_Wedges[m_WedgeFirst[to] + i];
+			if (alive[other] && (edges.count(EdgeKey(wedge, other)) || edges.count(EdgeKey(other, wedge)))) return other;
+		}
+		return ~0u;
+	}
+
+	bool Simplifier::Flips(unsigned int from, unsigned int to, const std::vector<unsigned int>& target,
+						   const std::vector<unsigned int>& adjacency, const std::vector<unsigned int>& adjacencyFirst) const {
+		const glm::dvec3 destination = GetPosition(to);
+		for (unsigned int i = adjacencyFirst[from]; i < adjacencyFirst[from + 1]; i++) {
+			const size_t triangle = adjacency[i];
+			unsigned int corners[3];
+			for (int c = 0; c < 3; c++) corners[c] = m_Position[target[m_Indices[triangle * 3 + c]]];
+			// Triangles on the collapsed edge disappear
+			if (corners[0] == to || corners[1] == to || corners[2] == to) continue;
+
+			glm::dvec3 p[3] = { GetPosition(corners[0]), GetPosition(corners[1]), GetPosition(corners[2]) };
+			const glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for (int c = 0; c < 3; c++) {
+				if (corners[c] == from) p[c] = destination;
+			}
+			const glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+			// Reject flipped and nearly degenerate results
+			if (glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after)) return true;
+		}
+		return false;
+	}
+
+	bool Simplifier::Run(size_t targetTriangles, double maxError) {
+		const size_t vertexCount = m_Position.size();
+		const double maxCost = maxError * maxError;
+
+		while (m_Indices.size() / 3 > targetTriangles) {
+			const size_t triangleCount = m_Indices.size() / 3;
+
+			// Triangles around each position
+			std::vector<unsigned int> adjacencyFirst(vertexCount + 1, 0);
+			for (unsigned int index : m_Indices) adjacencyFirst[m_Position[index] + 1]++;
+			for (size_t p = 0; p < vertexCount; p++) adjacencyFirst[p + 1] += adjacencyFirst[p];
+			std::vector<unsigned int> adjacency(m_Indices.size());
+			{
+				std::vector<unsigned int> fill(adjacencyFirst.begin(), adjacencyFirst.end() - 1);
+				for (size_t i = 0; i < m_Indices.size(); i++) adjacency[fill[m_Position[m_Indices[i]]]++] = static_cast<unsigned int>(i / 3);
+			}
+
+			std::vector<unsigned char> alive(vertexCount, 0);
+			std::unordered_set<uint64_t> edges(m_Indices.size() * 2);
+			std::vector<Collapse> candidates;
+			candidates.reserve(m_Indices.size());
+			for (size_t i = 0; i < m_Indices.size(); i += 3) {
+				for (int e = 0; e < 3; e++) {
+					const unsigned int a = m_Indices[i + e], b = m_Indices[i + (e + 1) % 3];
+					alive[a] = 1;
+					edges.insert(EdgeKey(a, b));
+					const unsigned int pa = m_Position[a], pb = m_Position[b];
+					if (pa < pb) candidates.push_back(Collapse{ pa, pb, 0.0 });
+					else if (pb < pa) candidates.push_back(Collapse{ pb, pa, 0.0 });
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+				return a.From != b.From ? a.From < b.From : a.To < b.To;
+			});
+			candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Collapse& a, const Collapse& b) {
+				return a.From == b.From && a.To == b.To;
+			}), candidates.end());
+
+			// Every wedge of the removed position needs a wedge of the kept one it shares an edge with,
+			// otherwise its attributes would be lost. Pick the cheaper valid direction.
+			auto collapsible = [&](unsigned int from, unsigned int to) {
+				for (unsigned int i = 0; i < m_WedgeCount[from]; i++) {
+					const unsigned int wedge = m_Wedges[m_WedgeFirst[from] + i];
+					if (alive[wedge] && FindWedge(wedge, to, edges, alive) == ~0u) return false;
+				}
+				return true;
+			};
+			auto cost = [&](unsigned int from, unsigned int to) {
+				Quadric q = m_Quadrics[from];
+				q.Add(m_Quadrics[to]);
+				return q.Evaluate(GetPosition(to)) / std::max(q.Weight, 1e-30);
+			};
+			size_t valid = 0;
+			for (const Collapse& candidate : candidates) {
+				const bool forward = collapsible(candidate.From, candidate.To);
+				const bool backward = collapsible(candidate.To, candidate.From);
+				if (!forward && !backward) continue;
+				Collapse best = candidate;
+				best.Cost = forward ? cost(candidate.From, candidate.To) : 1e300;
+				const double reverse = backward ? cost(candidate.To, candidate.From) : 1e300;
+				if (reverse < best.Cost) best = Collapse{ candidate.To, candidate.From, reverse };
+				if (best.Cost <= maxCost) candidates[valid++] = best;
+			}
+			candidates.resize(valid);
+			std::sort(candidates.begin(), candidates.end());
+
+			// Greedy pass, each position takes part in at most one collapse so the
+			// adjacency above stays valid for the flip test
+			std::vector<unsigned int> target(vertexCount);
+			for (unsigned int v = 0; v < vertexCount; v++) target[v] = v;
+			std::vector<unsigned char> locked(vertexCount, 0);
+			size_t remaining = triangleCount;
+			size_t collapses = 0;
+			// Collapse at most a quarter of the edges per pass so later choices see updated quadrics
+			const size_t passLimit = std::max<size_t>(1, candidates.size() / 4);
+			for (const Collapse& collapse : candidates) {
+				if (remaining <= targetTriangles || collapses >= passLimit) break;
+				if (locked[collapse.From] || locked[collapse.To]) continue;
+				if (Flips(collapse.From, collapse.To, target, adjacency, adjacencyFirst)) continue;
+
+				for (unsigned int i = 0; i < m_WedgeCount[collapse.From]; i++) {
+					const unsigned int wedge = m_Wedges[m_WedgeFirst[collapse.From] + i];
+					if (alive[wedge]) target[wedge] = FindWedge(wedge, collapse.To, edges, alive);
+				}
+				for (unsigned int i = adjacencyFirst[collapse.From]; i < adjacencyFirst[collapse.From + 1]; i++) {
+					const size_t triangle = adjacency[i];
+					for (int c = 0; c < 3; c++) {
+						if (m_Position[m_Indices[triangle * 3 + c]] == collapse.To) { remaining--; break; }
+					}
+				}
+				m_Quadrics[collapse.To].Add(m_Quadrics[collapse.From]);
+				m_Error = std::max(m_Error, collapse.Cost);
+				locked[collapse.From] = locked[collapse.To] = 1;
+				collapses++;
+			}
+			if (collapses == 0) return false;
+
+			// Remap and drop the triangles that collapsed
+			size_t write = 0;
+			for (size_t i = 0; i < m_Indices.size(); i += 3) {
+				const unsigned int a = target[m_Indices[i]], b = target[m_Indices[i + 1]], c = target[m_Indices[i + 2]];
+				if (m_Position[a] == m_Position[b] || m_Position[b] == m_Position[c] || m_Position[a] == m_Position[c]) continue;
+				m_Indices[write++] = a;
+				m_Indices[write++] = b;
+				m_Indices[write++] = c;
+			}
+			m_Indices.resize(write);
+		}
+		return true;
+	}
+}
+
+LodChain BuildLodChain(const float* vertices, size_t vertexCount, unsigned int stride,
+					   const unsigned int* indices, size_t indexCount, const LodSettings& settings) {
+	LodChain chain;
+	chain.Indices.assign(indices, indices + indexCount);
+	chain.Levels.push_back(LodLevel{ 0, static_cast<unsigned int>(indexCount), 0.0f });
+
+	Simplifier simplifier(vertices, vertexCount, stride, indices, indexCount, settings.BorderWeight);
+	size_t triangles = indexCount / 3;
+	while (chain.Levels.size() < settings.MaxLevels) {
+		const size_t target = static_cast<size_t>(triangles * settings.Reduction);
+		if (target < settings.MinTriangles) break;
+
+		const bool more = simplifier.Run(target, settings.MaxError);
+		const std::vector<unsigned int>& simplified = simplifier.GetIndices();
+		// A level that barely saves anything is not worth its memory
+		if (simplified.size() / 3 > triangles - triangles / 10) break;
+
+		LodLevel level;
+		level.IndexOffset = static_cast<unsigned int>(chain.Indices.size());
+		level.IndexCount = static_cast<unsigned int>(simplified.size());
+		level.Error = simplifier.GetError();
+		chain.Indices.insert(chain.Indices.end(), simplified.begin(), simplified.end());
+		chain.Levels.push_back(level);
+
+		triangles = simplified.size() / 3;
+		if (!more) break;
+	}
+	return chain;
+}
+
+LodSelector::LodSelector() :
+	m_Eye(0.0f),
+	m_PixelsPerUnit(1.0f),
+	m_Orthographic(false),
+	m_Threshold(1.0f),
+	m_Hysteresis(0.25f)
+{
+}
+
+void LodSelector::BeginFrame(Camera& camera, float viewportHeight) {
+	BeginFrame(camera.Position, camera.GetProjectionMatrix(), viewportHeight);
+}
+
+void LodSelector::BeginFrame(const glm::vec3& eye, const glm::mat4& projection, float viewportHeight) {
+	m_Eye = eye;
+	// projection[1][1] is cot(fov / 2) for perspective and 2 / height for orthographic projections
+	m_PixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+	m_Orthographic = projection[3][3] == 1.0f;
+}
+
+float LodSelector::GetScreenError(float error, const glm::vec3& center, float radius, float scale) const {
+	if (m_Orthographic) return error * scale * m_PixelsPerUnit;
+	// Distance to the nearest point of the bounding sphere, clamped so objects around the camera stay finest
+	const float distance = std::max(glm::length(center - m_Eye) - radius, 1e-4f);
+	return error * scale * m_PixelsPerUnit / distance;
+}
+
+unsigned int LodSelector::Select(unsigned int object, const LodChain& chain, const glm::vec3& center, float radius, float scale) {
+	if (object >= m_Current.size()) m_Current.resize(object + 1, 0);
+	const unsigned int levelCount = static_cast<unsigned int>(chain.Levels.size());
+	if (levelCount == 0) return 0;
+
+	// Errors grow with the level, find the coarsest acceptable one and the coarsest comfortably acceptable one
+	const float factor = GetScreenError(1.0f, center, radius, scale);
+	unsigned int acceptable = 0, comfortable = 0;
+	for (unsigned int level = 1; level < levelCount; level++) {
+		const float pixels = chain.Levels[level].Error * factor;
+		if (pixels > m_Threshold) break;
+		acceptable = level;
+		if (pixels <= m_Threshold * (1.0f - m_Hysteresis)) comfortable = level;
+	}
+
+	unsigned int current = std::min<unsigned int>(m_Current[object], levelCount - 1);
+	if (current > acceptable) current = acceptable;
+	else if (comfortable > current) current = comfortable;
+	m_Current[object] = static_cast<unsigned char>(current);
+	return current;
+}
+
+unsigned int RunLodTest() {
+	// Cylinder of radius 1 from y = -1 to 1, interleaved position, normal, uv. The side wraps its
+	// u coordinate (a UV seam down one line), the caps meet it with flat normals (normal seams
+	// around both rims). Seam vertices share positions bit for bit, the cosines come from one table.
+	const unsigned int segments = 64, rows = 32, rings = 8, stride = 8;
+	const float pi = 3.14159265358979f;
+	std::vector<float> cosines(segments), sines(segments);
+	for (unsigned int i = 0; i < segments; i++) {
+		cosines[i] = std::cos(2.0f * pi * i / segments);
+		sines[i] = std::sin(2.0f * pi * i / segments);
+	}
+
+	std::vector<float> vertices;
+	std::vector<unsigned int> groups;	// 0 side, 1 top, 2 bottom
+	auto addVertex = [&](const glm::vec3& position, const glm::vec3& normal, float u, float v, unsigned int group) {
+		const float values[stride] = { position.x, position.y, position.z, normal.x, normal.y, normal.z, u, v };
+		vertices.insert(vertices.end(), values, values + stride);
+		groups.push_back(group);
+		return static_cast<unsigned int>(groups.size() - 1);
+	};
+	std::vector<unsigned int> indices;
+	// Wound counter-clockwise seen along the normal the triangle should face
+	auto addTriangle = [&](unsigned int a, unsigned int b, unsigned int c) {
+		auto position = [&](unsigned int vertex) { return glm::vec3(vertices[vertex * stride], vertices[vertex * stride + 1], vertices[vertex * stride + 2]); };
+		const glm::vec3 normal(vertices[a * stride + 3], vertices[a * stride + 4], vertices[a * stride + 5]);
+		if (glm::dot(glm::cross(position(b) - position(a), position(c) - position(a)), normal) < 0.0f) std::swap(b, c);
+		indices.push_back(a);
+		indices.push_back(b);
+		indices.push_back(c);
+	};
+
+	const unsigned int side = 0;
+	for (unsigned int j = 0; j <= rows; j++) {
+		for (unsigned int i = 0; i <= segments; i++) {
+			const unsigned int k = i % segments;
+			addVertex(glm::vec3(cosines[k], -1.0f + 2.0f * j / rows, sines[k]), glm::vec3(cosines[k], 0.0f, sines[k]),
+					  static_cast<float>(i) / segments, static_cast<float>(j) / rows, 0);
+		}
+	}
+	for (unsigned int j = 0; j < rows; j++) {
+		for (unsigned int i = 0; i < segments; i++) {
+			const unsigned int a = side + j * (segments + 1) + i, b = a + segments + 1;
+			addTriangle(a, b, b + 1);
+			addTriangle(a, b + 1, a + 1);
+		}
+	}
+	for (unsigned int cap = 1; cap <= 2; cap++) {
+		const float y = cap == 1 ? 1.0f : -1.0f;
+		const glm::vec3 normal(0.0f, y, 0.0f);
+		const unsigned int center = addVertex(glm::vec3(0.0f, y, 0.0f), normal, 0.5f, 0.5f, cap);
+		for (unsigned int r = 1; r <= rings; r++) {
+			const float radius = static_cast<float>(r) / rings;
+			for (unsigned int i = 0; i < segments; i++) {
+				addVertex(glm::vec3(cosines[i] * radius, y, sines[i] * radius), normal, 0.5f + 0.5f * cosines[i] * radius, 0.5f + 0.5f * sines[i] * radius, cap);
+			}
+		}
+		for (unsigned int i = 0; i < segments; i++) {
+			const unsigned int next = (i + 1) % segments;
+			addTriangle(center, center + 1 + i, center + 1 + next);
+			for (unsigned int r = 1; r < rings; r++) {
+				const unsigned int inner = center + 1 + (r - 1) * segments, outer = inner + segments;
+				addTriangle(inner + i, outer + i, outer + next);
+				addTriangle(inner + i, outer + next, inner + next);
+			}
+		}
+	}
+
+	unsigned int failures = 0;
+	auto check = [&failures](bool passed, const char* name, size_t level) {
+		if (passed) return;
+		std::cout << "ERROR::LOD_TEST::" << name << " level " << level << std::endl;
+		failures++;
+	};
+
+	LodSettings settings;
+	const size_t vertexCount = groups.size();
+	const LodChain chain = BuildLodChain(vertices.data(), vertexCount, stride, indices.data(), indices.size(), settings);
+	check(chain.Levels.size() >= 3, "TOO_FEW_LEVELS", chain.Levels.size());
+	for (size_t level = 1; level < chain.Levels.size(); level++) {
+		const LodLevel& previous = chain.Levels[level - 1];
+		const LodLevel& current = chain.Levels[level];
+		check(current.IndexCount < previous.IndexCount, "TRIANGLES_NOT_DECREASING", level);
+		check(current.Error >= previous.Error, "ERROR_NOT_MONOTONIC", level);
+
+		for (unsigned int i = current.IndexOffset; i + 2 < current.IndexOffset + current.IndexCount; i += 3) {
+			const unsigned int corners[3] = { chain.Indices[i], chain.Indices[i + 1], chain.Indices[i + 2] };
+			// A triangle spanning a seam would blend the normals or UVs of both sides
+			const unsigned int group = groups[corners[0]];
+			bool sameGroup = true;
+			float minU = 1.0f, maxU = 0.0f;
+			for (unsigned int corner : corners) {
+				sameGroup = sameGroup && groups[corner] == group;
+				minU = std::min(minU, vertices[corner * stride + 6]);
+				maxU = std::max(maxU, vertices[corner * stride + 6]);
+			}
+			check(sameGroup, "NORMAL_SEAM_CROSSED", level);
+			check(group != 0 || maxU - minU < 0.5f, "UV_SEAM_CROSSED", level);
+		}
+	}
+
+	// Hover around the distance where level 1 reaches the threshold, from near and from far
+	const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	const float viewportHeight = 600.0f, radius = 1.5f;
+	LodSelector selector;
+	selector.BeginFrame(glm::vec3(0.0f), projection, viewportHeight);
+	const float threshold = 1.0f;
+	selector.SetThreshold(threshold);
+	if (chain.Levels.size() > 1) {
+		const float switchDistance = chain.Levels[1].Error * projection[1][1] * viewportHeight * 0.5f / threshold + radius;
+		for (int start = 0; start < 2; start++) {
+			selector.Reset();
+			const float approach = start == 0 ? 0.5f : 4.0f;
+			const unsigned int first = selector.Select(0, chain, glm::vec3(0.0f, 0.0f, -switchDistance * approach), radius);
+			check(start == 0 ? first == 0 : first > 0, "WRONG_START_LEVEL", first);
+			unsigned int previous = first, changes = 0;
+			for (int frame = 0; frame < 100; frame++) {
+				const float distance = switchDistance * (frame % 2 ? 1.01f : 0.99f);
+				const unsigned int level = selector.Select(0, chain, glm::vec3(0.0f, 0.0f, -distance), radius);
+				if (level != previous) changes++;
+				previous = level;
+			}
+			check(changes <= 1, "SELECTOR_FLIPS", changes);
+		}
+	}
+	return failures;
+}
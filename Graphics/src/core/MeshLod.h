@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "glm.hpp"
+
+class Camera;
+
+struct LodSettings {
+	unsigned int MaxLevels = 6;
+	// Triangle count of each level relative to the previous one
+	float Reduction = 0.5f;
+	unsigned int MinTriangles = 32;
+	// Object space error past which no further simplification is attempted
+	float MaxError = 1e30f;
+	// Extra weight of the constraint planes keeping open borders and UV / attribute seams in place
+	float BorderWeight = 10.0f;
+};
+
+struct LodLevel {
+	unsigned int IndexOffset;	// into LodChain::Indices, also the element buffer offset in indices
+	unsigned int IndexCount;
+	float Error;				// object space deviation from the full mesh, 0 for level 0
+};
+
+// All levels of a mesh share its vertex buffer, their index lists are stored back to back
+// so the whole chain fits in one element buffer. Levels go from finest to coarsest.
+struct LodChain {
+	std::vector<LodLevel> Levels;
+	std::vector<unsigned int> Indices;
+};
+
+// Builds a chain with quadric error edge collapse. Vertices are interleaved floats with the
+// position first, stride counts floats. Vertices sharing a position but differing in any
+// other attribute form a seam: a collapse has to move every one of them along an edge to a
+// matching vertex, so UVs and normals are never stretched across the seam.
+LodChain BuildLodChain(const float* vertices, size_t vertexCount, unsigned int stride,
+					   const unsigned int* indices, size_t indexCount,
+					   const LodSettings& settings = LodSettings());
+
+// Picks a level per object from the error it would have on screen, in pixels.
+// A level is only made coarser once its error is comfortably below the threshold and made
+// finer as soon as it goes above, so objects near the switching distance do not pop back and forth.
+class LodSelector {
+private:
+	std::vector<unsigned char> m_Current;
+	glm::vec3 m_Eye;
+	float m_PixelsPerUnit;	// screen pixels of an object space unit at distance 1
+	bool m_Orthographic;
+	float m_Threshold;
+	float m_Hysteresis;
+
+public:
+	LodSelector();
+
+	void BeginFrame(Camera& camera, float viewportHeight);
+	void BeginFrame(const glm::vec3& eye, const glm::mat4& projection, float viewportHeight);
+
+	// center / radius bound the object in world space, scale converts object space errors to world space
+	unsigned int Select(unsigned int object, const LodChain& chain, const glm::vec3& center, float radius, float scale = 1.0f);
+	float GetScreenError(float error, const glm::vec3& center, float radius, float scale = 1.0f) const;
+
+	inline void SetThreshold(float pixels) { m_Threshold = pixels; }
+	inline void SetHysteresis(float fraction) { m_Hysteresis = fraction; }
+	inline void Reset() { m_Current.clear(); }
+};
+
+// Simplifies a tessellated, capped cylinder with UV and normal seams and checks that the
+// levels get smaller, errors grow, no triangle mixes wedges from different sides of a seam
+// and the selector does not flip around its threshold. Returns the number of failures.
+unsigned int RunLodTest();
@@ -0,0 +1,265 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "OcclusionCuller.h"
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+#include "gtc/matrix_transform.hpp"
+
+#if CPU_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace {
+	// Triangles whose vertices come closer to the eye than this in clip w are skipped
+	const float NEAR_W = 1e-4f;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height) :
+	m_Width((width + 3) & ~3),
+	m_Height((height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+	m_BackfaceCulling(true),
+	m_ViewProjection(1.0f)
+{
+	m_TilesX = (m_Width + TILE_SIZE - 1) / TILE_SIZE;
+	m_TilesY = m_Height / TILE_SIZE;
+	m_Depth.assign(static_cast<size_t>(m_Width) * m_Height, 1.0f);
+	m_TileMaxDepth.assign(static_cast<size_t>(m_TilesX) * m_TilesY, 1.0f);
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection) {
+	m_ViewProjection = viewProjection;
+	m_Triangles.clear();
+}
+
+void OcclusionCuller::AddOccluder(const float* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& model) {
+	const glm::mat4 transform = m_ViewProjection * model;
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		glm::vec3 screen[3];
+		bool clipped = false;
+		for (int v = 0; v < 3; v++) {
+			const float* p = positions + indices[i + v] * 3;
+			const glm::vec4 clip = transform * glm::vec4(p[0], p[1], p[2], 1.0f);
+			if (clip.w < NEAR_W) {
+				clipped = true;
+				break;
+			}
+			const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			screen[v] = glm::vec3((ndc.x * 0.5f + 0.5f) * m_Width, (ndc.y * 0.5f + 0.5f) * m_Height, ndc.z * 0.5f + 0.5f);
+		}
+		if (clipped) continue;
+
+		const glm::vec3& v0 = screen[0];
+		glm::vec3 v1 = screen[1];
+		glm::vec3 v2 = screen[2];
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area == 0.0f) continue;
+		if (area < 0.0f) {
+			if (m_BackfaceCulling) continue;
+			std::swap(v1, v2);
+			area = -area;
+		}
+
+		Triangle triangle;
+		triangle.MinX = std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+		triangle.MinY = std::max(0, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+		triangle.MaxX = std::min(m_Width - 1, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+		triangle.MaxY = std::min(m_Height - 1, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY) continue;
+
+		const glm::vec3 vertices[3] = { v0, v1, v2 };
+		for (int e = 0; e < 3; e++) {
+			const glm::vec3& a = vertices[e];
+			const glm::vec3& b = vertices[(e + 1) % 3];
+			triangle.EdgeA[e] = a.y - b.y;
+			triangle.EdgeB[e] = b.x - a.x;
+			triangle.EdgeC[e] = a.x * b.y - a.y * b.x;
+		}
+
+		// Window depth is linear in screen space
+		const float dz1 = v1.z - v0.z, dz2 = v2.z - v0.z;
+		triangle.DepthA = (dz1 * (v2.y - v0.y) - dz2 * (v1.y - v0.y)) / area;
+		triangle.DepthB = (dz2 * (v1.x - v0.x) - dz1 * (v2.x - v0.x)) / area;
+		triangle.DepthC = v0.z - triangle.DepthA * v0.x - triangle.DepthB * v0.y;
+		m_Triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::Rasterize() {
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+
+	// Bands are whole tile rows so each job also owns its tiles
+	const size_t tileRowsPerBand = std::max<size_t>(1, m_TilesY / JobSystem::Get().GetWorkerCount());
+	JobSystem::Get().ParallelFor(0, m_TilesY, [this](size_t first, size_t last) {
+		const int rowBegin = static_cast<int>(first) * TILE_SIZE;
+		const int rowEnd = std::min(m_Height, static_cast<int>(last) * TILE_SIZE);
+		RasterizeBand(rowBegin, rowEnd);
+		UpdateTiles(rowBegin, rowEnd);
+	}, tileRowsPerBand);
+}
+
+void OcclusionCuller::RasterizeBand(int rowBegin, int rowEnd) {
+	for (const Triangle& t : m_Triangles) {
+		const int y0 = std::max(t.MinY, rowBegin);
+		const int y1 = std::min(t.MaxY, rowEnd - 1);
+		if (y0 > y1) continue;
+		// Rows are processed 4 pixels at a time from a 4-aligned start, the width is a multiple of 4
+		const int x0 = t.MinX & ~3;
+
+		for (int y = y0; y <= y1; y++) {
+			const float py = y + 0.5f;
+			const float row0 = t.EdgeB[0] * py + t.EdgeC[0];
+			const float row1 = t.EdgeB[1] * py + t.EdgeC[1];
+			const float row2 = t.EdgeB[2] * py + t.EdgeC[2];
+			const float rowDepth = t.DepthB * py + t.DepthC;
+			float* depth = &m_Depth[static_cast<size_t>(y) * m_Width];
+
+#if CPU_SSE2
+			const __m128 a0 = _mm_set1_ps(t.EdgeA[0]), a1 = _mm_set1_ps(t.EdgeA[1]), a2 = _mm_set1_ps(t.EdgeA[2]);
+			const __m128 r0 = _mm_set1_ps(row0), r1 = _mm_set1_ps(row1), r2 = _mm_set1_ps(row2);
+			const __m128 da = _mm_set1_ps(t.DepthA), dr = _mm_set1_ps(rowDepth);
+			const __m128 zero = _mm_setzero_ps();
+			for (int x = x0; x <= t.MaxX; x += 4) {
+				const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+				__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), r0), zero);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), r1), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), r2), zero));
+				if (_mm_movemask_ps(inside) == 0) continue;
+
+				const __m128 z = _mm_add_ps(_mm_mul_ps(da, px), dr);
+				const __m128 old = _mm_loadu_ps(depth + x);
+				const __m128 closer = _mm_min_ps(old, z);
+				_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+			}
+#else
+			for (int x = x0; x <= t.MaxX; x++) {
+				const float px = x + 0.5f;
+				if (t.EdgeA[0] * px + row0 < 0.0f || t.EdgeA[1] * px + row1 < 0.0f || t.EdgeA[2] * px + row2 < 0.0f) continue;
+				depth[x] = std::min(depth[x], t.DepthA * px + rowDepth);
+			}
+#endif
+		}
+	}
+}
+
+void OcclusionCuller::UpdateTiles(int rowBegin, int rowEnd) {
+	for (int ty = rowBegin / TILE_SIZE; ty < rowEnd / TILE_SIZE; ty++) {
+		for (int tx = 0; tx < m_TilesX; tx++) {
+			float farthest = 0.0f;
+			const int xEnd = std::min(m_Width, (tx + 1) * TILE_SIZE);
+			for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++) {
+				const float* row = &m_Depth[static_cast<size_t>(y) * m_Width];
+				for (int x = tx * TILE_SIZE; x < xEnd; x++) farthest = std::max(farthest, row[x]);
+			}
+			m_TileMaxDepth[static_cast<size_t>(ty) * m_TilesX + tx] = farthest;
+		}
+	}
+}
+
+bool OcclusionCuller::TestBox(const AABB& box) const {
+	// Screen rectangle and nearest depth of the eight corners
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+	for (int i = 0; i < 8; i++) {
+		const glm::vec3 corner((i & 1) ? box.Max.x : box.Min.x, (i & 2) ? box.Max.y : box.Min.y, (i & 4) ? box.Max.z : box.Min.z);
+		const glm::vec4 clip = m_ViewProjection * glm::vec4(corner, 1.0f);
+		// Boxes reaching behind the eye cannot be resolved against a depth buffer
+		if (clip.w < NEAR_W) return true;
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		minX = std::min(minX, ndc.x);
+		maxX = std::max(maxX, ndc.x);
+		minY = std::min(minY, ndc.y);
+		maxY = std::max(maxY, ndc.y);
+		nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+	}
+	if (nearest < 0.0f) return true;
+
+	const int x0 = std::max(0, static_cast<int>(std::floor((minX * 0.5f + 0.5f) * m_Width)));
+	const int y0 = std::max(0, static_cast<int>(std::floor((minY * 0.5f + 0.5f) * m_Height)));
+	const int x1 = std::min(m_Width - 1, static_cast<int>(std::floor((maxX * 0.5f + 0.5f) * m_Width)));
+	const int y1 = std::min(m_Height - 1, static_cast<int>(std::floor((maxY * 0.5f + 0.5f) * m_Height)));
+	if (x0 > x1 || y0 > y1) return true;
+
+	for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+		for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) {
+			// Whole tile is closer than the box
+			if (nearest > m_TileMaxDepth[static_cast<size_t>(ty) * m_TilesX + tx]) continue;
+
+			const int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, (tx + 1) * TILE_SIZE - 1);
+			const int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, (ty + 1) * TILE_SIZE - 1);
+			for (int y = py0; y <= py1; y++) {
+				const float* row = &m_Depth[static_cast<size_t>(y) * m_Width];
+				for (int x = px0; x <= px1; x++) {
+					if (nearest <= row[x]) return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+size_t OcclusionCuller::Cull(const std::vector<AABB>& boxes, std::vector<unsigned int>& indices) const {
+	size_t count = 0;
+	for (unsigned int index : indices) {
+		indices[count] = index;
+		count += TestBox(boxes[index]) ? 1 : 0;
+	}
+	indices.resize(count);
+	return count;
+}
+
+unsigned int RunOcclusionTest() {
+	// Camera at the origin looking down -z at a 20 x 20 wall 10 units away
+	const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 2.0f, 1.0f, 100.0f);
+	const float wall[] = { -10.0f, -10.0f, -10.0f,  10.0f, -10.0f, -10.0f,  10.0f, 10.0f, -10.0f,  -10.0f, 10.0f, -10.0f };
+	const unsigned int wallIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+	OcclusionCuller culler(256, 128);
+	unsigned int failures = 0;
+	auto check = [&failures](bool passed, const char* name) {
+		if (passed) return;
+		std::cout << "ERROR::OCCLUSION_TEST::" << name << std::endl;
+		failures++;
+	};
+
+	// Nothing rasterized, nothing hidden
+	culler.BeginFrame(projection);
+	culler.Rasterize();
+	check(culler.TestBox(AABB(glm::vec3(-1.0f, -1.0f, -50.0f), glm::vec3(1.0f, 1.0f, -48.0f))), "EMPTY_BUFFER_HIDES");
+
+	culler.AddOccluder(wall, wallIndices, 6, glm::mat4(1.0f));
+	check(culler.GetTriangleCount() == 2, "WALL_NOT_SET_UP");
+	culler.Rasterize();
+
+	// Window depth of the wall: z_ndc = (f + n) / (f - n) - 2 f n / ((f - n) d) at distance d
+	const float expected = 0.5f * ((101.0f / 99.0f) - 200.0f / (99.0f * 10.0f)) + 0.5f;
+	const std::vector<float>& depth = culler.GetDepthBuffer();
+	check(std::fabs(depth[64 * culler.GetWidth() + 128] - expected) < 1e-5f, "WALL_DEPTH");
+	// The wall spans the middle half of the screen width, the left edge stays clear
+	check(depth[0] == 1.0f, "CORNER_COVERED");
+
+	check(!culler.TestBox(AABB(glm::vec3(-1.0f, -1.0f, -30.0f), glm::vec3(1.0f, 1.0f, -20.0f))), "BOX_BEHIND_WALL_VISIBLE");
+	check(culler.TestBox(AABB(glm::vec3(-1.0f, -1.0f, -8.0f), glm::vec3(1.0f, 1.0f, -6.0f))), "BOX_BEFORE_WALL_HIDDEN");
+	check(culler.TestBox(AABB(glm::vec3(-1.0f, -1.0f, -11.0f), glm::vec3(1.0f, 1.0f, -9.0f))), "BOX_THROUGH_WALL_HIDDEN");
+	// Behind the wall but sticking out past its side, where the far plane shows
+	check(culler.TestBox(AABB(glm::vec3(5.0f, -1.0f, -30.0f), glm::vec3(25.0f, 1.0f, -20.0f))), "BOX_PAST_EDGE_HIDDEN");
+	check(culler.TestBox(AABB(glm::vec3(-1.0f, -1.0f, -2.0f), glm::vec3(1.0f, 1.0f, 2.0f))), "BOX_AT_EYE_HIDDEN");
+	check(culler.TestBox(AABB(glm::vec3(-1.0f, 200.0f, -30.0f), glm::vec3(1.0f, 202.0f, -20.0f))), "BOX_OFF_SCREEN_HIDDEN");
+
+	// Seen from behind the wall is back facing and skipped
+	culler.BeginFrame(projection * glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	culler.AddOccluder(wall, wallIndices, 6, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 20.0f)));
+	check(culler.GetTriangleCount() == 0, "BACK_FACE_KEPT");
+
+	std::vector<AABB> boxes = {
+		AABB(glm::vec3(-1.0f, -1.0f, -30.0f), glm::vec3(1.0f, 1.0f, -20.0f)),
+		AABB(glm::vec3(-1.0f, -1.0f, -8.0f), glm::vec3(1.0f, 1.0f, -6.0f))
+	};
+	std::vector<unsigned int> indices = { 0, 1 };
+	culler.BeginFrame(projection);
+	culler.AddOccluder(wall, wallIndices, 6, glm::mat4(1.0f));
+	culler.Rasterize();
+	check(culler.Cull(boxes, indices) == 1 && indices[0] == 1, "CULL_LIST");
+	return failures;
+}
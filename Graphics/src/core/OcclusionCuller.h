@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+#include "Bounds.h"
+
+// CPU occlusion culling. A few large occluder meshes are rasterized into a small depth
+// buffer, split into horizontal bands rasterized as separate jobs, and reduced to
+// the farthest depth per 8x8 tile. Object boxes are then tested against the tiles and,
+// where a tile is not conclusive, against its pixels. Runs entirely without GL.
+//
+// Depth is window depth in [0, 1], 1 is the far plane. Results are conservative apart
+// from sub-pixel occluder edges; occluder triangles crossing the near plane are skipped.
+class OcclusionCuller {
+public:
+	enum : int { TILE_SIZE = 8 };
+
+private:
+	struct Triangle {
+		float EdgeA[3], EdgeB[3], EdgeC[3];	// E(x, y) = A x + B y + C, inside when all >= 0
+		float DepthA, DepthB, DepthC;		// z(x, y) = A x + B y + C
+		int MinX, MinY, MaxX, MaxY;			// pixel bounds, inclusive
+	};
+
+	int m_Width;
+	int m_Height;
+	int m_TilesX;
+	int m_TilesY;
+	bool m_BackfaceCulling;
+
+	glm::mat4 m_ViewProjection;
+	std::vector<Triangle> m_Triangles;
+	std::vector<float> m_Depth;
+	std::vector<float> m_TileMaxDepth;
+
+public:
+	// Width is rounded up to a multiple of 4, height to a multiple of TILE_SIZE
+	OcclusionCuller(int width = 256, int height = 128);
+
+	void BeginFrame(const glm::mat4& viewProjection);
+	// Positions are tightly packed xyz, indices describe counter-clockwise triangles
+	void AddOccluder(const float* positions, const unsigned int* indices, size_t indexCount, const glm::mat4& model);
+	void Rasterize();
+
+	// false when the box is certainly hidden behind the occluders. Boxes off screen count as
+	// not occluded, whether they are in view is for frustum culling to decide.
+	bool TestBox(const AABB& box) const;
+	// Keeps only the indices whose box is possibly visible, returns the new count
+	size_t Cull(const std::vector<AABB>& boxes, std::vector<unsigned int>& indices) const;
+
+	inline void SetBackfaceCulling(bool enabled) { m_BackfaceCulling = enabled; }
+	inline size_t GetTriangleCount() const { return m_Triangles.size(); }
+	inline int GetWidth() const { return m_Width; }
+	inline int GetHeight() const { return m_Height; }
+	inline const std::vector<float>& GetDepthBuffer() const { return m_Depth; }
+
+private:
+	void RasterizeBand(int rowBegin, int rowEnd);
+	void UpdateTiles(int rowBegin, int rowEnd);
+};
+
+// Rasterizes a known scene and checks depth values and culling decisions against it without
+// GL, printing every case that fails. Returns the number of failures. Needs the job system.
+unsigned int RunOcclusionTest();
@@ -0,0 +1,229 @@
+#include "OcclusionQueries.h"
+#include "PipelineStatistics.h"
+#include "Shader.h"
+#include "VertexArray.h"
+
+OcclusionQueries::OcclusionQueries() :
+	m_BoundsShader(new Shader("res/shaders/vertex_bounds.shader", "res/shaders/fragment_bounds.shader")),
+	m_Frame(0),
+	m_RetestInterval(4),
+	m_Statistics(nullptr)
+{
+	const float corners[] = {
+		0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 1.0f,  1.0f, 0.0f, 1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 1.0f
+	};
+	const unsigned int indices[] = {
+		0, 2, 1,  0, 3, 2,	// back
+		4, 5, 6,  4, 6, 7,	// front
+		0, 4, 7,  0, 7, 3,	// left
+		1, 2, 6,  1, 6, 5,	// right
+		0, 1, 5,  0, 5, 4,	// bottom
+		3, 7, 6,  3, 6, 2	// top
+	};
+
+	glGenVertexArrays(1, &m_CubeVAO);
+	glGenBuffers(1, &m_CubeVBO);
+	glGenBuffers(1, &m_CubeEBO);
+	glBindVertexArray(m_CubeVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_CubeVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_CubeEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+}
+
+OcclusionQueries::~OcclusionQueries() {
+	for (size_t i = 0; i < m_Pending.size(); i++) {
+		if (i == 0 || m_Pending[i].Query != m_Pending[i - 1].Query) glDeleteQueries(1, &m_Pending[i].Query);
+	}
+	if (!m_FreeQueries.empty()) glDeleteQueries(static_cast<GLsizei>(m_FreeQueries.size()), m_FreeQueries.data());
+	glDeleteVertexArrays(1, &m_CubeVAO);
+	glDeleteBuffers(1, &m_CubeVBO);
+	glDeleteBuffers(1, &m_CubeEBO);
+}
+
+void OcclusionQueries::Draw(const std::vector<unsigned int>& objects, const std::vector<AABB>& bounds,
+							const glm::vec3& eye, const glm::mat4& viewProjection,
+							const Shader& shader, const VertexArray& vertexArray,
+							const std::function<void(unsigned int)>& draw, RenderStats& stats) {
+	m_Frame++;
+	if (m_Objects.size() < bounds.size()) {
+		// Stagger the first re-tests so they do not all land on the same frame
+		for (size_t id = m_Objects.size(); id < bounds.size(); id++) {
+			ObjectState object;
+			object.LastTested = static_cast<unsigned int>(id % m_RetestInterval);
+			m_Objects.push_back(object);
+		}
+	}
+	Poll();
+
+	stats.Objects += static_cast<unsigned int>(objects.size());
+	m_Retests.clear();
+	m_Suspects.clear();
+	m_Hidden.clear();
+
+	// Previously visible objects, drawn as is and re-queried now and then
+	shader.Bind();
+	vertexArray.Bind();
+	for (unsigned int id : objects) {
+		ObjectState& object = m_Objects[id];
+		// A box the camera is inside of rasterizes nothing in front of the near plane
+		if (bounds[id].DistanceSquared(eye) == 0.0f) {
+			object.Visible = true;
+			object.HiddenTests = 0;
+		}
+
+		if (!object.Visible) {
+			if (object.HiddenTests >= STABLE_HIDDEN_TESTS) {
+				m_Hidden.push_back(id);
+				stats.OcclusionCulled++;
+			}
+			else {
+				m_Suspects.push_back(id);
+			}
+			continue;
+		}
+
+		if (object.Query == 0 && m_Frame >= object.LastTested + m_RetestInterval) {
+			m_Retests.push_back(id);
+			continue;
+		}
+		draw(id);
+		stats.DrawCalls++;
+	}
+	if (m_Retests.empty() && m_Suspects.empty() && m_Hidden.empty()) return;
+
+	// Queries from here on, until the conditional draws
+	if (m_Statistics) m_Statistics->Suspend();
+	for (unsigned int id : m_Retests) {
+		ObjectState& object = m_Objects[id];
+		object.Query = AcquireQuery();
+		object.LastTested = m_Frame;
+		m_Pending.push_back(PendingQuery{ object.Query, id });
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, object.Query);
+		draw(id);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		stats.DrawCalls++;
+		stats.OcclusionQueries++;
+	}
+	if (m_Suspects.empty() && m_Hidden.empty()) {
+		if (m_Statistics) m_Statistics->Resume();
+		return;
+	}
+
+	// Bounding box queries, no color or depth writes
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	m_BoundsShader->Bind();
+	m_BoundsShader->SetUniformMat4("viewProjection", viewProjection);
+	glBindVertexArray(m_CubeVAO);
+	for (unsigned int id : m_Suspects) {
+		ObjectState& object = m_Objects[id];
+		if (object.Query) continue;
+		object.Query = AcquireQuery();
+		object.LastTested = m_Frame;
+		m_Pending.push_back(PendingQuery{ object.Query, id });
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, object.Query);
+		DrawBox(bounds[id]);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		stats.OcclusionQueries++;
+	}
+	// Objects likely to stay hidden share a query, one result clears the whole group
+	for (size_t i = 0; i < m_Hidden.size();) {
+		const unsigned int query = AcquireQuery();
+		unsigned int members = 0;
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, query);
+		for (; i < m_Hidden.size() && members < MULTI_QUERY_SIZE; i++) {
+			ObjectState& object = m_Objects[m_Hidden[i]];
+			if (object.Query) continue;
+			object.Query = query;
+			object.LastTested = m_Frame;
+			m_Pending.push_back(PendingQuery{ query, m_Hidden[i] });
+			DrawBox(bounds[m_Hidden[i]]);
+			members++;
+		}
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		if (members == 0) {
+			ReleaseQuery(query);
+			continue;
+		}
+		stats.OcclusionQueries++;
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_TRUE);
+	if (m_Statistics) m_Statistics->Resume();
+	if (m_Suspects.empty()) return;
+
+	// Conservative pass: objects that just became visible again show up this frame instead of next
+	shader.Bind();
+	vertexArray.Bind();
+	for (unsigned int id : m_Suspects) {
+		glBeginConditionalRender(m_Objects[id].Query, GL_QUERY_NO_WAIT);
+		draw(id);
+		glEndConditionalRender();
+		stats.DrawCalls++;
+		stats.ConditionalDraws++;
+	}
+}
+
+void OcclusionQueries::DrawBox(const AABB& bounds) {
+	m_BoundsShader->SetUniform3f("boundsMin", bounds.Min);
+	m_BoundsShader->SetUniform3f("boundsMax", bounds.Max);
+	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr);
+}
+
+void OcclusionQueries::Poll() {
+	size_t kept = 0;
+	for (size_t i = 0; i < m_Pending.size();) {
+		const unsigned int query = m_Pending[i].Query;
+		size_t end = i + 1;
+		while (end < m_Pending.size() && m_Pending[end].Query == query) end++;
+
+		GLuint available = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			for (; i < end; i++) m_Pending[kept++] = m_Pending[i];
+			continue;
+		}
+
+		GLuint passed = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT, &passed);
+		const bool group = end - i > 1;
+		for (; i < end; i++) {
+			ObjectState& object = m_Objects[m_Pending[i].Object];
+			object.Query = 0;
+			if (!passed) {
+				object.Visible = false;
+				if (object.HiddenTests < STABLE_HIDDEN_TESTS) object.HiddenTests++;
+			}
+			else if (group) {
+				// At least one member shows, find out which by testing them one by one
+				object.HiddenTests = 0;
+			}
+			else {
+				object.Visible = true;
+				object.HiddenTests = 0;
+			}
+		}
+		ReleaseQuery(query);
+	}
+	m_Pending.resize(kept);
+}
+
+unsigned int OcclusionQueries::AcquireQuery() {
+	if (m_FreeQueries.empty()) {
+		unsigned int query;
+		glGenQueries(1, &query);
+		return query;
+	}
+	unsigned int query = m_FreeQueries.back();
+	m_FreeQueries.pop_back();
+	return query;
+}
+
+void OcclusionQueries::ReleaseQuery(unsigned int query) {
+	m_FreeQueries.push_back(query);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "glad/glad.h"
+#include "glm.hpp"
+#include "Bounds.h"
+
+class Shader;
+class VertexArray;
+class PipelineStatistics;
+
+struct RenderStats {
+	unsigned int DrawCalls = 0;
+	unsigned int Objects = 0;				// objects handed to occlusion culled drawing
+	unsigned int OcclusionCulled = 0;		// draws skipped, the object has stayed hidden for a while
+	unsigned int OcclusionQueries = 0;		// queries issued this frame, a multi-query counts once
+	unsigned int ConditionalDraws = 0;		// draws of objects only just found hidden, left to the GPU to skip
+};
+
+// Hardware occlusion culling with temporal coherence and the multi-queries of CHC++, without
+// its hierarchy: objects are tested one by one or in groups, never through inner nodes of a
+// spatial tree. Results are only read once the GPU reports them available, so visibility lags
+// a frame or two behind and the pipeline never waits on a query:
+//  - objects visible last time are drawn, and re-queried every few frames by wrapping
+//    their own draw in a query, so checking them costs nothing extra. Those draws come
+//    after the other visible objects, which then all occlude them;
+//  - objects only just found hidden get their bounding box queried, then are drawn under
+//    glBeginConditionalRender, which the GPU skips if the box was hidden and draws anyway
+//    if the result is not there yet;
+//  - objects hidden in several results in a row are not drawn at all. Their boxes share one
+//    query per group; when a group turns out visible its members go back to being tested
+//    one by one, so such an object shows up two or three frames after it comes into view.
+class OcclusionQueries {
+public:
+	enum : unsigned int { MULTI_QUERY_SIZE = 8, STABLE_HIDDEN_TESTS = 2 };
+
+private:
+	struct ObjectState {
+		unsigned int Query = 0;			// in flight, 0 when none; shared by the members of a multi-query
+		bool Visible = true;
+		unsigned int HiddenTests = 0;	// hidden results in a row, up to STABLE_HIDDEN_TESTS
+		unsigned int LastTested = 0;	// frame the latest query was issued
+	};
+
+	struct PendingQuery {
+		unsigned int Query;
+		unsigned int Object;			// one entry per object, those of a multi-query are adjacent
+	};
+
+	std::vector<ObjectState> m_Objects;
+	std::vector<PendingQuery> m_Pending;
+	std::vector<unsigned int> m_FreeQueries;
+	std::vector<unsigned int> m_Retests;	// scratch: visible, drawn inside a query
+	std::vector<unsigned int> m_Suspects;	// scratch: only just found hidden
+	std::vector<unsigned int> m_Hidden;		// scratch: hidden for a while
+	std::unique_ptr<Shader> m_BoundsShader;
+	unsigned int m_CubeVAO;
+	unsigned int m_CubeVBO;
+	unsigned int m_CubeEBO;
+	unsigned int m_Frame;
+	unsigned int m_RetestInterval;
+	PipelineStatistics* m_Statistics;
+
+public:
+	OcclusionQueries();
+	~OcclusionQueries();
+
+	// objects: ids to draw, ideally front to back; bounds are indexed by id.
+	// draw(id) issues the object's draw calls with shader and vertexArray bound.
+	void Draw(const std::vector<unsigned int>& objects, const std::vector<AABB>& bounds,
+			  const glm::vec3& eye, const glm::mat4& viewProjection,
+			  const Shader& shader, const VertexArray& vertexArray,
+			  const std::function<void(unsigned int)>& draw, RenderStats& stats);
+
+	// How many frames a visible object stays untested
+	inline void SetRetestInterval(unsigned int frames) { m_RetestInterval = frames ? frames : 1; }
+	// Suspended while queries run, GL allows no samples passed query next to them; may be null
+	inline void SetStatistics(PipelineStatistics* statistics) { m_Statistics = statistics; }
+
+private:
+	// Reads the results that are available, only outstanding queries are looked at
+	void Poll();
+	void DrawBox(const AABB& bounds);
+	unsigned int AcquireQuery();
+	void ReleaseQuery(unsigned int query);
+};
@@ -0,0 +1,219 @@
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "glad/glad.h"
+
+#include "PipelineStatistics.h"
+
+namespace {
+	const GLenum COUNTER_TARGETS[COUNTER_COUNT] = {
+		GL_VERTEX_SHADER_INVOCATIONS,
+		GL_FRAGMENT_SHADER_INVOCATIONS,
+		GL_CLIPPING_INPUT_PRIMITIVES,
+		GL_CLIPPING_OUTPUT_PRIMITIVES,
+		GL_SAMPLES_PASSED
+	};
+
+	// The ARB extension uses the same tokens as GL 4.6 and runs on many 3.3 and 4.x drivers
+	bool HasExtension(const char* name) {
+		if (!GLAD_GL_VERSION_3_0 || !glGetStringi) return false;
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension && std::strcmp(extension, name) == 0) return true;
+		}
+		return false;
+	}
+}
+
+PipelineStatistics::PipelineStatistics() :
+	m_PipelineQueries(GLAD_GL_VERSION_4_6 || HasExtension("GL_ARB_pipeline_statistics_query")),
+	m_SampleQueries(GLAD_GL_VERSION_1_5 != 0),
+	m_Current(nullptr),
+	m_FrameNumber(0),
+	m_Active(false),
+	m_Suspended(false),
+	m_DroppedFrames(0)
+{
+	if (!m_PipelineQueries) {
+		std::cout << "Warning: pipeline statistics queries need GL 4.6 or ARB_pipeline_statistics_query, counting samples passed only" << std::endl;
+	}
+	if (!m_SampleQueries) return;
+
+	for (Frame& frame : m_Frames) {
+		frame.Passes.reserve(MAX_PASSES);
+		frame.Segments.reserve(MAX_PASSES);
+		frame.Queries.resize(COUNTER_COUNT * MAX_SEGMENTS * MAX_PASSES);
+		glGenQueries(static_cast<GLsizei>(frame.Queries.size()), frame.Queries.data());
+		frame.Pending = false;
+		frame.Number = 0;
+	}
+	m_LastFrame.reserve(MAX_PASSES);
+}
+
+PipelineStatistics::~PipelineStatistics() {
+	if (!m_SampleQueries) return;
+	for (Frame& frame : m_Frames) glDeleteQueries(static_cast<GLsizei>(frame.Queries.size()), frame.Queries.data());
+}
+
+void PipelineStatistics::BeginFrame() {
+	if (!m_SampleQueries) return;
+
+	if (m_Current) {
+		if (m_Active) End();
+		m_Current->Pending = !m_Current->Passes.empty();
+	}
+	Collect();
+
+	Frame& frame = m_Frames[m_FrameNumber % FRAME_COUNT];
+	if (frame.Pending) {
+		// Still not there after FRAME_COUNT frames, drop it rather than wait
+		frame.Pending = false;
+		m_DroppedFrames++;
+	}
+	frame.Passes.clear();
+	frame.Segments.clear();
+	frame.Number = m_FrameNumber++;
+	m_Current = &frame;
+}
+
+void PipelineStatistics::Begin(const char* name, bool samples) {
+	if (!m_SampleQueries || !m_Current || m_Active) return;
+	if (m_Current->Passes.size() == MAX_PASSES) return;
+
+	PassStatistics pass = {};
+	pass.Name = name;
+	for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+		pass.Measured[counter] = counter == COUNTER_SAMPLES_PASSED ? samples : m_PipelineQueries;
+	}
+	if (!m_PipelineQueries && !samples) return;
+
+	m_Current->Passes.push_back(pass);
+	m_Current->Segments.push_back(0);
+	m_Active = true;
+	m_Suspended = false;
+	BeginSegment();
+}
+
+void PipelineStatistics::End() {
+	if (!m_Active) return;
+	if (!m_Suspended) EndSegment();
+	m_Active = false;
+	m_Suspended = false;
+}
+
+void PipelineStatistics::Suspend() {
+	if (!m_Active || m_Suspended) return;
+	EndSegment();
+	m_Suspended = true;
+}
+
+void PipelineStatistics::Resume() {
+	if (!m_Active || !m_Suspended) return;
+	if (m_Current->Segments.back() == MAX_SEGMENTS) return;
+	m_Suspended = false;
+	BeginSegment();
+}
+
+void PipelineStatistics::BeginSegment() {
+	const size_t pass = m_Current->Passes.size() - 1;
+	const unsigned int* queries = &m_Current->Queries[COUNTER_COUNT * (MAX_SEGMENTS * pass + m_Current->Segments[pass])];
+	for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+		if (m_Current->Passes[pass].Measured[counter]) glBeginQuery(COUNTER_TARGETS[counter], queries[counter]);
+	}
+	m_Current->Segments[pass]++;
+}
+
+void PipelineStatistics::EndSegment() {
+	const PassStatistics& pass = m_Current->Passes.back();
+	for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+		if (pass.Measured[counter]) glEndQuery(COUNTER_TARGETS[counter]);
+	}
+}
+
+void PipelineStatistics::Collect() {
+	for (;;) {
+		Frame* oldest = nullptr;
+		for (Frame& frame : m_Frames) {
+			if (frame.Pending && (!oldest || frame.Number < oldest->Number)) oldest = &frame;
+		}
+		if (!oldest || !IsAvailable(*oldest)) return;
+		Read(*oldest);
+		oldest->Pending = false;
+	}
+}
+
+bool PipelineStatistics::IsAvailable(const Frame& frame) const {
+	// Different query targets need not finish in order, so every one is asked
+	for (size_t i = 0; i < frame.Passes.size(); i++) {
+		for (unsigned int segment = 0; segment < frame.Segments[i]; segment++) {
+			const unsigned int* queries = &frame.Queries[COUNTER_COUNT * (MAX_SEGMENTS * i + segment)];
+			for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+				if (!frame.Passes[i].Measured[counter]) continue;
+				GLint available = 0;
+				glGetQueryObjectiv(queries[counter], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available) return false;
+			}
+		}
+	}
+	return true;
+}
+
+void PipelineStatistics::Read(Frame& frame) {
+	m_LastFrame.clear();
+	for (size_t i = 0; i < frame.Passes.size(); i++) {
+		PassStatistics& pass = frame.Passes[i];
+		for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) pass.Counters[counter] = 0;
+		for (unsigned int segment = 0; segment < frame.Segments[i]; segment++) {
+			const unsigned int* queries = &frame.Queries[COUNTER_COUNT * (MAX_SEGMENTS * i + segment)];
+			for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+				GLuint64 value = 0;
+				if (pass.Measured[counter]) glGetQueryObjectui64v(queries[counter], GL_QUERY_RESULT, &value);
+				pass.Counters[counter] += value;
+			}
+		}
+		m_LastFrame.push_back(pass);
+		Accumulate(pass);
+	}
+}
+
+void PipelineStatistics::Accumulate(const PassStatistics& pass) {
+	Totals* totals = nullptr;
+	for (Totals& entry : m_Totals) {
+		if (std::strcmp(entry.Name, pass.Name) == 0) totals = &entry;
+	}
+	if (!totals) {
+		m_Totals.push_back(Totals{ pass.Name, {}, {}, 0 });
+		totals = &m_Totals.back();
+	}
+	for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+		totals->Counters[counter] += pass.Counters[counter];
+		totals->Measured[counter] = totals->Measured[counter] || pass.Measured[counter];
+	}
+	totals->Frames++;
+}
+
+void PipelineStatistics::PrintAverages() const {
+	if (m_Totals.empty()) return;
+
+	const char* headers[COUNTER_COUNT] = { "vertices", "fragments", "clip in", "clip out", "samples" };
+	std::cout << std::left << std::setw(24) << "Pass (per frame)" << std::right;
+	for (const char* header : headers) std::cout << std::setw(14) << header;
+	std::cout << std::setw(14) << "frag/sample" << std::endl;
+
+	for (const Totals& totals : m_Totals) {
+		std::cout << std::left << std::setw(24) << totals.Name << std::right;
+		for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+			if (totals.Measured[counter]) std::cout << std::setw(14) << totals.Counters[counter] / totals.Frames;
+			else std::cout << std::setw(14) << "-";
+		}
+		// Fragments shaded per sample that survived the depth test, overdraw shows up above 1
+		const bool ratio = totals.Measured[COUNTER_FRAGMENT_INVOCATIONS] && totals.Measured[COUNTER_SAMPLES_PASSED] && totals.Counters[COUNTER_SAMPLES_PASSED] > 0;
+		if (ratio) std::cout << std::setw(14) << std::fixed << std::setprecision(2) << static_cast<double>(totals.Counters[COUNTER_FRAGMENT_INVOCATIONS]) / totals.Counters[COUNTER_SAMPLES_PASSED] << std::defaultfloat;
+		else std::cout << std::setw(14) << "-";
+		std::cout << std::endl;
+	}
+	if (m_DroppedFrames) std::cout << m_DroppedFrames << " frames dropped waiting for results" << std::endl;
+}
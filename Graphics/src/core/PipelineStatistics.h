@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Profiler.h"
+
+#if PROFILING
+	// Counts what the GPU does for the rest of the enclosing block, render thread only.
+	// Optional third argument: false leaves out samples passed.
+	#define PIPELINE_STATISTICS_SCOPE(statistics, ...) PipelineStatisticsScope PROFILE_CONCAT(pipelineStatisticsScope, __LINE__)(statistics, __VA_ARGS__)
+#else
+	#define PIPELINE_STATISTICS_SCOPE(statistics, ...) ((void)0)
+#endif
+
+enum pipeline_counter {
+	COUNTER_VERTEX_INVOCATIONS,
+	COUNTER_FRAGMENT_INVOCATIONS,
+	COUNTER_CLIPPING_INPUT,		// primitives reaching the clipper
+	COUNTER_CLIPPING_OUTPUT,	// primitives leaving it, fewer when some were clipped away
+	COUNTER_SAMPLES_PASSED,
+	COUNTER_COUNT
+};
+
+struct PassStatistics {
+	const char* Name;
+	uint64_t Counters[COUNTER_COUNT];
+	bool Measured[COUNTER_COUNT];
+};
+
+// Per pass GPU counters: shader invocations and clipping from pipeline statistics queries
+// (GL 4.6 or ARB_pipeline_statistics_query), samples passed from an occlusion query.
+// Without either only samples passed are counted. High vertex counts against few fragments
+// point at a vertex bound pass, fragment invocations well above samples passed at overdraw.
+// Queries come from a ring of frames and are read once available, like GpuProfiler, so
+// nothing waits on the GPU.
+//
+// Passes do not nest: a query target can only be active once. GL also allows only one
+// occlusion query at a time, so code running its own calls Suspend before and Resume after;
+// every counter pauses, so the pass still describes one set of draws. A pass resumes at most
+// MAX_SEGMENTS - 1 times, later draws go uncounted.
+class PipelineStatistics {
+public:
+	enum : unsigned int { FRAME_COUNT = 4, MAX_PASSES = 16, MAX_SEGMENTS = 4 };
+
+private:
+	struct Frame {
+		std::vector<PassStatistics> Passes;		// names and what was measured, counters filled on read
+		std::vector<unsigned int> Queries;		// COUNTER_COUNT per segment, MAX_SEGMENTS per pass
+		std::vector<unsigned int> Segments;		// per pass
+		bool Pending;
+		uint64_t Number;
+	};
+
+	struct Totals {
+		const char* Name;
+		uint64_t Counters[COUNTER_COUNT];
+		bool Measured[COUNTER_COUNT];
+		uint64_t Frames;
+	};
+
+	bool m_PipelineQueries;
+	bool m_SampleQueries;
+	Frame m_Frames[FRAME_COUNT];
+	Frame* m_Current;
+	uint64_t m_FrameNumber;
+	bool m_Active;
+	bool m_Suspended;
+	std::vector<PassStatistics> m_LastFrame;
+	std::vector<Totals> m_Totals;
+	size_t m_DroppedFrames;
+
+public:
+	PipelineStatistics();
+	~PipelineStatistics();
+	PipelineStatistics(const PipelineStatistics&) = delete;
+	PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+	// Call once per frame before any pass: collects finished frames and starts a new one
+	void BeginFrame();
+	void Begin(const char* name, bool samples = true);
+	void End();
+	// Pause and continue the counters of the open pass, around occlusion queries of other code
+	void Suspend();
+	void Resume();
+
+	inline bool HasPipelineQueries() const { return m_PipelineQueries; }
+	// Most recent frame with results
+	inline const std::vector<PassStatistics>& GetLastFrame() const { return m_LastFrame; }
+	inline size_t GetDroppedFrames() const { return m_DroppedFrames; }
+	// Per pass averages over every frame read so far
+	void PrintAverages() const;
+
+private:
+	void BeginSegment();
+	void EndSegment();
+	void Collect();
+	bool IsAvailable(const Frame& frame) const;
+	void Read(Frame& frame);
+	void Accumulate(const PassStatistics& pass);
+};
+
+class PipelineStatisticsScope {
+private:
+	PipelineStatistics& m_Statistics;
+
+public:
+	PipelineStatisticsScope(PipelineStatistics& statistics, const char* name, bool samples = true) : m_Statistics(statistics) { m_Statistics.Begin(name, samples); }
+	~PipelineStatisticsScope() { m_Statistics.End(); }
+	PipelineStatisticsScope(const PipelineStatisticsScope&) = delete;
+	PipelineStatisticsScope& operator=(const PipelineStatisticsScope&) = delete;
+};
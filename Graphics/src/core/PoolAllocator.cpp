@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+#include "PoolAllocator.h"
+#include "JobSystem.h"
+
+PoolAllocator::PoolAllocator(size_t blockSize, size_t alignment) :
+	m_Alignment(std::max(alignment, alignof(FreeBlock))),
+	m_FreeList(nullptr),
+	m_Live(0),
+	m_Peak(0)
+{
+	// Every block must hold the free list link and keep the next block aligned
+	m_BlockSize = std::max(blockSize, sizeof(FreeBlock));
+	m_BlockSize = (m_BlockSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+	m_BlocksPerPage = std::max<size_t>(1, PAGE_SIZE / m_BlockSize);
+	m_Lock.clear();
+}
+
+PoolAllocator::~PoolAllocator() {
+	for (char* page : m_Pages) ::operator delete(page);
+}
+
+void* PoolAllocator::Allocate() {
+	while (m_Lock.test_and_set(std::memory_order_acquire)) {}
+	if (!m_FreeList) AddPage();
+	FreeBlock* block = m_FreeList;
+	m_FreeList = block->Next;
+	m_Live++;
+	m_Peak = std::max(m_Peak, m_Live);
+	m_Lock.clear(std::memory_order_release);
+	return block;
+}
+
+void PoolAllocator::Free(void* pointer) {
+	if (!pointer) return;
+#if MEMORY_POISON
+	std::memset(pointer, MEMORY_POISON_BYTE, m_BlockSize);
+#endif
+	FreeBlock* block = static_cast<FreeBlock*>(pointer);
+	while (m_Lock.test_and_set(std::memory_order_acquire)) {}
+	block->Next = m_FreeList;
+	m_FreeList = block;
+	m_Live--;
+	m_Lock.clear(std::memory_order_release);
+}
+
+PoolStats PoolAllocator::GetStats() {
+	while (m_Lock.test_and_set(std::memory_order_acquire)) {}
+	PoolStats stats = { m_BlockSize, m_Live, m_Peak, m_Pages.size() * m_BlocksPerPage, m_Pages.size() };
+	m_Lock.clear(std::memory_order_release);
+	return stats;
+}
+
+void PoolAllocator::AddPage() {
+	// operator new only promises alignment for fundamental types, pad for the rest
+	const size_t padding = m_Alignment > alignof(std::max_align_t) ? m_Alignment : 0;
+	char* page = static_cast<char*>(::operator new(m_BlocksPerPage * m_BlockSize + padding));
+	m_Pages.push_back(page);
+	char* first = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(page) + m_Alignment - 1) & ~(m_Alignment - 1));
+
+	// Thread the new blocks onto the free list in address order
+	for (size_t i = m_BlocksPerPage; i-- > 0;) {
+		FreeBlock* block = reinterpret_cast<FreeBlock*>(first + i * m_BlockSize);
+		block->Next = m_FreeList;
+		m_FreeList = block;
+	}
+}
+
+namespace {
+	struct alignas(32) PoolTestObject {
+		uint64_t Values[5];
+	};
+}
+
+unsigned int RunAllocatorTest() {
+	unsigned int failures = 0;
+	auto check = [&failures](bool passed, const char* what, size_t value) {
+		if (passed) return;
+		std::cout << "ERROR::ALLOCATOR_TEST::" << what << " " << value << std::endl;
+		failures++;
+	};
+
+	// Pool: a second round of the same size reuses the freed blocks, no page is added
+	{
+		Pool<PoolTestObject> pool;
+		const size_t count = 5000;
+		std::vector<PoolTestObject*> objects(count);
+		std::unordered_set<const void*> first;
+		for (size_t i = 0; i < count; i++) {
+			objects[i] = pool.New();
+			objects[i]->Values[0] = i;
+			first.insert(objects[i]);
+			check(reinterpret_cast<uintptr_t>(objects[i]) % alignof(PoolTestObject) == 0, "POOL_MISALIGNED", i);
+		}
+		check(first.size() == count, "POOL_BLOCK_HANDED_OUT_TWICE", first.size());
+		for (size_t i = 0; i < count; i++) check(objects[i]->Values[0] == i, "POOL_BLOCKS_OVERLAP", i);
+		const PoolStats full = pool.GetStats();
+		check(full.Live == count && full.Peak == count && full.Capacity >= count, "POOL_STATS", full.Live);
+
+		for (size_t i = 0; i < count; i += 2) pool.Delete(objects[i]);
+#if MEMORY_POISON
+		// The first bytes hold the free list link, the rest of a freed block is poisoned
+		const unsigned char* freed = reinterpret_cast<const unsigned char*>(objects[0]) + sizeof(void*);
+		check(freed[0] == MEMORY_POISON_BYTE && freed[sizeof(PoolTestObject) - sizeof(void*) - 1] == MEMORY_POISON_BYTE, "POOL_NOT_POISONED", 0);
+#endif
+		for (size_t i = 0; i < count; i += 2) {
+			objects[i] = pool.New();
+			check(first.count(objects[i]) == 1, "POOL_BLOCK_NOT_REUSED", i);
+		}
+		const PoolStats reused = pool.GetStats();
+		check(reused.Pages == full.Pages && reused.Live == count && reused.Peak == count, "POOL_GREW", reused.Pages);
+		for (PoolTestObject* object : objects) pool.Delete(object);
+		check(pool.GetStats().Live == 0, "POOL_LIVE_AFTER_DELETE", pool.GetStats().Live);
+
+		// Any thread may allocate and free
+		JobSystem::Get().ParallelFor(0, 64 * 1024, [&pool](size_t begin, size_t end) {
+			std::vector<PoolTestObject*> held;
+			for (size_t i = begin; i < end; i++) {
+				held.push_back(pool.New());
+				if (held.size() == 16) {
+					for (PoolTestObject* object : held) pool.Delete(object);
+					held.clear();
+				}
+			}
+			for (PoolTestObject* object : held) pool.Delete(object);
+		}, 1024);
+		check(pool.GetStats().Live == 0, "POOL_LIVE_AFTER_JOBS", pool.GetStats().Live);
+	}
+
+	// Scratch: closing a scope hands everything inside back, nested scopes only their own part
+	{
+		ScratchAllocator& scratch = ScratchAllocator::Get();
+		const size_t before = scratch.GetUsed();
+		void* outerFirst = nullptr;
+		{
+			ScratchScope outer;
+			check(&outer.GetAllocator() == &scratch, "SCRATCH_NOT_THREAD_ALLOCATOR", 0);
+			outerFirst = scratch.Allocate(100, 16);
+			const size_t afterOuter = scratch.GetUsed();
+			{
+				ScratchScope inner;
+				scratch.Allocate<float>(1001);
+				check(reinterpret_cast<uintptr_t>(scratch.Allocate(8, 64)) % 64 == 0, "SCRATCH_MISALIGNED", 64);
+				// Past the capacity goes to the heap, and back on rewind
+				check(scratch.Allocate(ScratchAllocator::CAPACITY, 16) != nullptr, "SCRATCH_OVERFLOW_FAILED", 0);
+				check(scratch.GetUsed() > afterOuter, "SCRATCH_NOT_USED", scratch.GetUsed());
+			}
+			check(scratch.GetUsed() == afterOuter, "SCRATCH_INNER_NOT_REWOUND", scratch.GetUsed());
+		}
+		check(scratch.GetUsed() == before, "SCRATCH_OUTER_NOT_REWOUND", scratch.GetUsed());
+		{
+			ScratchScope again;
+			check(scratch.Allocate(100, 16) == outerFirst, "SCRATCH_MEMORY_NOT_REUSED", 0);
+		}
+	}
+
+	// ArenaAllocator: a container living one frame takes its memory from the arena
+	{
+		FrameArena arena(1024 * 1024);
+		{
+			std::vector<unsigned int, ArenaAllocator<unsigned int>> values{ ArenaAllocator<unsigned int>(arena) };
+			for (unsigned int i = 0; i < 10000; i++) values.push_back(i);
+			bool intact = true;
+			for (unsigned int i = 0; i < 10000; i++) intact = intact && values[i] == i;
+			check(intact, "ARENA_CONTAINER_CORRUPT", 0);
+		}
+		const ArenaStats stats = arena.GetStats();
+		check(stats.Allocations > 0 && stats.Used >= 10000 * sizeof(unsigned int) && stats.Overflows == 0, "ARENA_NOT_USED", stats.Used);
+		arena.Reset();
+		check(arena.GetStats().Used == 0, "ARENA_NOT_RESET", arena.GetStats().Used);
+	}
+	return failures;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "FrameArena.h"
+
+struct PoolStats {
+	size_t BlockSize;
+	size_t Live;		// blocks handed out and not freed
+	size_t Peak;		// most blocks live at once
+	size_t Capacity;	// blocks in all pages
+	size_t Pages;
+};
+
+// Equal sized blocks carved from pages, for small objects that live longer than a frame.
+// Freed blocks go on a free list and are handed out again first, pages are only given back
+// with the pool. Safe to use from any thread, a spinlock guards the free list.
+class PoolAllocator {
+public:
+	enum : size_t { PAGE_SIZE = 64 * 1024 };
+
+private:
+	struct FreeBlock {
+		FreeBlock* Next;
+	};
+
+	size_t m_BlockSize;
+	size_t m_Alignment;
+	size_t m_BlocksPerPage;
+	std::vector<char*> m_Pages;
+	FreeBlock* m_FreeList;
+	std::atomic_flag m_Lock;
+	size_t m_Live;
+	size_t m_Peak;
+
+public:
+	PoolAllocator(size_t blockSize, size_t alignment = 16);
+	~PoolAllocator();
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	void* Allocate();
+	void Free(void* block);
+
+	PoolStats GetStats();
+	inline size_t GetBlockSize() const { return m_BlockSize; }
+
+private:
+	void AddPage();
+};
+
+// Typed pool, New and Delete construct and destroy in place
+template<typename T>
+class Pool {
+private:
+	PoolAllocator m_Allocator;
+
+public:
+	Pool() : m_Allocator(sizeof(T), alignof(T)) {}
+
+	template<typename... Args>
+	T* New(Args&&... args) {
+		return new (m_Allocator.Allocate()) T(std::forward<Args>(args)...);
+	}
+
+	void Delete(T* object) {
+		if (!object) return;
+		object->~T();
+		m_Allocator.Free(object);
+	}
+
+	inline PoolStats GetStats() { return m_Allocator.GetStats(); }
+};
+
+// Checks that a pool hands freed blocks out again before adding pages, keeps blocks aligned
+// and counts live blocks under concurrent use, that a ScratchScope rewinds its thread's
+// stack including allocations past its capacity, and that an ArenaAllocator backed container
+// draws from its arena. Needs the job system. Returns the number of failures.
+unsigned int RunAllocatorTest();
@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include "Profiler.h"
+#include "JobSystem.h"
+
+namespace {
+	thread_local Profiler::Track* t_Track = nullptr;
+
+	double Percentile(const std::vector<uint64_t>& sorted, double fraction) {
+		return static_cast<double>(sorted[static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5)]);
+	}
+
+	// Streams text as the inside of a JSON string, names come from callers and may hold anything
+	struct Escaped {
+		const char* Text;
+	};
+
+	std::ostream& operator<<(std::ostream& out, const Escaped& escaped) {
+		const char* hex = "0123456789abcdef";
+		for (const char* c = escaped.Text; *c; c++) {
+			const unsigned char code = static_cast<unsigned char>(*c);
+			if (*c == '"' || *c == '\\') out << '\\' << *c;
+			else if (code < 0x20) out << "\\u00" << hex[code >> 4] << hex[code & 15];
+			else out << *c;
+		}
+		return out;
+	}
+}
+
+Profiler& Profiler::Get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+uint64_t Profiler::Now() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Profiler::Track& Profiler::GetThreadTrack() {
+	if (t_Track) return *t_Track;
+
+	const int worker = JobSystem::GetWorkerIndex();
+	std::string name;
+	if (worker == 0) name = "main";
+	else if (worker > 0) name = "worker " + std::to_string(worker);
+	else name = "thread";
+	t_Track = &AddTrack(name);
+	return *t_Track;
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+	Track& track = GetThreadTrack();
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	track.Name = name;
+}
+
+Profiler::Track& Profiler::CreateTrack(const std::string& name) {
+	return AddTrack(name);
+}
+
+Profiler::Track& Profiler::AddTrack(const std::string& name) {
+	std::unique_ptr<Track> track(new Track());
+	track->Name = name;
+	track->Events.reset(new ProfileEvent[RING_SIZE]);
+	track->Written.store(0);
+	track->Depth = 0;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Tracks.push_back(std::move(track));
+	return *m_Tracks.back();
+}
+
+void Profiler::Record(Track& track, const char* name, uint64_t start, uint64_t end, unsigned int depth) {
+	const uint64_t index = track.Written.load(std::memory_order_relaxed);
+	track.Events[index % RING_SIZE] = ProfileEvent{ name, start, end, depth };
+	track.Written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::Collect(const Track& track, std::vector<ProfileEvent>& events) {
+	const uint64_t written = track.Written.load(std::memory_order_acquire);
+	const uint64_t first = written > RING_SIZE ? written - RING_SIZE : 0;
+	const size_t begin = events.size();
+	for (uint64_t i = first; i < written; i++) events.push_back(track.Events[i % RING_SIZE]);
+
+	// The recording thread may have lapped the ring meanwhile; what it wrote over is garbage.
+	// It writes index Written at most, which replaces index Written - RING_SIZE.
+	const uint64_t after = track.Written.load(std::memory_order_acquire);
+	if (after >= first + RING_SIZE) {
+		const size_t stale = static_cast<size_t>(std::min<uint64_t>(after - RING_SIZE + 1 - first, written - first));
+		events.erase(events.begin() + begin, events.begin() + begin + stale);
+	}
+}
+
+bool Profiler::WriteTrace(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::PROFILER::TRACE_NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	std::vector<std::string> names;
+	std::vector<std::vector<ProfileEvent>> events;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const std::unique_ptr<Track>& track : m_Tracks) {
+			names.push_back(track->Name);
+			events.push_back(std::vector<ProfileEvent>());
+			Collect(*track, events.back());
+		}
+	}
+
+	uint64_t origin = UINT64_MAX;
+	for (const std::vector<ProfileEvent>& track : events) {
+		for (const ProfileEvent& event : track) origin = std::min(origin, event.Start);
+	}
+
+	// Microseconds with nanosecond decimals
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (size_t t = 0; t < events.size(); t++) {
+		for (const ProfileEvent& event : events[t]) {
+			file << (first ? "" : ",\n") << "{\"name\":\"" << Escaped{ event.Name } << "\",\"cat\":\"cpu\",\"ph\":\"X\""
+				<< ",\"ts\":" << (event.Start - origin) / 1000.0 << ",\"dur\":" << (event.End - event.Start) / 1000.0
+				<< ",\"pid\":0,\"tid\":" << t << ",\"args\":{\"depth\":" << event.Depth << "}}";
+			first = false;
+		}
+	}
+	for (size_t t = 0; t < names.size(); t++) {
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":\"" << Escaped{ names[t].c_str() } << "\"}}"
+			<< ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"sort_index\":" << t << "}}";
+		first = false;
+	}
+	file << "\n]}\n";
+	return true;
+}
+
+std::vector<ProfileStats> Profiler::GetStats() const {
+	std::map<std::string, std::vector<uint64_t>> durations;
+	{
+		std::vector<ProfileEvent> events;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const std::unique_ptr<Track>& track : m_Tracks) {
+			events.clear();
+			Collect(*track, events);
+			for (const ProfileEvent& event : events) durations[event.Name].push_back(event.End - event.Start);
+		}
+	}
+
+	std::vector<ProfileStats> stats;
+	for (std::pair<const std::string, std::vector<uint64_t>>& scope : durations) {
+		std::vector<uint64_t>& sorted = scope.second;
+		std::sort(sorted.begin(), sorted.end());
+		uint64_t total = 0;
+		for (uint64_t duration : sorted) total += duration;
+
+		ProfileStats entry;
+		entry.Name = scope.first;
+		entry.Count = sorted.size();
+		entry.TotalMilliseconds = total / 1e6;
+		entry.MeanMilliseconds = entry.TotalMilliseconds / sorted.size();
+		entry.P50Milliseconds = Percentile(sorted, 0.50) / 1e6;
+		entry.P99Milliseconds = Percentile(sorted, 0.99) / 1e6;
+		stats.push_back(entry);
+	}
+	std::sort(stats.begin(), stats.end(), [](const ProfileStats& a, const ProfileStats& b) { return a.TotalMilliseconds > b.TotalMilliseconds; });
+	return stats;
+}
+
+void Profiler::PrintStats() const {
+	const std::vector<ProfileStats> stats = GetStats();
+	if (stats.empty()) return;
+
+	std::cout << std::left << std::setw(24) << "Scope" << std::right << std::setw(10) << "count" << std::setw(12) << "mean ms"
+		<< std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms" << std::setw(12) << "total ms" << std::endl;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const ProfileStats& scope : stats) {
+		std::cout << std::left << std::setw(24) << scope.Name << std::right << std::setw(10) << scope.Count
+			<< std::setw(12) << scope.MeanMilliseconds << std::setw(12) << scope.P50Milliseconds
+			<< std::setw(12) << scope.P99Milliseconds << std::setw(12) << scope.TotalMilliseconds << std::endl;
+	}
+	std::cout << std::defaultfloat;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// PROFILE_SCOPE compiles to nothing unless PROFILING is set, which debug builds do by
+// default. Define PROFILING=1 to profile an optimized build.
+#ifndef PROFILING
+	#ifdef _DEBUG
+		#define PROFILING 1
+	#else
+		#define PROFILING 0
+	#endif
+#endif
+
+#if PROFILING
+	#define PROFILE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+	// Times the rest of the enclosing block. name must outlive the profiler, a literal usually.
+	#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+	#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+struct ProfileEvent {
+	const char* Name;
+	uint64_t Start;		// nanoseconds, Profiler::Now
+	uint64_t End;
+	unsigned int Depth;	// nesting level on its track
+};
+
+struct ProfileStats {
+	std::string Name;
+	size_t Count;
+	double TotalMilliseconds;
+	double MeanMilliseconds;
+	double P50Milliseconds;
+	double P99Milliseconds;
+};
+
+// Hierarchical scope timings. Every thread records into a ring of its own without locks;
+// only its first scope registers the ring. Rings keep the most recent RING_SIZE scopes,
+// which are what the Chrome trace and the stats are made from. Reading while threads still
+// record is allowed, events overwritten during the read are dropped.
+class Profiler {
+public:
+	enum : size_t { RING_SIZE = 64 * 1024 };
+
+	// Events of one thread, or of anything else with a timeline of its own
+	struct Track {
+		std::string Name;
+		std::unique_ptr<ProfileEvent[]> Events;
+		std::atomic<uint64_t> Written;		// events ever recorded, the ring holds the last RING_SIZE
+		unsigned int Depth;					// open scopes, thread tracks only
+	};
+
+private:
+	mutable std::mutex m_Mutex;
+	std::vector<std::unique_ptr<Track>> m_Tracks;
+
+public:
+	static Profiler& Get();
+	// Monotonic nanoseconds
+	static uint64_t Now();
+
+	// The calling thread's track, created on first use
+	Track& GetThreadTrack();
+	// Names the calling thread's track in traces; worker threads are named after their index
+	void SetThreadName(const std::string& name);
+	// A track fed by hand, e.g. with timings measured elsewhere
+	Track& CreateTrack(const std::string& name);
+	// Only ever from one thread per track
+	void Record(Track& track, const char* name, uint64_t start, uint64_t end, unsigned int depth);
+
+	// Chrome trace JSON, for chrome://tracing or ui.perfetto.dev
+	bool WriteTrace(const std::string& path) const;
+	// Per scope name over what the rings hold, slowest total first
+	std::vector<ProfileStats> GetStats() const;
+	void PrintStats() const;
+
+private:
+	Profiler() {}
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	Track& AddTrack(const std::string& name);
+	// Copies out what a track holds, oldest first
+	static void Collect(const Track& track, std::vector<ProfileEvent>& events);
+};
+
+class ProfileScope {
+private:
+	Profiler::Track& m_Track;
+	const char* m_Name;
+	uint64_t m_Start;
+
+public:
+	explicit ProfileScope(const char* name) :
+		m_Track(Profiler::Get().GetThreadTrack()),
+		m_Name(name)
+	{
+		m_Track.Depth++;
+		m_Start = Profiler::Now();
+	}
+
+	~ProfileScope() {
+		const uint64_t end = Profiler::Now();
+		m_Track.Depth--;
+		Profiler::Get().Record(m_Track, m_Name, m_Start, end, m_Track.Depth);
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
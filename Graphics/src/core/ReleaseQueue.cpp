@@ -0,0 +1,129 @@
+#include "ReleaseQueue.h"
+
+ReleaseQueue& ReleaseQueue::Get() {
+	static ReleaseQueue queue;
+	return queue;
+}
+
+ReleaseQueue::ReleaseQueue() : m_MaxPooled(32), m_Active(true) {
+}
+
+void ReleaseQueue::ReleaseBuffer(unsigned int id, unsigned int size) {
+	Enqueue({ RESOURCE_BUFFER, id, size, 0, 0, 0 });
+}
+
+void ReleaseQueue::ReleaseTexture(unsigned int id, unsigned int internalFormat, int width, int height) {
+	Enqueue({ RESOURCE_TEXTURE, id, 0, internalFormat, width, height });
+}
+
+void ReleaseQueue::ReleaseVertexArray(unsigned int id) {
+	Enqueue({ RESOURCE_VERTEX_ARRAY, id, 0, 0, 0, 0 });
+}
+
+void ReleaseQueue::ReleaseProgram(unsigned int id) {
+	Enqueue({ RESOURCE_PROGRAM, id, 0, 0, 0, 0 });
+}
+
+unsigned int ReleaseQueue::AcquireBuffer(unsigned int size) {
+	for (auto it = m_FreeBuffers.begin(); it != m_FreeBuffers.end(); ++it) {
+		if (it->size == size) {
+			unsigned int id = it->id;
+			m_FreeBuffers.erase(it);
+			return id;
+		}
+	}
+	return 0;
+}
+
+unsigned int ReleaseQueue::AcquireTexture(unsigned int internalFormat, int width, int height) {
+	if (width <= 0 || height <= 0) return 0;
+	for (auto it = m_FreeTextures.begin(); it != m_FreeTextures.end(); ++it) {
+		if (it->format == internalFormat && it->width == width && it->height == height) {
+			unsigned int id = it->id;
+			m_FreeTextures.erase(it);
+			return id;
+		}
+	}
+	return 0;
+}
+
+void ReleaseQueue::EndFrame() {
+	if (!m_Current.empty()) {
+		Batch batch;
+		batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		batch.resources.swap(m_Current);
+		m_InFlight.push_back(std::move(batch));
+	}
+
+	// Batches complete in submission order, stop at the first one still in flight
+	while (!m_InFlight.empty()) {
+		Batch& batch = m_InFlight.front();
+		GLenum status = glClientWaitSync(batch.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+		glDeleteSync(batch.fence);
+		for (const Resource& resource : batch.resources) {
+			Recycle(resource);
+		}
+		m_InFlight.pop_front();
+	}
+}
+
+void ReleaseQueue::Shutdown() {
+	if (!m_Active) return;
+	for (Batch& batch : m_InFlight) {
+		glClientWaitSync(batch.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		glDeleteSync(batch.fence);
+		for (const Resource& resource : batch.resources) Delete(resource);
+	}
+	m_InFlight.clear();
+	for (const Resource& resource : m_Current) Delete(resource);
+	for (const Resource& resource : m_FreeBuffers) Delete(resource);
+	for (const Resource& resource : m_FreeTextures) Delete(resource);
+	m_Current.clear();
+	m_FreeBuffers.clear();
+	m_FreeTextures.clear();
+	m_Active = false;
+}
+
+size_t ReleaseQueue::GetPendingCount() const {
+	size_t count = m_Current.size();
+	for (const Batch& batch : m_InFlight) count += batch.resources.size();
+	return count;
+}
+
+void ReleaseQueue::Enqueue(const Resource& resource) {
+	if (resource.id == 0) return;
+	if (!m_Active) {
+		Delete(resource);
+		return;
+	}
+	m_Current.push_back(resource);
+}
+
+void ReleaseQueue::Recycle(const Resource& resource) {
+	std::deque<Resource>* pool = nullptr;
+	if (resource.type == RESOURCE_BUFFER) pool = &m_FreeBuffers;
+	// A texture without storage (failed load) has nothing worth reusing
+	else if (resource.type == RESOURCE_TEXTURE && resource.width > 0 && resource.height > 0) pool = &m_FreeTextures;
+
+	if (!pool || m_MaxPooled == 0) {
+		Delete(resource);
+		return;
+	}
+	// Keep the most recently freed objects, those are the likeliest to match the next request
+	if (pool->size() >= m_MaxPooled) {
+		Delete(pool->front());
+		pool->pop_front();
+	}
+	pool->push_back(resource);
+}
+
+void ReleaseQueue::Delete(const Resource& resource) {
+	switch (resource.type) {
+		case RESOURCE_BUFFER:		glDeleteBuffers(1, &resource.id); break;
+		case RESOURCE_TEXTURE:		glDeleteTextures(1, &resource.id); break;
+		case RESOURCE_VERTEX_ARRAY:	glDeleteVertexArrays(1, &resource.id); break;
+		case RESOURCE_PROGRAM:		glDeleteProgram(resource.id); break;
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "glad/glad.h"
+
+enum resource_type {
+	RESOURCE_BUFFER,
+	RESOURCE_TEXTURE,
+	RESOURCE_VERTEX_ARRAY,
+	RESOURCE_PROGRAM
+};
+
+// Holds on to GL objects whose owners were destroyed until the GPU has finished the
+// frame that could still reference them. Releases made during a frame are tagged with
+// the fence EndFrame() inserts after that frame's commands; once it signals, buffers and
+// textures go into reuse pools and everything else is deleted.
+class ReleaseQueue {
+private:
+	struct Resource {
+		resource_type type;
+		unsigned int id;
+		unsigned int size;			// buffers
+		unsigned int format;		// textures
+		int width;
+		int height;
+	};
+
+	struct Batch {
+		GLsync fence;
+		std::vector<Resource> resources;
+	};
+
+	std::vector<Resource> m_Current;
+	std::deque<Batch> m_InFlight;
+	std::deque<Resource> m_FreeBuffers;
+	std::deque<Resource> m_FreeTextures;
+	size_t m_MaxPooled;
+	bool m_Active;
+
+public:
+	static ReleaseQueue& Get();
+
+	// Owners call these from their destructors instead of glDelete*
+	void ReleaseBuffer(unsigned int id, unsigned int size);
+	void ReleaseTexture(unsigned int id, unsigned int internalFormat, int width, int height);
+	void ReleaseVertexArray(unsigned int id);
+	void ReleaseProgram(unsigned int id);
+
+	// Returns a recycled object with matching storage, or 0 when the pool has none
+	unsigned int AcquireBuffer(unsigned int size);
+	unsigned int AcquireTexture(unsigned int internalFormat, int width, int height);
+
+	// Call once per frame after the last draw call
+	void EndFrame();
+	// Waits for the GPU and deletes everything, later releases are deleted immediately
+	void Shutdown();
+
+	inline void SetMaxPooled(size_t count) { m_MaxPooled = count; }
+	size_t GetPendingCount() const;
+	inline size_t GetPooledCount() const { return m_FreeBuffers.size() + m_FreeTextures.size(); }
+
+private:
+	ReleaseQueue();
+	ReleaseQueue(const ReleaseQueue&) = delete;
+	ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+
+	void Enqueue(const Resource& resource);
+	void Recycle(const Resource& resource);
+	static void Delete(const Resource& resource);
+};
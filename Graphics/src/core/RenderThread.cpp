@@ -0,0 +1,137 @@
+#include <iostream>
+
+#include "RenderThread.h"
+#include "Renderer.h"
+#include "Profiler.h"
+
+namespace {
+	// Rounds a side keeps polling its queue before going to sleep
+	const int IDLE_SPINS = 64;
+}
+
+RenderThread::RenderThread() :
+	m_Current(nullptr),
+	m_Frame(0),
+	m_Window(nullptr),
+	m_Sleeping(0),
+	m_Running(false),
+	m_Initialized(false)
+{
+	for (FramePacket& packet : m_Packets) m_Returned.Push(&packet);
+}
+
+RenderThread::~RenderThread() {
+	Stop();
+}
+
+void RenderThread::Start(GLFWwindow* window, const Callback& initialize, const RenderCallback& render, const Callback& shutdown) {
+	if (m_Thread.joinable()) {
+		std::cout << "ERROR::RENDER_THREAD::ALREADY_STARTED" << std::endl;
+		return;
+	}
+	m_Window = window;
+	m_Initialize = initialize;
+	m_Render = render;
+	m_Shutdown = shutdown;
+	m_Running = true;
+	m_Thread = std::thread(&RenderThread::Loop, this);
+
+	std::unique_lock<std::mutex> lock(m_SleepMutex);
+	m_WakeUp.wait(lock, [this]() { return m_Initialized; });
+}
+
+void RenderThread::Stop() {
+	if (!m_Thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Running = false;
+	}
+	m_WakeUp.notify_all();
+	m_Thread.join();
+}
+
+FramePacket& RenderThread::BeginFrame() {
+	if (!m_Current) {
+		m_Current = WaitPop(m_Returned);
+		if (!m_Current) {
+			// Not started, or stopped: there is nobody to hand the packet back
+			std::cout << "ERROR::RENDER_THREAD::NOT_RUNNING" << std::endl;
+			m_Current = &m_Packets[0];
+		}
+	}
+	m_Current->Clear();
+	m_Current->Frame = m_Frame++;
+	return *m_Current;
+}
+
+void RenderThread::Submit() {
+	if (!m_Current || !m_Running) return;
+	// Never full, there are only as many packets as slots
+	m_Submitted.Push(m_Current);
+	m_Current = nullptr;
+	WakeUp();
+}
+
+void RenderThread::Loop() {
+	glfwMakeContextCurrent(m_Window);
+#if PROFILING
+	Profiler::Get().SetThreadName("render");
+#endif
+	if (m_Initialize) m_Initialize();
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Initialized = true;
+	}
+	m_WakeUp.notify_all();
+
+	// Runs until stopped and every submitted packet is drawn
+	while (FramePacket* packet = WaitPop(m_Submitted)) {
+		{
+			PROFILE_SCOPE("Uploads");
+			for (std::function<void()>& upload : packet->Uploads) upload();
+			// Closures may hold GL resources, let them go on this thread
+			packet->Uploads.clear();
+		}
+		{
+			PROFILE_SCOPE("Render");
+			if (m_Render) m_Render(*packet);
+		}
+		{
+			PROFILE_SCOPE("SwapBuffers");
+			glfwSwapBuffers(m_Window);
+		}
+
+		m_Returned.Push(packet);
+		WakeUp();
+	}
+
+	if (m_Shutdown) m_Shutdown();
+	glfwMakeContextCurrent(nullptr);
+}
+
+FramePacket* RenderThread::WaitPop(SpscQueue<FramePacket*, PACKET_COUNT>& queue) {
+	FramePacket* packet = nullptr;
+	for (int spin = 0; spin < IDLE_SPINS; spin++) {
+		if (queue.Pop(packet)) return packet;
+		// A push made before stopping is visible once the stop is
+		if (!m_Running) return queue.Pop(packet) ? packet : nullptr;
+		std::this_thread::yield();
+	}
+
+	std::unique_lock<std::mutex> lock(m_SleepMutex);
+	m_Sleeping.fetch_add(1);
+	// Pairs with the fence in WakeUp: either the pusher sees a sleeper or this sees the push
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	m_WakeUp.wait(lock, [&]() { return queue.Pop(packet) || !m_Running; });
+	m_Sleeping.fetch_sub(1);
+	if (!packet) queue.Pop(packet);
+	return packet;
+}
+
+void RenderThread::WakeUp() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_Sleeping.load(std::memory_order_relaxed) > 0) {
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_WakeUp.notify_all();
+	}
+}
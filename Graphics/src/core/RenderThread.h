@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "glm.hpp"
+
+#include "SpscQueue.h"
+#include "CommandList.h"
+
+struct GLFWwindow;
+
+// Everything the render thread needs to draw one frame, filled in by the main thread.
+// Packets are recycled, so the vectors keep their capacity from frame to frame.
+struct FramePacket {
+	uint64_t Frame;
+	float Time;
+	int ViewportWidth;
+	int ViewportHeight;
+	glm::vec3 Eye;
+	glm::mat4 View;
+	glm::mat4 Projection;
+	glm::mat4 ViewProjection;
+	std::vector<unsigned int> Objects;				// objects to draw, in order
+	std::vector<std::function<void()>> Uploads;		// GL work run before drawing: uploads, resource changes, requests
+	std::vector<CommandList> Lists;					// recorded on any thread, replayed by the render callback
+	std::vector<CommandRange> ObjectCommands;		// per object id, the commands that draw it
+
+	inline void Clear() {
+		Objects.clear();
+		Uploads.clear();
+		for (CommandList& list : Lists) list.Clear();
+	}
+};
+
+// Owns the GL context on a thread of its own. The main thread fills one packet while the
+// render thread submits the previous one; packets go over in a lock-free queue and come
+// back once drawn, so the main thread runs at most one frame ahead.
+class RenderThread {
+public:
+	typedef std::function<void()> Callback;
+	typedef std::function<void(const FramePacket&)> RenderCallback;
+
+private:
+	enum : size_t { PACKET_COUNT = 2 };
+
+	FramePacket m_Packets[PACKET_COUNT];
+	SpscQueue<FramePacket*, PACKET_COUNT> m_Submitted;	// main -> render
+	SpscQueue<FramePacket*, PACKET_COUNT> m_Returned;	// render -> main
+	FramePacket* m_Current;
+	uint64_t m_Frame;
+
+	GLFWwindow* m_Window;
+	Callback m_Initialize;
+	RenderCallback m_Render;
+	Callback m_Shutdown;
+	std::thread m_Thread;
+
+	// Either side sleeps here when its queue stays empty
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeUp;
+	std::atomic<int> m_Sleeping;
+	std::atomic<bool> m_Running;
+	bool m_Initialized;
+
+public:
+	RenderThread();
+	~RenderThread();
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// Takes over the window's context, the calling thread must have released it. initialize
+	// and shutdown run on the render thread around the frames, render once per packet
+	// before the buffers are swapped. Returns once initialize is done, so whatever it
+	// created (renderer ids to record commands with) can be read afterwards.
+	void Start(GLFWwindow* window, const Callback& initialize, const RenderCallback& render, const Callback& shutdown);
+	// Renders what was submitted, runs shutdown and joins the thread
+	void Stop();
+
+	// Packet for the next frame, waits while the render thread still holds both
+	FramePacket& BeginFrame();
+	// Hands the packet from BeginFrame to the render thread
+	void Submit();
+
+	inline bool IsRunning() const { return m_Running.load(); }
+
+private:
+	void Loop();
+	FramePacket* WaitPop(SpscQueue<FramePacket*, PACKET_COUNT>& queue);
+	void WakeUp();
+};
@@ -10,4 +10,23 @@ void Renderer::Draw(const VertexArray& vertexArray, const ElementBuffer& element
 	vertexArray.Bind();
 	elementBuffer.Bind();
 	glDrawElements(GL_TRIANGLES, elementBuffer.GetCount(), GL_UNSIGNED_INT, nullptr);
-}
\ No newline at end of file
+	m_Stats.DrawCalls++;
+}
+
+void Renderer::Draw(const VertexArray& vertexArray, const ElementBuffer& elementBuffer, const Shader& shader, const LodLevel& level) const {
+	shader.Bind();
+	vertexArray.Bind();
+	elementBuffer.Bind();
+	glDrawElements(GL_TRIANGLES, level.IndexCount, GL_UNSIGNED_INT, (void*)(level.IndexOffset * sizeof(unsigned int)));
+	m_Stats.DrawCalls++;
+}
+
+void Renderer::DrawOccluded(const std::vector<unsigned int>& objects, const std::vector<AABB>& bounds,
+							const glm::vec3& eye, const glm::mat4& viewProjection,
+							const Shader& shader, const VertexArray& vertexArray,
+							const std::function<void(unsigned int)>& draw) {
+	// Created on first use so plain renderers never compile the bounds shader
+	if (!m_Occlusion) m_Occlusion.reset(new OcclusionQueries());
+	m_Occlusion->SetStatistics(m_Statistics);
+	m_Occlusion->Draw(objects, bounds, eye, viewProjection, shader, vertexArray, draw, m_Stats);
+}
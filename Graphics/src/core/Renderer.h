@@ -1,14 +1,40 @@
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
 
 #include "VertexArray.h"
 #include "ElementBuffer.h"
 #include "Shader.h"
+#include "OcclusionQueries.h"
+#include "MeshLod.h"
 
 class Renderer {
+private:
+	mutable RenderStats m_Stats;
+	std::unique_ptr<OcclusionQueries> m_Occlusion;
+	PipelineStatistics* m_Statistics = nullptr;
+
 public:
 	void Clear() const;
 	void Draw(const VertexArray& vertexArray, const ElementBuffer& elementBuffer, const Shader& shader) const;
+	// elementBuffer holds the whole LodChain::Indices, only the level's range is drawn
+	void Draw(const VertexArray& vertexArray, const ElementBuffer& elementBuffer, const Shader& shader, const LodLevel& level) const;
+
+	// Draws objects (front to back for best results) skipping the ones hardware occlusion
+	// queries found hidden, draw(id) issues the draw calls of one object
+	void DrawOccluded(const std::vector<unsigned int>& objects, const std::vector<AABB>& bounds,
+					  const glm::vec3& eye, const glm::mat4& viewProjection,
+					  const Shader& shader, const VertexArray& vertexArray,
+					  const std::function<void(unsigned int)>& draw);
+
+	// Pass counters open around DrawOccluded, paused while it runs occlusion queries
+	inline void SetPipelineStatistics(PipelineStatistics* statistics) { m_Statistics = statistics; }
+
+	inline void ResetStats() { m_Stats = RenderStats(); }
+	inline const RenderStats& GetStats() const { return m_Stats; }
 };
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// 32-bit reference into a ResourcePool: 20 bits of slot index, 12 bits of generation.
+// The generation changes whenever a slot is freed, so a handle that outlived its
+// resource no longer resolves. A value of 0 is never handed out and means "no resource".
+template<typename T>
+struct Handle {
+	enum : uint32_t {
+		INDEX_BITS = 20,
+		INDEX_MASK = (1u << INDEX_BITS) - 1,
+		GENERATION_MASK = (1u << (32 - INDEX_BITS)) - 1
+	};
+
+	uint32_t value = 0;
+
+	inline uint32_t GetIndex() const { return value & INDEX_MASK; }
+	inline uint32_t GetGeneration() const { return value >> INDEX_BITS; }
+	inline bool IsNull() const { return value == 0; }
+
+	inline bool operator==(const Handle& other) const { return value == other.value; }
+	inline bool operator!=(const Handle& other) const { return value != other.value; }
+
+	static Handle Make(uint32_t index, uint32_t generation) {
+		Handle handle;
+		handle.value = (generation << INDEX_BITS) | index;
+		return handle;
+	}
+};
+
+// Stores objects contiguously so that iterating all of them walks a single array.
+// Removal moves the last object into the hole, which is why T must be movable;
+// handles stay valid across those moves because they go through a slot table.
+template<typename T>
+class ResourcePool {
+private:
+	enum : uint32_t { INVALID = 0xFFFFFFFFu };
+
+	std::vector<T> m_Dense;
+	std::vector<uint32_t> m_DenseToSlot;
+	std::vector<uint32_t> m_SlotToDense;
+	std::vector<uint32_t> m_Generations;
+	std::vector<uint32_t> m_FreeSlots;
+
+public:
+	template<typename... Args>
+	Handle<T> Create(Args&&... args) {
+		uint32_t slot;
+		if (!m_FreeSlots.empty()) {
+			slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else {
+			if (m_SlotToDense.size() > Handle<T>::INDEX_MASK) {
+				std::cout << "ERROR::RESOURCE_POOL::FULL" << std::endl;
+				return Handle<T>();
+			}
+			slot = static_cast<uint32_t>(m_SlotToDense.size());
+			m_SlotToDense.push_back(INVALID);
+			m_Generations.push_back(1);
+		}
+
+		m_SlotToDense[slot] = static_cast<uint32_t>(m_Dense.size());
+		m_Dense.emplace_back(std::forward<Args>(args)...);
+		m_DenseToSlot.push_back(slot);
+		return Handle<T>::Make(slot, m_Generations[slot]);
+	}
+
+	// Returns nullptr for null, destroyed or recycled handles
+	T* Get(Handle<T> handle) {
+		uint32_t dense = Resolve(handle);
+		return dense == INVALID ? nullptr : &m_Dense[dense];
+	}
+	const T* Get(Handle<T> handle) const {
+		uint32_t dense = Resolve(handle);
+		return dense == INVALID ? nullptr : &m_Dense[dense];
+	}
+
+	inline bool IsAlive(Handle<T> handle) const { return Resolve(handle) != INVALID; }
+
+	bool Destroy(Handle<T> handle) {
+		uint32_t dense = Resolve(handle);
+		if (dense == INVALID) return false;
+
+		const uint32_t slot = handle.GetIndex();
+		const uint32_t last = static_cast<uint32_t>(m_Dense.size()) - 1;
+		if (dense != last) {
+			m_Dense[dense] = std::move(m_Dense[last]);
+			m_DenseToSlot[dense] = m_DenseToSlot[last];
+			m_SlotToDense[m_DenseToSlot[dense]] = dense;
+		}
+		m_Dense.pop_back();
+		m_DenseToSlot.pop_back();
+
+		// Skip generation 0 so a live handle can never be equal to the null handle
+		m_SlotToDense[slot] = INVALID;
+		m_Generations[slot] = (m_Generations[slot] + 1) & Handle<T>::GENERATION_MASK;
+		if (m_Generations[slot] == 0) m_Generations[slot] = 1;
+		m_FreeSlots.push_back(slot);
+		return true;
+	}
+
+	void Clear() {
+		while (!m_Dense.empty()) {
+			Destroy(Handle<T>::Make(m_DenseToSlot.back(), m_Generations[m_DenseToSlot.back()]));
+		}
+	}
+
+	// Handle of the object stored at a dense position, for use while iterating
+	inline Handle<T> GetHandle(size_t denseIndex) const {
+		uint32_t slot = m_DenseToSlot[denseIndex];
+		return Handle<T>::Make(slot, m_Generations[slot]);
+	}
+
+	inline size_t GetCount() const { return m_Dense.size(); }
+	inline T* begin() { return m_Dense.data(); }
+	inline T* end() { return m_Dense.data() + m_Dense.size(); }
+	inline const T* begin() const { return m_Dense.data(); }
+	inline const T* end() const { return m_Dense.data() + m_Dense.size(); }
+
+private:
+	uint32_t Resolve(Handle<T> handle) const {
+		const uint32_t slot = handle.GetIndex();
+		if (handle.IsNull() || slot >= m_SlotToDense.size()) return INVALID;
+		if (m_Generations[slot] != handle.GetGeneration()) return INVALID;
+		return m_SlotToDense[slot];
+	}
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ResourcePool.h"
+#include "VertexBuffer.h"
+#include "ElementBuffer.h"
+#include "VertexArray.h"
+#include "Texture.h"
+#include "Shader.h"
+
+typedef Handle<VertexBuffer>	VertexBufferHandle;
+typedef Handle<ElementBuffer>	ElementBufferHandle;
+typedef Handle<VertexArray>		VertexArrayHandle;
+typedef Handle<Texture>			TextureHandle;
+typedef Handle<Shader>			ShaderHandle;
+
+// Owns every GPU resource type in its own dense pool. Code that only needs to refer to
+// a resource keeps a handle, which is a plain 32-bit value and safe to copy anywhere.
+// Pools must still only be accessed from the thread that owns the GL context.
+class ResourceRegistry {
+public:
+	ResourcePool<VertexBuffer>	VertexBuffers;
+	ResourcePool<ElementBuffer>	ElementBuffers;
+	ResourcePool<VertexArray>	VertexArrays;
+	ResourcePool<Texture>		Textures;
+	ResourcePool<Shader>		Shaders;
+
+	template<typename T>
+	ResourcePool<T>& GetPool();
+
+	template<typename T, typename... Args>
+	Handle<T> Create(Args&&... args) { return GetPool<T>().Create(std::forward<Args>(args)...); }
+
+	template<typename T>
+	T* Get(Handle<T> handle) { return GetPool<T>().Get(handle); }
+
+	template<typename T>
+	bool Destroy(Handle<T> handle) { return GetPool<T>().Destroy(handle); }
+};
+
+template<> inline ResourcePool<VertexBuffer>& ResourceRegistry::GetPool<VertexBuffer>() { return VertexBuffers; }
+template<> inline ResourcePool<ElementBuffer>& ResourceRegistry::GetPool<ElementBuffer>() { return ElementBuffers; }
+template<> inline ResourcePool<VertexArray>& ResourceRegistry::GetPool<VertexArray>() { return VertexArrays; }
+template<> inline ResourcePool<Texture>& ResourceRegistry::GetPool<Texture>() { return Textures; }
+template<> inline ResourcePool<Shader>& ResourceRegistry::GetPool<Shader>() { return Shaders; }
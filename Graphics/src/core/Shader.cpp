@@ -1,8 +1,10 @@
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
 #include "Shader.h"
 #include "Renderer.h"
+#include "ReleaseQueue.h"
 
 Shader::Shader(const std::string& VertexFilepath, const std::string& FragmentFilepath) :
 	m_VertexFilepath(VertexFilepath),
@@ -15,7 +17,28 @@ Shader::Shader(const std::string& VertexFilepath, const std::string& FragmentFil
 }
 
 Shader::~Shader() {
-	glDeleteProgram(m_RendererID);
+	ReleaseQueue::Get().ReleaseProgram(m_RendererID);
+}
+
+Shader::Shader(Shader&& other) noexcept :
+	m_VertexFilepath(std::move(other.m_VertexFilepath)),
+	m_FragmentFilepath(std::move(other.m_FragmentFilepath)),
+	m_RendererID(other.m_RendererID),
+	m_UniformLocationCache(std::move(other.m_UniformLocationCache))
+{
+	other.m_RendererID = 0;
+}
+
+Shader& Shader::operator=(Shader&& other) noexcept {
+	if (this != &other) {
+		ReleaseQueue::Get().ReleaseProgram(m_RendererID);
+		m_VertexFilepath = std::move(other.m_VertexFilepath);
+		m_FragmentFilepath = std::move(other.m_FragmentFilepath);
+		m_RendererID = other.m_RendererID;
+		m_UniformLocationCache = std::move(other.m_UniformLocationCache);
+		other.m_RendererID = 0;
+	}
+	return *this;
 }
 
 unsigned int Shader::CompileShader(const std::string& filepath, shader_type type) {
@@ -109,36 +132,36 @@ void Shader::Unbind() const {
 	glUseProgram(0);
 }
 
-int Shader::GetUniformLocation(const std::string& name) const {
-	if (m_UniformLocationCache.find(name) != m_UniformLocationCache.end()) {
-		return m_UniformLocationCache[name];
+int Shader::GetUniformLocation(const char* name) const {
+	for (const std::pair<std::string, int>& entry : m_UniformLocationCache) {
+		if (std::strcmp(entry.first.c_str(), name) == 0) return entry.second;
 	}
-	int location = glGetUniformLocation(m_RendererID, name.c_str());
+	int location = glGetUniformLocation(m_RendererID, name);
 	if (location == -1) {
 		std::cout << "Warning: uniform " << name << " not found!" << std::endl;
 	}
-	m_UniformLocationCache[name] = location;
+	m_UniformLocationCache.push_back(std::make_pair(std::string(name), location));
 	return location;
 }
 
-void Shader::SetUniformli(const std::string& name, int value) {
+void Shader::SetUniformli(const char* name, int value) {
 	glUniform1i(GetUniformLocation(name), value);
 }
-void Shader::SetUniform1f(const std::string& name, float value) {
+void Shader::SetUniform1f(const char* name, float value) {
 	glUniform1f(GetUniformLocation(name), value);
 }
-void Shader::SetUniform2f(const std::string& name, const glm::vec2& value) {
+void Shader::SetUniform2f(const char* name, const glm::vec2& value) {
 	glUniform2f(GetUniformLocation(name), value.x, value.y);
 }
-void Shader::SetUniform3f(const std::string& name, const glm::vec3& value) {
+void Shader::SetUniform3f(const char* name, const glm::vec3& value) {
 	glUniform3f(GetUniformLocation(name), value.r, value.g, value.b);
 }
-void Shader::SetUniform4f(const std::string& name, const glm::vec4& value) {
+void Shader::SetUniform4f(const char* name, const glm::vec4& value) {
 	glUniform4f(GetUniformLocation(name), value.r, value.g, value.b, value.a);
 }
-void Shader::SetUniformMat3(const std::string& name, const glm::mat3& matrix) {
+void Shader::SetUniformMat3(const char* name, const glm::mat3& matrix) {
 	glUniformMatrix3fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]);
 }
-void Shader::SetUniformMat4(const std::string& name, const glm::mat4& matrix) {
+void Shader::SetUniformMat4(const char* name, const glm::mat4& matrix) {
 	glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &matrix[0][0]);
 }
\ No newline at end of file
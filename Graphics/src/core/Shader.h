@@ -1,7 +1,8 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "glm.hpp"
 
@@ -15,28 +16,36 @@ private:
 	std::string m_VertexFilepath;
 	std::string m_FragmentFilepath;
 	unsigned int m_RendererID;
-	mutable std::unordered_map<std::string, int> m_UniformLocationCache;
+	// Name and location, searched in order: a shader has a handful of uniforms, and looking
+	// one up by literal must not build a std::string on every call
+	mutable std::vector<std::pair<std::string, int>> m_UniformLocationCache;
 	
 public:
 	Shader(const std::string& VertexFilepath, const std::string& FragmentFilepath);
 	~Shader();
 
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	Shader(Shader&& other) noexcept;
+	Shader& operator=(Shader&& other) noexcept;
+
 	void Bind() const;
 	void Unbind() const;
+	inline unsigned int GetRendererID() const { return m_RendererID; }
 	
 	// Uniforms
-	void SetUniformli(const std::string& name, int value);
-	void SetUniform1f(const std::string& name, float value);
-	void SetUniform2f(const std::string& name, const glm::vec2& value);
-	void SetUniform3f(const std::string& name, const glm::vec3& value);
-	void SetUniform4f(const std::string& name, const glm::vec4& value);
-	void SetUniformMat3(const std::string& name, const glm::mat3& matrix);
-	void SetUniformMat4(const std::string& name, const glm::mat4& matrix);
+	void SetUniformli(const char* name, int value);
+	void SetUniform1f(const char* name, float value);
+	void SetUniform2f(const char* name, const glm::vec2& value);
+	void SetUniform3f(const char* name, const glm::vec3& value);
+	void SetUniform4f(const char* name, const glm::vec4& value);
+	void SetUniformMat3(const char* name, const glm::mat3& matrix);
+	void SetUniformMat4(const char* name, const glm::mat4& matrix);
 
 private:
 	unsigned int CreateShader(const std::string& VertexShaderSource, const std::string& FragmentShaderSource);
 	unsigned int CompileShader(const std::string& filepath, shader_type type);
 	bool CheckShader(unsigned int shader, bool program = false);
 
-	int GetUniformLocation(const std::string& name) const;
+	int GetUniformLocation(const char* name) const;
 };
\ No newline at end of file
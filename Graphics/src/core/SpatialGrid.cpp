@@ -0,0 +1,321 @@
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+#include "gtc/matrix_transform.hpp"
+
+#include "SpatialGrid.h"
+#include "JobSystem.h"
+
+SpatialGrid::SpatialGrid(float cellSize) :
+	m_CellSize(cellSize),
+	m_InvCellSize(1.0f / cellSize),
+	m_MaxRadius(0.0f),
+	m_Count(0)
+{
+}
+
+unsigned int SpatialGrid::Insert(const glm::vec3& position, float radius) {
+	unsigned int id;
+	if (!m_FreeIds.empty()) {
+		id = m_FreeIds.back();
+		m_FreeIds.pop_back();
+	}
+	else {
+		id = static_cast<unsigned int>(m_Objects.size());
+		m_Objects.push_back(Object());
+	}
+
+	Object& object = m_Objects[id];
+	object.Position = position;
+	object.Radius = radius;
+	if (radius > m_MaxRadius) m_MaxRadius = radius;
+
+	Link(id, FindOrCreateCell(ToCell(position.x), ToCell(position.y), ToCell(position.z)));
+	m_Count++;
+	return id;
+}
+
+void SpatialGrid::Update(unsigned int id, const glm::vec3& position) {
+	if (id >= m_Objects.size() || m_Objects[id].Cell == INVALID) return;
+	Object& object = m_Objects[id];
+	object.Position = position;
+
+	// Most frames an object stays inside its cell and only the position changes
+	const int64_t x = ToCell(position.x), y = ToCell(position.y), z = ToCell(position.z);
+	if (object.CellX == x && object.CellY == y && object.CellZ == z) return;
+
+	Unlink(id);
+	Link(id, FindOrCreateCell(x, y, z));
+}
+
+void SpatialGrid::Update(unsigned int id, const glm::vec3& position, float radius) {
+	if (id >= m_Objects.size() || m_Objects[id].Cell == INVALID) return;
+	m_Objects[id].Radius = radius;
+	if (radius > m_MaxRadius) m_MaxRadius = radius;
+	Update(id, position);
+}
+
+void SpatialGrid::Remove(unsigned int id) {
+	if (id >= m_Objects.size() || m_Objects[id].Cell == INVALID) return;
+	Unlink(id);
+	m_Objects[id].Cell = INVALID;
+	m_FreeIds.push_back(id);
+	m_Count--;
+}
+
+void SpatialGrid::Clear() {
+	m_Objects.clear();
+	m_FreeIds.clear();
+	m_Cells.clear();
+	m_SpareLists.clear();
+	m_CellLookup.clear();
+	m_MaxRadius = 0.0f;
+	m_Count = 0;
+}
+
+void SpatialGrid::Link(unsigned int id, unsigned int cell) {
+	Cell& target = m_Cells[cell];
+	Object& object = m_Objects[id];
+	object.Cell = cell;
+	object.Slot = static_cast<unsigned int>(target.Objects.size());
+	object.CellX = target.X;
+	object.CellY = target.Y;
+	object.CellZ = target.Z;
+	std::vector<unsigned int>& objects = target.Objects;
+	objects.push_back(id);
+}
+
+void SpatialGrid::Unlink(unsigned int id) {
+	const Object& object = m_Objects[id];
+	std::vector<unsigned int>& objects = m_Cells[object.Cell].Objects;
+	const unsigned int moved = objects.back();
+	objects[object.Slot] = moved;
+	m_Objects[moved].Slot = object.Slot;
+	objects.pop_back();
+	if (objects.empty()) ReleaseCell(object.Cell);
+}
+
+void SpatialGrid::ReleaseCell(unsigned int cell) {
+	Cell& released = m_Cells[cell];
+	m_CellLookup.erase(CellKey{ released.X, released.Y, released.Z });
+	// Objects crossing back and forth would otherwise reallocate the list every time
+	m_SpareLists.push_back(std::move(released.Objects));
+
+	// Swap and pop, the last cell takes the freed index
+	const unsigned int last = static_cast<unsigned int>(m_Cells.size() - 1);
+	if (cell != last) {
+		released = std::move(m_Cells[last]);
+		m_CellLookup[CellKey{ released.X, released.Y, released.Z }] = cell;
+		for (unsigned int id : released.Objects) m_Objects[id].Cell = cell;
+	}
+	m_Cells.pop_back();
+}
+
+size_t SpatialGrid::CellKeyHash::operator()(const CellKey& key) const {
+	// Every bit of all three coordinates reaches the result, so keys never wrap. X is added
+	// last and unscaled: the cells of a query row land in neighbouring buckets.
+	const uint64_t hash = static_cast<uint64_t>(key.Z) * 0x9E3779B97F4A7C15ull + static_cast<uint64_t>(key.Y) * 0xC2B2AE3D27D4EB4Full;
+	return static_cast<size_t>((hash ^ (hash >> 32)) + static_cast<uint64_t>(key.X));
+}
+
+unsigned int SpatialGrid::FindCell(int64_t x, int64_t y, int64_t z) const {
+	auto it = m_CellLookup.find(CellKey{ x, y, z });
+	return it == m_CellLookup.end() ? INVALID : it->second;
+}
+
+unsigned int SpatialGrid::FindOrCreateCell(int64_t x, int64_t y, int64_t z) {
+	const CellKey key = { x, y, z };
+	auto it = m_CellLookup.find(key);
+	if (it != m_CellLookup.end()) return it->second;
+
+	const unsigned int index = static_cast<unsigned int>(m_Cells.size());
+	Cell cell;
+	cell.X = x;
+	cell.Y = y;
+	cell.Z = z;
+	if (!m_SpareLists.empty()) {
+		cell.Objects = std::move(m_SpareLists.back());
+		m_SpareLists.pop_back();
+	}
+	m_Cells.push_back(std::move(cell));
+	m_CellLookup.emplace(key, index);
+	return index;
+}
+
+void SpatialGrid::CollectCells(const AABB& box, std::vector<unsigned int>& result, const glm::vec3& center, float radius, bool sphere) const {
+	// Objects can stick out of their cell by up to the largest radius
+	const glm::vec3 min = box.Min - m_MaxRadius;
+	const glm::vec3 max = box.Max + m_MaxRadius;
+	const int64_t x0 = ToCell(min.x), y0 = ToCell(min.y), z0 = ToCell(min.z);
+	const int64_t x1 = ToCell(max.x), y1 = ToCell(max.y), z1 = ToCell(max.z);
+
+	// Huge query volumes touch fewer occupied cells than grid positions, walk those instead
+	const double volume = double(x1 - x0 + 1) * double(y1 - y0 + 1) * double(z1 - z0 + 1);
+	const bool scanOccupied = volume > static_cast<double>(m_Cells.size());
+
+	auto testCell = [&](const Cell& cell) {
+		for (unsigned int id : cell.Objects) {
+			const Object& object = m_Objects[id];
+			if (sphere) {
+				const float reach = radius + object.Radius;
+				const glm::vec3 d = object.Position - center;
+				if (glm::dot(d, d) <= reach * reach) result.push_back(id);
+			}
+			else if (box.DistanceSquared(object.Position) <= object.Radius * object.Radius) {
+				result.push_back(id);
+			}
+		}
+	};
+
+	if (scanOccupied) {
+		for (const Cell& cell : m_Cells) {
+			if (cell.X < x0 || cell.X > x1 || cell.Y < y0 || cell.Y > y1 || cell.Z < z0 || cell.Z > z1) continue;
+			testCell(cell);
+		}
+		return;
+	}
+	for (int64_t z = z0; z <= z1; z++) {
+		for (int64_t y = y0; y <= y1; y++) {
+			for (int64_t x = x0; x <= x1; x++) {
+				const unsigned int cell = FindCell(x, y, z);
+				if (cell != INVALID) testCell(m_Cells[cell]);
+			}
+		}
+	}
+}
+
+size_t SpatialGrid::QueryRadius(const glm::vec3& center, float radius, std::vector<unsigned int>& result) const {
+	result.clear();
+	CollectCells(AABB(center - radius, center + radius), result, center, radius, true);
+	return result.size();
+}
+
+size_t SpatialGrid::QueryBox(const AABB& box, std::vector<unsigned int>& result) const {
+	result.clear();
+	CollectCells(box, result, glm::vec3(0.0f), 0.0f, false);
+	return result.size();
+}
+
+size_t SpatialGrid::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& result) const {
+	result.clear();
+	for (const Cell& cell : m_Cells) {
+		// Loose cell bounds, then the objects' own spheres
+		const glm::vec3 min = glm::vec3(float(cell.X), float(cell.Y), float(cell.Z)) * m_CellSize - m_MaxRadius;
+		const glm::vec3 max = min + (m_CellSize + 2.0f * m_MaxRadius);
+		if (!frustum.ContainsBox(min, max)) continue;
+
+		for (unsigned int id : cell.Objects) {
+			const Object& object = m_Objects[id];
+			if (frustum.ContainsSphere(object.Position, object.Radius)) result.push_back(id);
+		}
+	}
+	return result.size();
+}
+
+GridBenchmark RunGridBenchmark(size_t objectCount, unsigned int frames) {
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	const float worldSize = 50.0f;		// about six objects per cell at 100k
+	const float speed = 0.25f;		// per frame, a sixteenth of the default cell
+	const float queryRadius = 20.0f;
+
+	SpatialGrid grid;
+	std::vector<unsigned int> ids(objectCount);
+	std::vector<glm::vec3> positions(objectCount), velocities(objectCount);
+	for (size_t i = 0; i < objectCount; i++) {
+		positions[i] = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+		velocities[i] = glm::vec3(unit(random), unit(random), unit(random)) * speed;
+		ids[i] = grid.Insert(positions[i], 0.5f + 0.5f * std::fabs(unit(random)));
+	}
+
+	// Query volumes of one frame, all centered where the objects are
+	const unsigned int queryCount = GRID_RADIUS_QUERIES + GRID_BOX_QUERIES + GRID_FRUSTUM_QUERIES;
+	std::vector<glm::vec3> centers(GRID_RADIUS_QUERIES);
+	std::vector<AABB> boxes(GRID_BOX_QUERIES);
+	std::vector<Frustum> frustums(GRID_FRUSTUM_QUERIES);
+	std::vector<std::vector<unsigned int>> found(queryCount);
+
+	GridBenchmark result = {};
+	std::atomic<unsigned int> mismatches(0);
+	frames = std::max(1u, frames);
+	for (unsigned int frame = 0; frame < frames; frame++) {
+		for (size_t i = 0; i < objectCount; i++) {
+			positions[i] += velocities[i];
+			// Bounce off the world border
+			for (int axis = 0; axis < 3; axis++) {
+				if (std::fabs(positions[i][axis]) > worldSize) velocities[i][axis] = -velocities[i][axis];
+			}
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < objectCount; i++) grid.Update(ids[i], positions[i]);
+		result.UpdateMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		result.PeakCells = std::max(result.PeakCells, grid.GetCellCount());
+
+		for (glm::vec3& center : centers) center = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+		for (AABB& box : boxes) {
+			const glm::vec3 center = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+			const glm::vec3 halfSize = glm::vec3(6.0f) + glm::vec3(unit(random), unit(random), unit(random)) * 4.0f;
+			box = AABB(center - halfSize, center + halfSize);
+		}
+		for (Frustum& frustum : frustums) {
+			const glm::vec3 eye = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+			const glm::vec3 target = glm::vec3(unit(random), unit(random), unit(random)) * worldSize;
+			frustum = Frustum::FromMatrix(glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 40.0f) * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned int q = 0; q < GRID_RADIUS_QUERIES; q++) grid.QueryRadius(centers[q], queryRadius, found[q]);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		result.RadiusMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+		start = end;
+		for (unsigned int q = 0; q < GRID_BOX_QUERIES; q++) grid.QueryBox(boxes[q], found[GRID_RADIUS_QUERIES + q]);
+		end = std::chrono::steady_clock::now();
+		result.BoxMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+		start = end;
+		for (unsigned int q = 0; q < GRID_FRUSTUM_QUERIES; q++) grid.QueryFrustum(frustums[q], found[GRID_RADIUS_QUERIES + GRID_BOX_QUERIES + q]);
+		end = std::chrono::steady_clock::now();
+		result.FrustumMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+		// Every query against every object, one job per query
+		JobSystem::Get().ParallelFor(0, queryCount, [&](size_t first, size_t last) {
+			std::vector<unsigned int> expected;
+			for (size_t q = first; q < last; q++) {
+				expected.clear();
+				for (size_t i = 0; i < objectCount; i++) {
+					const glm::vec3& position = grid.GetPosition(ids[i]);
+					const float radius = grid.GetRadius(ids[i]);
+					bool inside;
+					if (q < GRID_RADIUS_QUERIES) {
+						const float reach = queryRadius + radius;
+						const glm::vec3 d = position - centers[q];
+						inside = glm::dot(d, d) <= reach * reach;
+					}
+					else if (q < GRID_RADIUS_QUERIES + GRID_BOX_QUERIES) {
+						inside = boxes[q - GRID_RADIUS_QUERIES].DistanceSquared(position) <= radius * radius;
+					}
+					else {
+						inside = frustums[q - GRID_RADIUS_QUERIES - GRID_BOX_QUERIES].ContainsSphere(position, radius);
+					}
+					if (inside) expected.push_back(ids[i]);
+				}
+				std::sort(found[q].begin(), found[q].end());
+				std::sort(expected.begin(), expected.end());
+				if (found[q] != expected) mismatches++;
+			}
+		}, 1);
+		result.Queries += queryCount;
+	}
+	result.UpdateMilliseconds /= frames;
+	result.RadiusMilliseconds /= frames;
+	result.BoxMilliseconds /= frames;
+	result.FrustumMilliseconds /= frames;
+	result.FinalCells = grid.GetCellCount();
+	result.Mismatches = mismatches;
+	return result;
+}
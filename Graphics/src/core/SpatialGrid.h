@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+// Sparse uniform grid for objects that move every frame. Each object lives in the
+// cell containing its center, so moving it costs a hash lookup and, when it crosses
+// a cell border, one swap-and-pop removal and one append. Cells are loose: queries
+// grow every cell by the largest object radius instead of inserting objects into
+// every cell they overlap. A cell is freed as soon as its last object leaves, so the
+// cell array only ever holds occupied cells.
+class SpatialGrid {
+private:
+	struct Object {
+		glm::vec3 Position;
+		float Radius;
+		int64_t CellX, CellY, CellZ;	// copy of the cell coordinates, keeps Update() off the cell array
+		unsigned int Cell;			// index into m_Cells, INVALID when the id is free
+		unsigned int Slot;			// position inside the cell's object list
+	};
+
+	struct Cell {
+		int64_t X, Y, Z;
+		std::vector<unsigned int> Objects;
+	};
+
+	struct CellKey {
+		int64_t X, Y, Z;
+		inline bool operator==(const CellKey& other) const { return X == other.X && Y == other.Y && Z == other.Z; }
+	};
+	struct CellKeyHash {
+		size_t operator()(const CellKey& key) const;
+	};
+
+	enum : unsigned int { INVALID = 0xFFFFFFFFu };
+
+	float m_CellSize;
+	float m_InvCellSize;
+	float m_MaxRadius;
+	std::vector<Object> m_Objects;
+	std::vector<unsigned int> m_FreeIds;
+	std::vector<Cell> m_Cells;							// occupied cells only
+	std::vector<std::vector<unsigned int>> m_SpareLists;	// object lists of freed cells, reused by new ones
+	std::unordered_map<CellKey, unsigned int, CellKeyHash> m_CellLookup;
+	size_t m_Count;
+
+public:
+	explicit SpatialGrid(float cellSize = 4.0f);
+
+	// Returns an id that stays valid until Remove()
+	unsigned int Insert(const glm::vec3& position, float radius);
+	void Update(unsigned int id, const glm::vec3& position);
+	void Update(unsigned int id, const glm::vec3& position, float radius);
+	void Remove(unsigned int id);
+	void Clear();
+
+	// Ids of objects whose bounding sphere touches the query volume
+	size_t QueryRadius(const glm::vec3& center, float radius, std::vector<unsigned int>& result) const;
+	size_t QueryBox(const AABB& box, std::vector<unsigned int>& result) const;
+	size_t QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& result) const;
+
+	inline const glm::vec3& GetPosition(unsigned int id) const { return m_Objects[id].Position; }
+	inline float GetRadius(unsigned int id) const { return m_Objects[id].Radius; }
+	inline size_t GetCount() const { return m_Count; }
+	inline size_t GetCellCount() const { return m_Cells.size(); }
+	inline float GetCellSize() const { return m_CellSize; }
+
+private:
+	unsigned int FindOrCreateCell(int64_t x, int64_t y, int64_t z);
+	unsigned int FindCell(int64_t x, int64_t y, int64_t z) const;
+	void Link(unsigned int id, unsigned int cell);
+	void Unlink(unsigned int id);
+	void ReleaseCell(unsigned int cell);
+	void CollectCells(const AABB& box, std::vector<unsigned int>& result, const glm::vec3& center, float radius, bool sphere) const;
+
+	inline int64_t ToCell(float coordinate) const { return static_cast<int64_t>(std::floor(coordinate * m_InvCellSize)); }
+};
+
+struct GridBenchmark {
+	double UpdateMilliseconds;		// moving every object once, per frame
+	double RadiusMilliseconds;		// radius queries per frame
+	double BoxMilliseconds;			// box queries per frame
+	double FrustumMilliseconds;		// frustum queries per frame
+	size_t PeakCells;
+	size_t FinalCells;
+	unsigned int Queries;			// every query of every frame is checked
+	unsigned int Mismatches;		// queries that differ from a brute force search
+};
+
+// Moves objectCount objects on random walks for a number of frames. Every frame runs
+// GRID_RADIUS_QUERIES, GRID_BOX_QUERIES and GRID_FRUSTUM_QUERIES queries centered inside
+// the populated volume and checks each against all objects. Needs the job system.
+const unsigned int GRID_RADIUS_QUERIES = 100;
+const unsigned int GRID_BOX_QUERIES = 100;
+const unsigned int GRID_FRUSTUM_QUERIES = 4;
+GridBenchmark RunGridBenchmark(size_t objectCount, unsigned int frames);
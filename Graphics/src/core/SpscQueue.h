@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two.
+template<typename T, size_t Capacity>
+class SpscQueue {
+private:
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+	enum : size_t { MASK = Capacity - 1 };
+
+	// Kept on separate cache lines, each side writes only its own index
+	std::atomic<size_t> m_Head;		// next slot to read, written by the consumer
+	char m_Padding[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_Tail;		// next slot to write, written by the producer
+	T m_Items[Capacity];
+
+public:
+	SpscQueue() : m_Head(0), m_Tail(0) {}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer only, false when full
+	bool Push(const T& item) {
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) == Capacity) return false;
+		m_Items[tail & MASK] = item;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, false when empty
+	bool Pop(T& item) {
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire)) return false;
+		item = m_Items[head & MASK];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	inline bool IsEmpty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+};
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "TaskGraph.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+TaskGraph::TaskGraph() :
+	m_Frame(0),
+	m_TraceCount(0),
+	m_Epoch(std::chrono::steady_clock::now())
+{
+	for (FrameSlot& slot : m_Slots) {
+		slot.Remaining.store(0);
+		slot.MainRemaining.store(0);
+	}
+}
+
+TaskGraph::~TaskGraph() {
+	Finish();
+}
+
+unsigned int TaskGraph::AddResource(const std::string& name, unsigned int copies) {
+	Resource resource;
+	resource.Name = name;
+	resource.Copies = std::max(1u, copies);
+	resource.First = static_cast<unsigned int>(m_Access.size());
+	m_Access.resize(m_Access.size() + resource.Copies, Access{ InstanceRef{ nullptr, 0 }, std::vector<InstanceRef>() });
+	m_Resources.push_back(resource);
+	return static_cast<unsigned int>(m_Resources.size() - 1);
+}
+
+unsigned int TaskGraph::AddStage(const std::string& name, const StageFunction& function,
+								 std::initializer_list<unsigned int> reads, std::initializer_list<unsigned int> writes,
+								 bool mainThread) {
+	if (m_Frame > 0) {
+		std::cout << "ERROR::TASK_GRAPH::STAGE_ADDED_AFTER_START" << std::endl;
+		return static_cast<unsigned int>(m_Stages.size());
+	}
+	Stage stage;
+	stage.Name = name;
+	stage.Function = function;
+	stage.Reads = reads;
+	stage.Writes = writes;
+	stage.MainThread = mainThread;
+	m_Stages.push_back(stage);
+	m_LastInstance.push_back(InstanceRef{ nullptr, 0 });
+	return static_cast<unsigned int>(m_Stages.size() - 1);
+}
+
+void TaskGraph::Execute() {
+	const uint64_t frame = m_Frame;
+	FrameSlot& slot = m_Slots[frame % MAX_FRAMES_IN_FLIGHT];
+	// The slot still holds frame - MAX_FRAMES_IN_FLIGHT until that one is done
+	WaitUntil([&slot]() { return slot.Remaining.load(std::memory_order_acquire) == 0; });
+	m_Frame++;
+
+	const unsigned int stageCount = static_cast<unsigned int>(m_Stages.size());
+	if (slot.Instances.size() != stageCount) {
+		slot.Instances.clear();
+		for (unsigned int i = 0; i < stageCount; i++) slot.Instances.push_back(std::unique_ptr<Instance>(new Instance()));
+	}
+
+	int mainStages = 0;
+	for (unsigned int i = 0; i < stageCount; i++) {
+		Instance& instance = *slot.Instances[i];
+		instance.Stage = i;
+		instance.Frame = frame;
+		instance.Pending.store(1);
+		instance.Lock.clear();
+		instance.Done = false;
+		instance.Dependents.clear();
+		instance.Dependencies.clear();
+		instance.Thread = -1;
+		instance.Start = instance.End = 0.0;
+		if (m_Stages[i].MainThread) mainStages++;
+	}
+	slot.Remaining.store(stageCount + 1);
+	slot.MainRemaining.store(mainStages);
+
+	// Dependencies in stage order, earlier frames still in flight included
+	for (unsigned int i = 0; i < stageCount; i++) {
+		const Stage& stage = m_Stages[i];
+		Instance& instance = *slot.Instances[i];
+		const InstanceRef self = { &instance, frame };
+
+		// A stage never overlaps itself
+		if (IsLive(m_LastInstance[i], frame)) AddDependency(instance, m_LastInstance[i]);
+		m_LastInstance[i] = self;
+
+		for (unsigned int read : stage.Reads) {
+			const Resource& resource = m_Resources[read];
+			Access& access = m_Access[resource.First + frame % resource.Copies];
+			if (IsLive(access.Writer, frame)) AddDependency(instance, access.Writer);
+			access.Readers.push_back(self);
+		}
+		for (unsigned int write : stage.Writes) {
+			const Resource& resource = m_Resources[write];
+			Access& access = m_Access[resource.First + frame % resource.Copies];
+			if (IsLive(access.Writer, frame)) AddDependency(instance, access.Writer);
+			for (const InstanceRef& reader : access.Readers) {
+				if (reader.Pointer != &instance && IsLive(reader, frame)) AddDependency(instance, reader);
+			}
+			access.Writer = self;
+			access.Readers.clear();
+		}
+	}
+
+	// Drop the setup reference, stages without pending dependencies start here
+	for (unsigned int i = 0; i < stageCount; i++) Release(slot.Instances[i].get());
+
+	WaitUntil([&slot]() { return slot.MainRemaining.load(std::memory_order_acquire) == 0; });
+}
+
+void TaskGraph::Finish() {
+	WaitUntil([this]() {
+		for (const FrameSlot& slot : m_Slots) {
+			if (slot.Remaining.load(std::memory_order_acquire) != 0) return false;
+		}
+		return true;
+	});
+}
+
+void TaskGraph::AddDependency(Instance& instance, const InstanceRef& dependency) {
+	Instance& other = *dependency.Pointer;
+	while (other.Lock.test_and_set(std::memory_order_acquire)) {}
+	if (!other.Done) {
+		// Counted before it is visible to the other stage, which may finish right away
+		instance.Pending.fetch_add(1);
+		other.Dependents.push_back(&instance);
+	}
+	other.Lock.clear(std::memory_order_release);
+
+	// The critical path only follows edges inside a frame
+	if (dependency.Frame == instance.Frame) {
+		if (std::find(instance.Dependencies.begin(), instance.Dependencies.end(), &other) == instance.Dependencies.end()) {
+			instance.Dependencies.push_back(&other);
+		}
+	}
+}
+
+void TaskGraph::Release(Instance* instance) {
+	if (instance->Pending.fetch_sub(1) != 1) return;
+
+	if (m_Stages[instance->Stage].MainThread) {
+		std::lock_guard<std::mutex> lock(m_MainMutex);
+		m_MainQueue.push_back(instance);
+	}
+	else {
+		JobSystem::Get().Run([this, instance]() { RunInstance(instance); });
+	}
+}
+
+void TaskGraph::RunInstance(Instance* instance) {
+	const Stage& stage = m_Stages[instance->Stage];
+	instance->Thread = JobSystem::GetWorkerIndex();
+	instance->Start = Now();
+	{
+		PROFILE_SCOPE(stage.Name.c_str());
+		stage.Function(instance->Frame);
+	}
+	instance->End = Now();
+
+	FrameSlot& slot = m_Slots[instance->Frame % MAX_FRAMES_IN_FLIGHT];
+	if (stage.MainThread) slot.MainRemaining.fetch_sub(1, std::memory_order_release);
+
+	// Once Done is set nobody adds dependents, the list is safe to walk without the lock
+	// and keeps its capacity for the next frame in this slot
+	while (instance->Lock.test_and_set(std::memory_order_acquire)) {}
+	instance->Done = true;
+	instance->Lock.clear(std::memory_order_release);
+	for (Instance* dependent : instance->Dependents) Release(dependent);
+
+	// The last stage of the frame takes the trace before the slot can be reused
+	if (slot.Remaining.fetch_sub(1, std::memory_order_acq_rel) == 2) {
+		CompleteFrame(slot);
+		slot.Remaining.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void TaskGraph::CompleteFrame(FrameSlot& slot) {
+	if (slot.Instances.empty()) return;
+
+	// Walk back from the stage that finished last, always to the dependency that finished last
+	std::vector<bool>& critical = slot.Critical;
+	critical.assign(slot.Instances.size(), false);
+	const Instance* current = nullptr;
+	for (const std::unique_ptr<Instance>& instance : slot.Instances) {
+		if (!current || instance->End > current->End) current = instance.get();
+	}
+	while (current) {
+		critical[current->Stage] = true;
+		const Instance* next = nullptr;
+		for (const Instance* dependency : current->Dependencies) {
+			if (!next || dependency->End > next->End) next = dependency;
+		}
+		current = next;
+	}
+
+	std::lock_guard<std::mutex> lock(m_TraceMutex);
+	TraceFrame& trace = m_Trace[m_TraceCount % TRACE_FRAMES];
+	m_TraceCount++;
+	trace.Frame = slot.Instances[0]->Frame;
+	trace.Events.clear();
+	for (const std::unique_ptr<Instance>& instance : slot.Instances) {
+		trace.Events.push_back(TraceEvent{ instance->Stage, instance->Thread, instance->Start, instance->End, critical[instance->Stage] });
+	}
+}
+
+template<typename Predicate>
+void TaskGraph::WaitUntil(Predicate done) {
+	while (!done()) {
+		Instance* instance = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(m_MainMutex);
+			if (!m_MainQueue.empty()) {
+				instance = m_MainQueue.front();
+				m_MainQueue.erase(m_MainQueue.begin());
+			}
+		}
+		if (instance) RunInstance(instance);
+		else if (!JobSystem::Get().Help()) std::this_thread::yield();
+	}
+}
+
+double TaskGraph::Now() const {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Epoch).count();
+}
+
+bool TaskGraph::WriteTrace(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERROR::TASK_GRAPH::TRACE_NOT_WRITTEN " << path << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_TraceMutex);
+	const uint64_t count = std::min<uint64_t>(m_TraceCount, TRACE_FRAMES);
+	std::vector<int> threads;
+	// Row 0 holds the frames, row 1 outside threads (index -1), workers follow
+	const auto row = [](int thread) { return thread + 2; };
+
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (uint64_t k = m_TraceCount - count; k < m_TraceCount; k++) {
+		const TraceFrame& trace = m_Trace[k % TRACE_FRAMES];
+		double begin = 0.0, end = 0.0, busy = 0.0, critical = 0.0;
+		for (size_t i = 0; i < trace.Events.size(); i++) {
+			const TraceEvent& event = trace.Events[i];
+			if (i == 0 || event.Start < begin) begin = event.Start;
+			end = std::max(end, event.End);
+			busy += event.End - event.Start;
+			if (event.Critical) critical += event.End - event.Start;
+			if (std::find(threads.begin(), threads.end(), event.Thread) == threads.end()) threads.push_back(event.Thread);
+
+			file << (first ? "" : ",\n") << "{\"name\":\"" << m_Stages[event.Stage].Name << "\",\"cat\":\"stage\",\"ph\":\"X\""
+				<< ",\"ts\":" << event.Start << ",\"dur\":" << event.End - event.Start
+				<< ",\"pid\":0,\"tid\":" << row(event.Thread)
+				<< (event.Critical ? ",\"cname\":\"terrible\"" : "")
+				<< ",\"args\":{\"frame\":" << trace.Frame << ",\"critical\":" << (event.Critical ? "true" : "false") << "}}";
+			first = false;
+		}
+
+		// Frame span on a row of its own; idle is the share of worker time in it spent on no stage
+		const double span = end - begin;
+		const unsigned int workers = JobSystem::Get().GetWorkerCount();
+		const double idle = span > 0.0 ? std::max(0.0, 1.0 - busy / (span * workers)) : 0.0;
+		file << (first ? "" : ",\n") << "{\"name\":\"frame " << trace.Frame << "\",\"cat\":\"frame\",\"ph\":\"X\""
+			<< ",\"ts\":" << begin << ",\"dur\":" << span << ",\"pid\":0,\"tid\":0"
+			<< ",\"args\":{\"critical_path_us\":" << critical << ",\"busy_us\":" << busy << ",\"idle\":" << idle << "}}";
+		first = false;
+	}
+
+	file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"frames\"}}";
+	for (int thread : threads) {
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << row(thread) << ",\"args\":{\"name\":\"";
+		if (thread < 0) file << "outside thread";
+		else if (thread == 0) file << "main (worker 0)";
+		else file << "worker " << thread;
+		file << "\"}}";
+	}
+	file << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Frame loop as stages that declare which data they read and write. Dependencies follow
+// from the declarations in stage order, across frame boundaries too: a stage waits for
+// the latest earlier writer of what it reads, and for the readers and writer before it of
+// what it writes. Independent stages run in parallel on the job system and up to
+// MAX_FRAMES_IN_FLIGHT frames overlap. Data with one copy per frame in flight does not
+// make consecutive frames wait on each other. Stage timings of recent frames can be saved
+// as a Chrome trace (chrome://tracing, Perfetto) with each frame's critical path marked.
+class TaskGraph {
+public:
+	enum : unsigned int { MAX_FRAMES_IN_FLIGHT = 2, TRACE_FRAMES = 64 };
+
+	typedef std::function<void(uint64_t frame)> StageFunction;
+
+private:
+	struct Stage {
+		std::string Name;
+		StageFunction Function;
+		std::vector<unsigned int> Reads;
+		std::vector<unsigned int> Writes;
+		bool MainThread;
+	};
+
+	struct Resource {
+		std::string Name;
+		unsigned int Copies;
+		unsigned int First;		// first entry in m_Access
+	};
+
+	struct Instance {
+		unsigned int Stage;
+		uint64_t Frame;
+		std::atomic<int> Pending;		// dependencies not done yet, plus one while being set up
+		std::atomic_flag Lock;
+		bool Done;
+		std::vector<Instance*> Dependents;
+		std::vector<Instance*> Dependencies;	// of the same frame, for the critical path
+		int Thread;
+		double Start;
+		double End;
+	};
+
+	struct InstanceRef {
+		Instance* Pointer;
+		uint64_t Frame;
+	};
+
+	// Who touched one copy of a resource last, in stage order
+	struct Access {
+		InstanceRef Writer;
+		std::vector<InstanceRef> Readers;
+	};
+
+	struct FrameSlot {
+		std::vector<std::unique_ptr<Instance>> Instances;
+		std::atomic<int> Remaining;		// stages left, plus one until the trace is taken
+		std::atomic<int> MainRemaining;
+		std::vector<bool> Critical;		// per stage, scratch for the critical path
+	};
+
+	struct TraceEvent {
+		unsigned int Stage;
+		int Thread;
+		double Start;
+		double End;
+		bool Critical;
+	};
+
+	struct TraceFrame {
+		uint64_t Frame;
+		std::vector<TraceEvent> Events;
+	};
+
+	std::vector<Stage> m_Stages;
+	std::vector<Resource> m_Resources;
+	std::vector<Access> m_Access;
+	std::vector<InstanceRef> m_LastInstance;	// per stage
+	FrameSlot m_Slots[MAX_FRAMES_IN_FLIGHT];
+	uint64_t m_Frame;
+
+	std::mutex m_MainMutex;
+	std::vector<Instance*> m_MainQueue;		// ready stages that must run on the thread calling Execute
+
+	mutable std::mutex m_TraceMutex;
+	TraceFrame m_Trace[TRACE_FRAMES];
+	uint64_t m_TraceCount;
+	std::chrono::steady_clock::time_point m_Epoch;
+
+public:
+	TaskGraph();
+	~TaskGraph();
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	// copies > 1 gives frame f copy f % copies, index your data the same way
+	unsigned int AddResource(const std::string& name, unsigned int copies = 1);
+	// Stages run in the order they are added wherever the data they share asks for it.
+	// Main thread stages run on the thread calling Execute, e.g. for window events.
+	unsigned int AddStage(const std::string& name, const StageFunction& function,
+						  std::initializer_list<unsigned int> reads, std::initializer_list<unsigned int> writes,
+						  bool mainThread = false);
+
+	// Starts the next frame once the frame MAX_FRAMES_IN_FLIGHT back is done, returns when
+	// its main thread stages have run. The calling thread helps with jobs while it waits.
+	void Execute();
+	// Waits for every started frame
+	void Finish();
+
+	// Recent frames, the most recent TRACE_FRAMES at most
+	bool WriteTrace(const std::string& path) const;
+	inline uint64_t GetFrame() const { return m_Frame; }
+
+private:
+	void AddDependency(Instance& instance, const InstanceRef& dependency);
+	void Release(Instance* instance);
+	void RunInstance(Instance* instance);
+	void CompleteFrame(FrameSlot& slot);
+	template<typename Predicate>
+	void WaitUntil(Predicate done);
+	// Older instances are done, and their slots may already hold a newer frame
+	static inline bool IsLive(const InstanceRef& ref, uint64_t frame) { return ref.Pointer && ref.Frame + MAX_FRAMES_IN_FLIGHT > frame; }
+	double Now() const;
+};
@@ -1,44 +1,119 @@
 #include <iostream>
 
 #include "Texture.h"
+#include "ReleaseQueue.h"
 #include "stb_image/stb_image.h"
 
-Texture::Texture(const std::string& path) :
+Texture::Texture(const std::string& path, const TextureParams& params) :
 	m_FilePath(path),
 	m_LocalBuffer(nullptr),
 	m_Width(0),
 	m_Height(0),
-	m_Channel (0)
+	m_Channel (0),
+	m_InternalFormat(0)
 {
-	stbi_set_flip_vertically_on_load(1);
-	m_LocalBuffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_Channel, 4);
+	stbi_set_flip_vertically_on_load(params.FlipVertically);
+	m_LocalBuffer = stbi_load(path.c_str(), &m_Width, &m_Height, &m_Channel, 0);
+	Upload(params);
+}
+
+Texture::Texture(const unsigned char* data, int size, const std::string& name, const TextureParams& params) :
+	m_FilePath(name),
+	m_LocalBuffer(nullptr),
+	m_Width(0),
+	m_Height(0),
+	m_Channel(0),
+	m_InternalFormat(0)
+{
+	stbi_set_flip_vertically_on_load(params.FlipVertically);
+	m_LocalBuffer = stbi_load_from_memory(data, size, &m_Width, &m_Height, &m_Channel, 0);
+	Upload(params);
+}
+
+Texture::~Texture() {
+	ReleaseQueue::Get().ReleaseTexture(m_RendererID, m_InternalFormat, m_Width, m_Height);
+}
+
+Texture::Texture(Texture&& other) noexcept :
+	m_RendererID(other.m_RendererID),
+	m_FilePath(std::move(other.m_FilePath)),
+	m_LocalBuffer(nullptr),
+	m_Width(other.m_Width),
+	m_Height(other.m_Height),
+	m_Channel(other.m_Channel),
+	m_InternalFormat(other.m_InternalFormat)
+{
+	other.m_RendererID = 0;
+}
 
-	glGenTextures(1, &m_RendererID);
+Texture& Texture::operator=(Texture&& other) noexcept {
+	if (this != &other) {
+		ReleaseQueue::Get().ReleaseTexture(m_RendererID, m_InternalFormat, m_Width, m_Height);
+		m_RendererID = other.m_RendererID;
+		m_FilePath = std::move(other.m_FilePath);
+		m_Width = other.m_Width;
+		m_Height = other.m_Height;
+		m_Channel = other.m_Channel;
+		m_InternalFormat = other.m_InternalFormat;
+		other.m_RendererID = 0;
+	}
+	return *this;
+}
+
+void Texture::Upload(const TextureParams& params) {
+	// Keep the channel count of the source image instead of expanding everything to RGBA
+	unsigned int format;
+	switch (m_Channel) {
+		case 1:  format = GL_RED;  m_InternalFormat = GL_R8; break;
+		case 2:  format = GL_RG;   m_InternalFormat = GL_RG8; break;
+		case 3:  format = GL_RGB;  m_InternalFormat = params.SRGB ? GL_SRGB8 : GL_RGB8; break;
+		default: format = GL_RGBA; m_InternalFormat = params.SRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8; break;
+	}
+
+	// A recycled texture of the same format and size only needs its contents replaced
+	m_RendererID = ReleaseQueue::Get().AcquireTexture(m_InternalFormat, m_Width, m_Height);
+	const bool recycled = m_RendererID != 0;
+	if (!recycled) glGenTextures(1, &m_RendererID);
 	glBindTexture(GL_TEXTURE_2D, m_RendererID);
 	
 	// Texture Filtering Parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, params.MinFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, params.MagFilter);
 	
 	// Texture Wrapping Parameters 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, params.WrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, params.WrapT);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_LocalBuffer);
+	// Swizzle so shaders still see grey / grey + alpha the way an RGBA upload would present it.
+	// Always set, a recycled texture may carry the swizzle of its previous owner.
+	int swizzle[] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+	if (m_Channel == 1) {
+		swizzle[1] = GL_RED; swizzle[2] = GL_RED; swizzle[3] = GL_ONE;
+	}
+	else if (m_Channel == 2) {
+		swizzle[1] = GL_RED; swizzle[2] = GL_RED; swizzle[3] = GL_GREEN;
+	}
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+
+	// Rows of 1 and 3 channel images are not 4 byte aligned in general
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Without pixels a recycled texture is re-specified empty, not left with its previous image
+	if (recycled && m_LocalBuffer)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, format, GL_UNSIGNED_BYTE, m_LocalBuffer);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, m_InternalFormat, m_Width, m_Height, 0, format, GL_UNSIGNED_BYTE, m_LocalBuffer);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 	glBindTexture(GL_TEXTURE_2D, 0);
 
 	if (m_LocalBuffer) {
 		stbi_image_free(m_LocalBuffer);
+		m_LocalBuffer = nullptr;
 		std::cout << "TEXTURE::LOADED_SUCCESSFUL" << std::endl;
 	}
 	else
 		std::cout << "ERROR::TEXTURE::LOADED_FAILED" << std::endl;
 }
 
-Texture::~Texture() {
-	glDeleteTextures(1, &m_RendererID);
-}
-
 void Texture::Bind(unsigned int slot) const {
 	glActiveTexture(GL_TEXTURE0 + slot);
 	glBindTexture(GL_TEXTURE_2D, m_RendererID);
@@ -46,4 +121,4 @@ void Texture::Bind(unsigned int slot) const {
 
 void Texture::Unbind() const {
 	glBindTexture(GL_TEXTURE_2D, 0);
-}
\ No newline at end of file
+}
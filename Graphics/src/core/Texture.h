@@ -2,6 +2,24 @@
 
 #include "Renderer.h"
 
+// Sampling state a texture is created with. Part of the TextureCache key, so the
+// same image requested with different parameters yields distinct GL objects.
+struct TextureParams {
+	int MinFilter = GL_LINEAR;
+	int MagFilter = GL_LINEAR;
+	int WrapS = GL_CLAMP_TO_EDGE;
+	int WrapT = GL_CLAMP_TO_EDGE;
+	bool FlipVertically = true;
+	// Color data authored in sRGB, sampled back as linear. Ignored for one and two channel images
+	bool SRGB = false;
+
+	bool operator==(const TextureParams& other) const {
+		return MinFilter == other.MinFilter && MagFilter == other.MagFilter &&
+			WrapS == other.WrapS && WrapT == other.WrapT && FlipVertically == other.FlipVertically &&
+			SRGB == other.SRGB;
+	}
+};
+
 class Texture {
 private:
 	unsigned int m_RendererID;
@@ -10,15 +28,29 @@ private:
 	int m_Width;
 	int m_Height;
 	int m_Channel;
+	unsigned int m_InternalFormat;
 	
 public:
-	Texture(const std::string& path);
+	Texture(const std::string& path, const TextureParams& params = TextureParams());
+	// Decodes an already loaded image file (png, jpg, ...) held in memory
+	Texture(const unsigned char* data, int size, const std::string& name, const TextureParams& params = TextureParams());
 	~Texture();
 
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+	Texture(Texture&& other) noexcept;
+	Texture& operator=(Texture&& other) noexcept;
+
 	void Bind(unsigned int slot = 0) const;
 	void Unbind() const;
 
 	inline int GetWidth() const { return m_Width; }
 	inline int GetHeight() const { return m_Height; }
+	inline int GetChannels() const { return m_Channel; }
+	inline unsigned int GetInternalFormat() const { return m_InternalFormat; }
+	inline const std::string& GetFilePath() const { return m_FilePath; }
+	inline unsigned int GetRendererID() const { return m_RendererID; }
 
-};
\ No newline at end of file
+private:
+	void Upload(const TextureParams& params);
+};
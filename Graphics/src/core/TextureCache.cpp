@@ -0,0 +1,135 @@
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "TextureCache.h"
+
+TextureCache::TextureCache(unsigned int retainFrames) :
+	m_TexturePool(std::make_shared<Pool<Texture>>()),
+	m_Count(0),
+	m_RetainFrames(retainFrames)
+{
+}
+
+TextureCache::~TextureCache() {
+	Clear();
+}
+
+std::shared_ptr<Texture> TextureCache::Acquire(const std::string& path, const TextureParams& params) {
+	// Fast path, this exact request was already served
+	const uint64_t paramsKey = HashParams(params);
+	auto pathIt = m_PathKeys.find(PathKey{ path.c_str(), path.size(), paramsKey });
+	if (pathIt != m_PathKeys.end()) {
+		for (Entry& entry : m_Entries[pathIt->second.contentKey]) {
+			if (entry.texture.get() != pathIt->second.texture) continue;
+			entry.idleFrames = 0;
+			return entry.texture;
+		}
+	}
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cout << "ERROR::TEXTURE_CACHE::FILE_NOT_FOUND " << path << std::endl;
+		return nullptr;
+	}
+	std::vector<unsigned char> bytes(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+	// Different path, same contents: reuse the texture already uploaded. Files that merely
+	// share the hash sit next to each other in its bucket.
+	const uint64_t contentKey = HashBytes(bytes.data(), bytes.size(), paramsKey);
+	std::vector<Entry>& bucket = m_Entries[contentKey];
+	for (Entry& entry : bucket) {
+		if (!FileHolds(entry.path, bytes)) continue;
+		AddPath(path, paramsKey, contentKey, entry.texture.get());
+		entry.idleFrames = 0;
+		return entry.texture;
+	}
+
+	std::shared_ptr<Pool<Texture>> pool = m_TexturePool;
+	std::shared_ptr<Texture> texture(pool->New(bytes.data(), static_cast<int>(bytes.size()), path, params),
+									 [pool](Texture* object) { pool->Delete(object); });
+	AddPath(path, paramsKey, contentKey, texture.get());
+	bucket.push_back(Entry{ texture, path, 0 });
+	m_Count++;
+	return texture;
+}
+
+void TextureCache::Collect() {
+	for (auto it = m_Entries.begin(); it != m_Entries.end();) {
+		std::vector<Entry>& bucket = it->second;
+		for (size_t i = 0; i < bucket.size();) {
+			Entry& entry = bucket[i];
+			if (entry.texture.use_count() > 1) {
+				entry.idleFrames = 0;
+				i++;
+				continue;
+			}
+			if (++entry.idleFrames <= m_RetainFrames) {
+				i++;
+				continue;
+			}
+			// Forget every path that resolved to this texture before destroying it
+			for (auto pathIt = m_PathKeys.begin(); pathIt != m_PathKeys.end();) {
+				if (pathIt->second.texture == entry.texture.get()) pathIt = m_PathKeys.erase(pathIt);
+				else ++pathIt;
+			}
+			bucket.erase(bucket.begin() + i);
+			m_Count--;
+		}
+		if (bucket.empty()) it = m_Entries.erase(it);
+		else ++it;
+	}
+}
+
+void TextureCache::Clear() {
+	m_Entries.clear();
+	m_PathKeys.clear();
+	m_Count = 0;
+}
+
+uint64_t TextureCache::HashBytes(const unsigned char* data, size_t size, uint64_t seed) {
+	// 64-bit FNV-1a
+	uint64_t hash = 14695981039346656037ull ^ seed;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t TextureCache::HashParams(const TextureParams& params) {
+	const int fields[] = { params.MinFilter, params.MagFilter, params.WrapS, params.WrapT, params.FlipVertically ? 1 : 0, params.SRGB ? 1 : 0 };
+	return HashBytes(reinterpret_cast<const unsigned char*>(fields), sizeof(fields), 0);
+}
+
+bool TextureCache::FileHolds(const std::string& path, const std::vector<unsigned char>& bytes) {
+	// Only reached on a hash hit, a file changed since it was decoded counts as different
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file || static_cast<size_t>(file.tellg()) != bytes.size()) return false;
+	std::vector<unsigned char> contents(bytes.size());
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+	return file && contents == bytes;
+}
+
+void TextureCache::AddPath(const std::string& path, uint64_t params, uint64_t contentKey, const Texture* texture) {
+	PathEntry entry;
+	entry.path.reset(new char[path.size() + 1]);
+	std::memcpy(entry.path.get(), path.c_str(), path.size() + 1);
+	entry.contentKey = contentKey;
+	entry.texture = texture;
+
+	const PathKey key = { entry.path.get(), path.size(), params };
+	m_PathKeys.emplace(key, std::move(entry));
+}
+
+size_t TextureCache::PathKeyHash::operator()(const PathKey& key) const {
+	return static_cast<size_t>(HashBytes(reinterpret_cast<const unsigned char*>(key.path), key.length, key.params));
+}
+
+bool TextureCache::PathKeyEqual::operator()(const PathKey& a, const PathKey& b) const {
+	return a.params == b.params && a.length == b.length && std::memcmp(a.path, b.path, a.length) == 0;
+}
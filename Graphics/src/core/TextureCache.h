@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Texture.h"
+#include "PoolAllocator.h"
+
+// Shares Texture objects between everyone that asks for the same image.
+// Lookups go through the path first and then through a hash of the file contents,
+// so copies of one image stored under different paths are decoded and uploaded once.
+// A hash match only counts when the file it was decoded from still holds the same bytes;
+// that file is read again on a hit, so no encoded data stays resident.
+// Textures nobody references anymore stay resident for a few Collect() calls
+// before being destroyed, which keeps briefly released materials from reloading.
+// The Texture objects themselves come from a pool, so evicting and reloading reuses their
+// blocks; every handle keeps the pool alive and may outlive the cache.
+class TextureCache {
+private:
+	struct Entry {
+		std::shared_ptr<Texture> texture;
+		std::string path;		// file the texture was decoded from, to tell hash collisions apart
+		unsigned int idleFrames;
+	};
+
+	struct PathKey {
+		const char* path;
+		size_t length;
+		uint64_t params;
+	};
+	struct PathKeyHash {
+		size_t operator()(const PathKey& key) const;
+	};
+	struct PathKeyEqual {
+		bool operator()(const PathKey& a, const PathKey& b) const;
+	};
+	struct PathEntry {
+		std::unique_ptr<char[]> path;		// storage PathKey::path points into, never moves
+		uint64_t contentKey;
+		const Texture* texture;				// which entry of the bucket
+	};
+
+	std::unordered_map<uint64_t, std::vector<Entry>> m_Entries;					// content key -> textures sharing it
+	std::unordered_map<PathKey, PathEntry, PathKeyHash, PathKeyEqual> m_PathKeys;	// path and params -> entry
+	std::shared_ptr<Pool<Texture>> m_TexturePool;
+	size_t m_Count;
+	unsigned int m_RetainFrames;
+
+public:
+	explicit TextureCache(unsigned int retainFrames = 3);
+	~TextureCache();
+
+	// Returns nullptr when the file cannot be read
+	std::shared_ptr<Texture> Acquire(const std::string& path, const TextureParams& params = TextureParams());
+
+	// Call once per frame, destroys textures that have been unreferenced for more than retainFrames calls
+	void Collect();
+	// Drops every texture the cache owns, handles held elsewhere stay valid
+	void Clear();
+
+	inline size_t GetCount() const { return m_Count; }
+	inline PoolStats GetPoolStats() const { return m_TexturePool->GetStats(); }
+
+private:
+	void AddPath(const std::string& path, uint64_t params, uint64_t contentKey, const Texture* texture);
+	static bool FileHolds(const std::string& path, const std::vector<unsigned char>& bytes);
+
+	static uint64_t HashBytes(const unsigned char* data, size_t size, uint64_t seed);
+	static uint64_t HashParams(const TextureParams& params);
+};
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <random>
+
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
+#include "gtc/matrix_transform.hpp"
+
+namespace {
+	// Depths smaller than this are not worth splitting into jobs
+	const unsigned int PARALLEL_UPDATE_THRESHOLD = 8192;
+
+	inline glm::mat4 ComposeTRS(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		glm::mat3 r = glm::mat3_cast(rotation);
+		return glm::mat4(
+			glm::vec4(r[0] * scale.x, 0.0f),
+			glm::vec4(r[1] * scale.y, 0.0f),
+			glm::vec4(r[2] * scale.z, 0.0f),
+			glm::vec4(position, 1.0f));
+	}
+}
+
+TransformHierarchy::TransformHierarchy() :
+	m_TopologyDirty(false),
+	m_AnyDirty(false),
+	m_ChangedFirst(NONE),
+	m_ChangedLast(0)
+{
+}
+
+unsigned int TransformHierarchy::Create(unsigned int parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	const unsigned int id = static_cast<unsigned int>(m_Id.size());
+	if (parent != NONE && parent >= id) {
+		std::cout << "ERROR::TRANSFORM_HIERARCHY::INVALID_PARENT" << std::endl;
+		parent = NONE;
+	}
+
+	// Appended unsorted, the next Update puts it at its depth
+	m_Index.push_back(id);
+	m_ParentId.push_back(parent);
+	m_Depth.push_back(parent == NONE ? 0 : m_Depth[parent] + 1);
+	m_Id.push_back(id);
+	m_Parent.push_back(parent == NONE ? NONE : m_Index[parent]);
+	m_Position.push_back(position);
+	m_Rotation.push_back(rotation);
+	m_Scale.push_back(scale);
+	m_World.push_back(glm::mat4(1.0f));
+	m_Dirty.push_back(1);
+	m_TopologyDirty = m_AnyDirty = true;
+	return id;
+}
+
+void TransformHierarchy::SetParent(unsigned int id, unsigned int parent) {
+	for (unsigned int ancestor = parent; ancestor != NONE; ancestor = m_ParentId[ancestor]) {
+		if (ancestor == id) {
+			std::cout << "ERROR::TRANSFORM_HIERARCHY::CYCLE" << std::endl;
+			return;
+		}
+	}
+	m_ParentId[id] = parent;
+	m_Dirty[m_Index[id]] = 1;
+	m_TopologyDirty = m_AnyDirty = true;
+}
+
+void TransformHierarchy::SetLocal(unsigned int id, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+	const unsigned int i = m_Index[id];
+	m_Position[i] = position;
+	m_Rotation[i] = rotation;
+	m_Scale[i] = scale;
+	MarkDirty(i);
+}
+
+void TransformHierarchy::Clear() {
+	m_Index.clear();
+	m_ParentId.clear();
+	m_Depth.clear();
+	m_Id.clear();
+	m_Parent.clear();
+	m_Position.clear();
+	m_Rotation.clear();
+	m_Scale.clear();
+	m_World.clear();
+	m_Dirty.clear();
+	m_DepthStart.clear();
+	m_TopologyDirty = m_AnyDirty = false;
+	m_ChangedFirst = NONE;
+	m_ChangedLast = 0;
+}
+
+void TransformHierarchy::Rebuild() {
+	const unsigned int count = static_cast<unsigned int>(m_Id.size());
+
+	// Depths change for whole subtrees on reparenting, resolve them from the roots down
+	std::vector<unsigned char> known(count, 0);
+	std::vector<unsigned int> chain;
+	for (unsigned int id = 0; id < count; id++) {
+		unsigned int node = id;
+		while (node != NONE && !known[node]) { chain.push_back(node); node = m_ParentId[node]; }
+		unsigned int depth = node == NONE ? 0 : m_Depth[node] + 1;
+		for (size_t i = chain.size(); i-- > 0; depth++) {
+			m_Depth[chain[i]] = depth;
+			known[chain[i]] = 1;
+		}
+		chain.clear();
+	}
+
+	// Stable counting sort by depth
+	unsigned int maxDepth = 0;
+	for (unsigned int depth : m_Depth) maxDepth = std::max(maxDepth, depth);
+	m_DepthStart.assign(maxDepth + 2, 0);
+	for (unsigned int depth : m_Depth) m_DepthStart[depth + 1]++;
+	for (unsigned int depth = 0; depth <= maxDepth; depth++) m_DepthStart[depth + 1] += m_DepthStart[depth];
+
+	std::vector<unsigned int> order(count);
+	std::vector<unsigned int> fill(m_DepthStart.begin(), m_DepthStart.end() - 1);
+	for (unsigned int id = 0; id < count; id++) order[fill[m_Depth[id]]++] = id;
+
+	std::vector<unsigned int> parent(count);
+	std::vector<glm::vec3> position(count);
+	std::vector<glm::quat> rotation(count);
+	std::vector<glm::vec3> scale(count);
+	std::vector<glm::mat4> world(count);
+	std::vector<unsigned char> dirty(count);
+	std::vector<unsigned int> index(count);
+	for (unsigned int i = 0; i < count; i++) index[order[i]] = i;
+	for (unsigned int i = 0; i < count; i++) {
+		const unsigned int old = m_Index[order[i]];
+		const unsigned int parentId = m_ParentId[order[i]];
+		parent[i] = parentId == NONE ? NONE : index[parentId];
+		position[i] = m_Position[old];
+		rotation[i] = m_Rotation[old];
+		scale[i] = m_Scale[old];
+		world[i] = m_World[old];
+		dirty[i] = m_Dirty[old];
+	}
+
+	m_Id.swap(order);
+	m_Index.swap(index);
+	m_Parent.swap(parent);
+	m_Position.swap(position);
+	m_Rotation.swap(rotation);
+	m_Scale.swap(scale);
+	m_World.swap(world);
+	m_Dirty.swap(dirty);
+	m_TopologyDirty = false;
+}
+
+size_t TransformHierarchy::Update(glm::mat4* instances) {
+	m_ChangedFirst = NONE;
+	m_ChangedLast = 0;
+	if (!m_AnyDirty) return 0;
+	if (m_TopologyDirty) Rebuild();
+
+	size_t changed = 0;
+	const unsigned int depthCount = static_cast<unsigned int>(m_DepthStart.size()) - 1;
+	for (unsigned int depth = 0; depth < depthCount; depth++) {
+		const unsigned int begin = m_DepthStart[depth], end = m_DepthStart[depth + 1];
+		const unsigned int size = end - begin;
+
+		if (size < PARALLEL_UPDATE_THRESHOLD || JobSystem::Get().GetWorkerCount() == 1) {
+			UpdateRange(begin, end, instances, m_ChangedFirst, m_ChangedLast, changed);
+		}
+		else {
+			// Nodes of one depth only read their parents, which are all done already
+			std::mutex merge;
+			JobSystem::Get().ParallelFor(begin, end, [&](size_t first, size_t last) {
+				unsigned int changedFirst = NONE, changedLast = 0;
+				size_t count = 0;
+				UpdateRange(static_cast<unsigned int>(first), static_cast<unsigned int>(last), instances, changedFirst, changedLast, count);
+				std::lock_guard<std::mutex> lock(merge);
+				changed += count;
+				m_ChangedFirst = std::min(m_ChangedFirst, changedFirst);
+				m_ChangedLast = std::max(m_ChangedLast, changedLast);
+			}, PARALLEL_UPDATE_THRESHOLD / 4);
+		}
+
+		// Children of this depth are done with the flags of the previous one
+		if (depth > 0) std::memset(&m_Dirty[m_DepthStart[depth - 1]], 0, m_DepthStart[depth] - m_DepthStart[depth - 1]);
+	}
+	if (depthCount > 0) std::memset(&m_Dirty[m_DepthStart[depthCount - 1]], 0, m_DepthStart[depthCount] - m_DepthStart[depthCount - 1]);
+
+	m_AnyDirty = false;
+	return changed;
+}
+
+void TransformHierarchy::UpdateRange(unsigned int begin, unsigned int end, glm::mat4* instances, unsigned int& first, unsigned int& last, size_t& changed) {
+	for (unsigned int i = begin; i < end; i++) {
+		const unsigned int parent = m_Parent[i];
+		// A moved parent moves the whole subtree, flags spread one depth per sweep
+		if (parent != NONE && m_Dirty[parent]) m_Dirty[i] = 1;
+		if (!m_Dirty[i]) continue;
+
+		glm::mat4 world = ComposeTRS(m_Position[i], m_Rotation[i], m_Scale[i]);
+		if (parent != NONE) world = m_World[parent] * world;
+		m_World[i] = world;
+
+		const unsigned int id = m_Id[i];
+		if (instances) instances[id] = world;
+		first = std::min(first, id);
+		last = std::max(last, id);
+		changed++;
+	}
+}
+
+bool TransformHierarchy::GetChangedRange(unsigned int& first, unsigned int& count) const {
+	if (m_ChangedFirst == NONE) return false;
+	first = m_ChangedFirst;
+	count = m_ChangedLast - m_ChangedFirst + 1;
+	return true;
+}
+
+unsigned int RunHierarchyTest() {
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> position(-2.0f, 2.0f), scale(0.8f, 1.25f), angle(-3.14159f, 3.14159f), axis(-1.0f, 1.0f);
+	auto randomRotation = [&]() {
+		const glm::vec3 direction(axis(random), axis(random), axis(random) + 2.0f);
+		return glm::angleAxis(angle(random), glm::normalize(direction));
+	};
+
+	// 64 roots, a wide first depth that Update splits into jobs, then random parents further down
+	const unsigned int roots = 64, wide = 16384, deep = 16384;
+	TransformHierarchy hierarchy;
+	for (unsigned int i = 0; i < roots + wide + deep; i++) {
+		unsigned int parent = TransformHierarchy::NONE;
+		if (i >= roots + wide) parent = std::uniform_int_distribution<unsigned int>(0, i - 1)(random);
+		else if (i >= roots) parent = i % roots;
+		hierarchy.Create(parent, glm::vec3(position(random), position(random), position(random)), randomRotation(),
+						 glm::vec3(scale(random), scale(random), scale(random)));
+	}
+	const unsigned int count = static_cast<unsigned int>(hierarchy.GetCount());
+
+	unsigned int failures = 0;
+	auto fail = [&failures](const char* what, size_t value) {
+		std::cout << "ERROR::HIERARCHY_TEST::" << what << " " << value << std::endl;
+		failures++;
+	};
+	// World matrices composed the plain way, parents resolved on demand
+	auto compare = [&](const char* step) {
+		std::vector<glm::mat4> expected(count);
+		std::vector<unsigned char> known(count, 0);
+		std::vector<unsigned int> chain;
+		unsigned int mismatches = 0;
+		for (unsigned int id = 0; id < count; id++) {
+			for (unsigned int node = id; node != TransformHierarchy::NONE && !known[node]; node = hierarchy.GetParent(node)) chain.push_back(node);
+			for (size_t i = chain.size(); i-- > 0;) {
+				const unsigned int node = chain[i], parent = hierarchy.GetParent(node);
+				const glm::mat4 local = glm::translate(glm::mat4(1.0f), hierarchy.GetPosition(node)) * glm::mat4_cast(hierarchy.GetRotation(node))
+					* glm::scale(glm::mat4(1.0f), hierarchy.GetScale(node));
+				expected[node] = parent == TransformHierarchy::NONE ? local : expected[parent] * local;
+				known[node] = 1;
+			}
+			chain.clear();
+
+			const glm::mat4& world = hierarchy.GetWorldMatrix(id);
+			bool close = true;
+			for (int c = 0; c < 4; c++) {
+				for (int r = 0; r < 4; r++) close = close && std::abs(world[c][r] - expected[id][c][r]) <= 1e-4f * (1.0f + std::abs(expected[id][c][r]));
+			}
+			if (!close) mismatches++;
+		}
+		if (mismatches > 0) {
+			std::cout << "ERROR::HIERARCHY_TEST::WORLD_MISMATCH " << mismatches << " nodes " << step << std::endl;
+			failures++;
+		}
+	};
+	// Nodes that are, or descend from, a marked node
+	auto subtrees = [&](const std::vector<unsigned char>& marked) {
+		std::vector<unsigned char> inside(count, 0);
+		for (unsigned int id = 0; id < count; id++) {
+			for (unsigned int node = id; node != TransformHierarchy::NONE; node = hierarchy.GetParent(node)) {
+				if (marked[node]) { inside[id] = 1; break; }
+			}
+		}
+		return inside;
+	};
+	// Only the expected nodes may be reported, counted and written to the instance buffer
+	auto updateExpecting = [&](const std::vector<unsigned char>& inside, const char* step) {
+		std::vector<glm::mat4> instances(count, glm::mat4(0.0f));
+		const size_t changed = hierarchy.Update(instances.data());
+		size_t expectedChanged = 0;
+		unsigned int first = count, last = 0, wrongWrites = 0;
+		for (unsigned int id = 0; id < count; id++) {
+			if (inside[id]) {
+				expectedChanged++;
+				first = std::min(first, id);
+				last = std::max(last, id);
+				if (instances[id] != hierarchy.GetWorldMatrix(id)) wrongWrites++;
+			}
+			else if (instances[id] != glm::mat4(0.0f)) wrongWrites++;
+		}
+		if (changed != expectedChanged) fail("CHANGED_COUNT", changed);
+		if (wrongWrites > 0) fail("INSTANCE_WRITES", wrongWrites);
+		unsigned int rangeFirst = 0, rangeCount = 0;
+		if (hierarchy.GetChangedRange(rangeFirst, rangeCount) != (expectedChanged > 0) || (expectedChanged > 0 && (rangeFirst != first || rangeFirst + rangeCount != last + 1))) {
+			fail("CHANGED_RANGE", rangeFirst);
+		}
+		compare(step);
+	};
+	auto expectClean = [&]() {
+		if (hierarchy.Update() != 0) fail("CLEAN_UPDATE_CHANGED", 1);
+		unsigned int first, rangeCount;
+		if (hierarchy.GetChangedRange(first, rangeCount)) fail("CLEAN_UPDATE_RANGE", first);
+	};
+
+	updateExpecting(std::vector<unsigned char>(count, 1), "after the first update");
+	expectClean();
+
+	// Move a few nodes at every depth, whole subtrees follow
+	std::vector<unsigned char> marked(count, 0);
+	std::uniform_int_distribution<unsigned int> node(0, count - 1);
+	for (int i = 0; i < 40; i++) {
+		const unsigned int id = i < 2 ? i : node(random);
+		marked[id] = 1;
+		if (i % 3 == 0) hierarchy.SetPosition(id, glm::vec3(position(random), position(random), position(random)));
+		else if (i % 3 == 1) hierarchy.SetRotation(id, randomRotation());
+		else hierarchy.SetScale(id, glm::vec3(scale(random)));
+	}
+	updateExpecting(subtrees(marked), "after moving nodes");
+	expectClean();
+
+	// Reparent under random non descendants, some become roots, depths change for whole subtrees
+	std::fill(marked.begin(), marked.end(), 0);
+	for (int i = 0; i < 40; i++) {
+		const unsigned int id = node(random);
+		unsigned int parent = i % 8 == 0 ? TransformHierarchy::NONE : node(random);
+		for (unsigned int ancestor = parent; ancestor != TransformHierarchy::NONE; ancestor = hierarchy.GetParent(ancestor)) {
+			if (ancestor == id) { parent = TransformHierarchy::NONE; break; }
+		}
+		hierarchy.SetParent(id, parent);
+		marked[id] = 1;
+	}
+	updateExpecting(subtrees(marked), "after reparenting");
+	expectClean();
+	return failures;
+}
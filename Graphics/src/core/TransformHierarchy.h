@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "glm.hpp"
+#include "gtc/quaternion.hpp"
+
+// Parent / child transforms kept as parallel arrays (one per component) sorted by depth,
+// so parents always come before their children and every depth can be updated in one
+// linear sweep. Setters only raise a dirty flag; Update recomputes the world matrices of
+// dirty nodes and their descendants, splitting large depths into jobs, and returns
+// right away when nothing changed.
+// Ids are stable and dense, meant to double as instance indices.
+class TransformHierarchy {
+public:
+	enum : unsigned int { NONE = 0xFFFFFFFFu };
+
+private:
+	// Indexed by id
+	std::vector<unsigned int> m_Index;		// id -> position in the sorted arrays
+	std::vector<unsigned int> m_ParentId;
+	std::vector<unsigned int> m_Depth;
+
+	// Sorted by depth
+	std::vector<unsigned int> m_Id;
+	std::vector<unsigned int> m_Parent;		// sorted index of the parent, NONE for roots
+	std::vector<glm::vec3> m_Position;
+	std::vector<glm::quat> m_Rotation;
+	std::vector<glm::vec3> m_Scale;
+	std::vector<glm::mat4> m_World;
+	std::vector<unsigned char> m_Dirty;
+	std::vector<unsigned int> m_DepthStart;	// first sorted index of each depth, plus the end
+
+	bool m_TopologyDirty;
+	bool m_AnyDirty;
+	unsigned int m_ChangedFirst;
+	unsigned int m_ChangedLast;
+
+public:
+	TransformHierarchy();
+
+	unsigned int Create(unsigned int parent = NONE,
+						const glm::vec3& position = glm::vec3(0.0f),
+						const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+						const glm::vec3& scale = glm::vec3(1.0f));
+	void SetParent(unsigned int id, unsigned int parent);
+	void Clear();
+
+	inline void SetPosition(unsigned int id, const glm::vec3& position) { unsigned int i = m_Index[id]; m_Position[i] = position; MarkDirty(i); }
+	inline void SetRotation(unsigned int id, const glm::quat& rotation) { unsigned int i = m_Index[id]; m_Rotation[i] = rotation; MarkDirty(i); }
+	inline void SetScale(unsigned int id, const glm::vec3& scale) { unsigned int i = m_Index[id]; m_Scale[i] = scale; MarkDirty(i); }
+	void SetLocal(unsigned int id, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+	inline const glm::vec3& GetPosition(unsigned int id) const { return m_Position[m_Index[id]]; }
+	inline const glm::quat& GetRotation(unsigned int id) const { return m_Rotation[m_Index[id]]; }
+	inline const glm::vec3& GetScale(unsigned int id) const { return m_Scale[m_Index[id]]; }
+	inline unsigned int GetParent(unsigned int id) const { return m_ParentId[id]; }
+	// Valid after Update
+	inline const glm::mat4& GetWorldMatrix(unsigned int id) const { return m_World[m_Index[id]]; }
+	inline size_t GetCount() const { return m_Id.size(); }
+
+	// Recomputes dirty subtrees and returns how many world matrices changed.
+	// Changed matrices are also written to instances[id] when given, e.g. a mapped instance buffer.
+	size_t Update(glm::mat4* instances = nullptr);
+	// Id range touched by the last Update, to upload only that part of an instance buffer
+	bool GetChangedRange(unsigned int& first, unsigned int& count) const;
+
+private:
+	inline void MarkDirty(unsigned int index) { m_Dirty[index] = 1; m_AnyDirty = true; }
+	void Rebuild();
+	void UpdateRange(unsigned int begin, unsigned int end, glm::mat4* instances, unsigned int& first, unsigned int& last, size_t& changed);
+};
+
+// Builds a random forest wide enough for the parallel path and compares Update against plain glm
+// composition: after the first update, after moving a few nodes (only their subtrees may change),
+// after reparenting, and checks that an update with nothing dirty returns 0. Returns the number of failures.
+unsigned int RunHierarchyTest();
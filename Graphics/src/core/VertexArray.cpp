@@ -1,12 +1,26 @@
 #include "VertexBufferLayout.h"
 #include "Renderer.h"
+#include "ReleaseQueue.h"
 
 VertexArray::VertexArray() {
 	glGenVertexArrays(1, &m_RendererID);
 }
 
 VertexArray::~VertexArray() {
-	glDeleteVertexArrays(1, &m_RendererID);
+	ReleaseQueue::Get().ReleaseVertexArray(m_RendererID);
+}
+
+VertexArray::VertexArray(VertexArray&& other) noexcept : m_RendererID(other.m_RendererID) {
+	other.m_RendererID = 0;
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept {
+	if (this != &other) {
+		ReleaseQueue::Get().ReleaseVertexArray(m_RendererID);
+		m_RendererID = other.m_RendererID;
+		other.m_RendererID = 0;
+	}
+	return *this;
 }
 
 void VertexArray::AddBuffer(const VertexBuffer& buffer, const VertexBufferLayout& layout) {
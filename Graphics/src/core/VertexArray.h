@@ -12,8 +12,14 @@ public:
 	VertexArray();
 	~VertexArray();
 
+	VertexArray(const VertexArray&) = delete;
+	VertexArray& operator=(const VertexArray&) = delete;
+	VertexArray(VertexArray&& other) noexcept;
+	VertexArray& operator=(VertexArray&& other) noexcept;
+
 	void AddBuffer(const VertexBuffer& vb, const VertexBufferLayout& layout);
 	
 	void Bind() const;
 	void Unbind() const;
+	inline unsigned int GetRendererID() const { return m_RendererID; }
 };
\ No newline at end of file
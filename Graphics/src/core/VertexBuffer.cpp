@@ -1,14 +1,39 @@
 #include "VertexBuffer.h"
 #include "Renderer.h"
+#include "ReleaseQueue.h"
 
-VertexBuffer::VertexBuffer(const void* data, unsigned int size) {
-	glGenBuffers(1, &m_RendererID);
+VertexBuffer::VertexBuffer(const void* data, unsigned int size) : m_Size(size) {
+	// A recycled buffer already has storage of this size, only the contents need replacing
+	m_RendererID = ReleaseQueue::Get().AcquireBuffer(size);
+	const bool recycled = m_RendererID != 0;
+	if (!recycled) glGenBuffers(1, &m_RendererID);
 	glBindBuffer(GL_ARRAY_BUFFER, m_RendererID);
-	glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+	// Without data a recycled buffer is re-specified empty, not left with its previous contents
+	if (recycled && data)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+	else
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 }
 
 VertexBuffer::~VertexBuffer() {
-	glDeleteBuffers(1, &m_RendererID);
+	ReleaseQueue::Get().ReleaseBuffer(m_RendererID, m_Size);
+}
+
+VertexBuffer::VertexBuffer(VertexBuffer&& other) noexcept :
+	m_RendererID(other.m_RendererID),
+	m_Size(other.m_Size)
+{
+	other.m_RendererID = 0;
+}
+
+VertexBuffer& VertexBuffer::operator=(VertexBuffer&& other) noexcept {
+	if (this != &other) {
+		ReleaseQueue::Get().ReleaseBuffer(m_RendererID, m_Size);
+		m_RendererID = other.m_RendererID;
+		m_Size = other.m_Size;
+		other.m_RendererID = 0;
+	}
+	return *this;
 }
 
 void VertexBuffer::Bind() const {
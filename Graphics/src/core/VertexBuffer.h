@@ -3,11 +3,18 @@
 class VertexBuffer {
 private:
 	unsigned int m_RendererID;
+	unsigned int m_Size;
 	
 public:
 	VertexBuffer(const void* data, unsigned int size);
 	~VertexBuffer();
 
+	// GL objects have a single owner: copying would delete the id twice
+	VertexBuffer(const VertexBuffer&) = delete;
+	VertexBuffer& operator=(const VertexBuffer&) = delete;
+	VertexBuffer(VertexBuffer&& other) noexcept;
+	VertexBuffer& operator=(VertexBuffer&& other) noexcept;
+
 	void Bind() const;
 	void Unbind() const;
 };